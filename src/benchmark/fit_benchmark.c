@@ -0,0 +1,329 @@
+/* ----------------------------------------------------------------
+ *
+ * fit_benchmark.c
+ *
+ * Star fitting regression test and benchmark (src/gcam/gcpho.c).
+ * Fits synthetic Gaussian stars (2D, fit_star_grid as used by the guider,
+ * and fit_star) and slit profiles (1D, fit_profile4) with the current
+ * fitters and with the original coordinate-descent fitter (kept below as
+ * reference) and reports the differences and the time per fit. Both minimize the same chi^2;
+ * exit status 1 if the current fitter ends at a higher chi^2, does not
+ * converge, or if the positions of bright (well-measured) stars differ,
+ * or if a fit from a zero start peak does not report failure (2). At low S/N the chi^2 valley is
+ * flat and the fitters may end in different (local) minima.
+ *
+ * ---------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#include "gcpho.h"
+
+#define TOL_POS    0.02                /* [pixel] */
+#define TOL_PEAK   2000.0              /* well-measured stars */
+#define TOL_CHI    1.0e-5              /* relative */
+
+/* ---------------------------------------------------------------- */
+
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv,NULL);
+  return (double)tv.tv_sec + 1.0e-6*(double)tv.tv_usec;
+}
+
+static double gnoise(void)             /* Box-Muller, unit sigma */
+{
+  double u = drand48(),v = drand48();
+  return sqrt(-2.0*log(1.0-u))*cos(2.0*M_PI*v);
+}
+
+/* ---------------------------------------------------------------- */
+/* reference: coordinate-descent fitter, gcpho.c before the LM fit */
+
+static double ref_chi2(Pixel* p,int n,double *a)
+{
+  int    i;
+  double f,xx,yy,chi=0.0,f22=2.0*a[4]*a[4];
+
+  for (i=0; i<n; i++) {
+    xx = (double)p[i].x-a[1];
+    yy = (double)p[i].y-a[2];
+    f = a[0] + a[3]*exp(-(xx*xx+yy*yy)/f22) - p[i].z;
+    chi += f*f;
+  }
+  return chi;
+}
+
+static double ref_chi1(Pixel* p,int n,double *a)
+{
+  int    i;
+  double f,yy,chi=0.0,f22=2.0*a[3]*a[3];
+
+  for (i=0; i<n; i++) {
+    yy = (double)p[i].y-a[1];
+    f = a[0] + a[2]*exp(-(yy*yy)/f22) - p[i].z;
+    chi += f*f;
+  }
+  return chi;
+}
+
+static int ref_fit(Pixel* x,int n,double* a,int itmax,int ndeg,
+                   double* da,const double* alim,
+                   double (*get_chi)(Pixel*,int,double*))
+{
+  int    it,i,conv=0;
+  double dc[5],dcold[5],chi1,chi2,chiold,sumdc;
+
+  for (i=0; i<ndeg; i++) dcold[i] = 0.0;
+  chiold = get_chi(x,n,a);
+  for (it=1; it<=itmax; it++) {
+    for (i=0; i<ndeg; i++) {
+      a[i] += da[i];   chi1 = get_chi(x,n,a);
+      a[i] -= 2*da[i]; chi2 = get_chi(x,n,a);
+      a[i] += da[i];
+      dc[i] = chi1-chi2;
+      if ((chi1 > chiold) && (chi2 > chiold)) {
+        dc[i] = 0.0;
+        if (da[i] >= alim[i]) { da[i] *= 0.5; if (da[i] < alim[i]) conv++; }
+      } else
+      if (dc[i]*dcold[i] < 0) {
+        if (da[i] >= alim[i]) { da[i] *= 0.3; if (da[i] < alim[i]) conv++; }
+      }
+      dcold[i] = dc[i];
+    }
+    for (i=0,sumdc=0; i<ndeg; i++) sumdc += fabs(dc[i]);
+    if (sumdc > 0) for (i=0; i<ndeg; i++) a[i] -= 2.0*da[i]*(dc[i]/sumdc);
+    chiold = get_chi(x,n,a);
+    if (conv == ndeg) break;
+  }
+  return (it < itmax) ? 0 : 1;
+}
+
+static int ref_fit_star(Pixel* x,int n,double* a,int itmax)
+{
+  double da[5]   = {1.0,0.5  ,0.5  ,2.0,0.05};
+  double alim[5] = {0.1,0.002,0.002,0.2,0.002};
+  return ref_fit(x,n,a,itmax,5,da,alim,ref_chi2);
+}
+
+static int ref_fit_profile4(Pixel* x,int n,double* a,int itmax)
+{
+  double da[4]   = { 5.0,0.5  , 5.0,0.05};
+  double alim[4] = { 0.5,0.002, 0.5,0.002};
+  return ref_fit(x,n,a,itmax,4,da,alim,ref_chi1);
+}
+
+/* ---------------------------------------------------------------- */
+
+typedef struct {
+  int    n,fail,nnew,nref;            /* not converged */
+  double dpos,dsig;                    /* max. |new-ref| */
+  double dchi;                         /* max. (new-ref)/ref chi^2 */
+  double epos,eref;                    /* max. |new-true|,|ref-true| */
+  double tnew,tdbl,tref;               /* [sec] */
+} Stats;
+
+static void make_star(Pixel* p,int vrad,double bias,double x0,double y0,
+                      double peak,double sig)
+{
+  int    x,y,i=0;
+  double r2,m;
+
+  for (x=-vrad; x<=vrad; x++) for (y=-vrad; y<=vrad; y++,i++) {
+    r2 = (x-x0)*(x-x0)+(y-y0)*(y-y0);
+    m = bias + peak*exp(-r2/(2.0*sig*sig));
+    p[i].x = x; p[i].y = y;
+    p[i].z = floor(m + sqrt(m+25.0)*gnoise() + 0.5);  /* shot+read */
+  }
+}
+
+static void make_profile(Pixel* p,int vrad,double bias,double y0,
+                         double peak,double sig)
+{
+  int    y,i=0;
+  double m,w=2*vrad+1;
+
+  for (y=-vrad; y<=vrad; y++,i++) {
+    m = w*bias + peak*exp(-(y-y0)*(y-y0)/(2.0*sig*sig));
+    p[i].x = 0; p[i].y = y;
+    p[i].z = floor(m + sqrt(m+w*25.0)*gnoise() + 0.5);
+  }
+}
+
+/* --- */
+
+static void run_star(Stats* s,int vrad,double sig,double peak,int ntry)
+{
+  int    k,n=(2*vrad+1)*(2*vrad+1),r1,r2;
+  double a[5],b[5],c[5],t,x0,y0,bias=200.0;
+  Pixel  *p = (Pixel*)malloc(n*sizeof(Pixel));
+  PixelGrid grid;
+
+  memset(s,0,sizeof(Stats));
+  memset(&grid,0,sizeof(grid));
+  s->dchi = -1.0;
+  for (k=0; k<ntry; k++) {
+    x0 = drand48()-0.5; y0 = drand48()-0.5;
+    make_star(p,vrad,bias,x0,y0,peak,sig);
+    a[0] = bias+10.0*gnoise();         /* guider-like start values */
+    a[1] = floor(x0+0.5); a[2] = floor(y0+0.5);
+    a[3] = 0.8*peak;
+    a[4] = sig*(1.0+0.2*(drand48()-0.5));
+    memcpy(b,a,sizeof(a));
+    memcpy(c,a,sizeof(a));
+    t = now(); pgrid_set(&grid,p,n);
+               r1 = fit_star_grid(&grid,a,400);  s->tnew += now()-t;
+    t = now(); (void)fit_star(p,n,c,400);        s->tdbl += now()-t;
+    t = now(); r2 = ref_fit_star(p,n,b,400);     s->tref += now()-t;
+    s->nnew += (r1 != 0); s->nref += (r2 != 0);
+    s->dpos = fmax(s->dpos,fmax(fabs(a[1]-b[1]),fabs(a[2]-b[2])));
+    s->dsig = fmax(s->dsig,fabs(a[4]-fabs(b[4]))/sig);
+    s->dchi = fmax(s->dchi,(ref_chi2(p,n,a)-ref_chi2(p,n,b))/ref_chi2(p,n,b));
+    s->epos = fmax(s->epos,fmax(fabs(a[1]-x0),fabs(a[2]-y0)));
+    s->eref = fmax(s->eref,fmax(fabs(b[1]-x0),fabs(b[2]-y0)));
+    s->n++;
+  }
+  s->fail = (s->dchi > TOL_CHI) || (s->nnew > 0) ||
+            ((peak >= TOL_PEAK) && (s->dpos > TOL_POS));
+  pgrid_free(&grid);
+  free(p);
+}
+
+static void run_profile(Stats* s,int vrad,double sig,double peak,int ntry)
+{
+  int    k,n=2*vrad+1,r1,r2;
+  double a[4],b[4],t,y0,bias=200.0;
+  Pixel  *p = (Pixel*)malloc(n*sizeof(Pixel));
+
+  memset(s,0,sizeof(Stats));
+  s->dchi = -1.0;
+  for (k=0; k<ntry; k++) {
+    y0 = 2.0*(drand48()-0.5);
+    make_profile(p,vrad,bias,y0,peak,sig);
+    a[0] = n*bias*(1.0+0.05*gnoise()); /* guider-like start values */
+    a[1] = floor(y0+0.5);
+    a[2] = 0.8*peak;
+    a[3] = sig*(1.0+0.2*(drand48()-0.5));
+    memcpy(b,a,sizeof(a));
+    t = now(); r1 = fit_profile4(p,n,a,3000);     s->tnew += now()-t;
+    t = now(); r2 = ref_fit_profile4(p,n,b,3000); s->tref += now()-t;
+    s->nnew += (r1 != 0); s->nref += (r2 != 0);
+    s->dpos = fmax(s->dpos,fabs(a[1]-b[1]));
+    s->dsig = fmax(s->dsig,fabs(a[3]-fabs(b[3]))/sig);
+    s->dchi = fmax(s->dchi,(ref_chi1(p,n,a)-ref_chi1(p,n,b))/ref_chi1(p,n,b));
+    s->epos = fmax(s->epos,fabs(a[1]-y0));
+    s->eref = fmax(s->eref,fabs(b[1]-y0));
+    s->n++;
+  }
+  s->fail = (s->dchi > TOL_CHI) || (s->nnew > 0) ||
+            ((peak >= TOL_PEAK) && (s->dpos > TOL_POS));
+  free(p);
+}
+
+/* ---------------------------------------------------------------- */
+/* start at peak 0 ('get_fwhm' found no star): every fitter must fail */
+/* (2), so the guider estimates again instead of trusting the start   */
+
+static int run_zero_peak(void)
+{
+  int    r1,r2,r3,vrad=10,n=(2*vrad+1)*(2*vrad+1);
+  double a[5]={204.0,0.0,0.0,0.0,1.7},b[5],c[4]={21*204.0,0.0,0.0,1.7};
+  Pixel  *p = (Pixel*)malloc(n*sizeof(Pixel));
+  PixelGrid grid;
+
+  memset(&grid,0,sizeof(grid));
+  make_star(p,vrad,200.0,2.3,-0.9,3000.0,1.5);
+  memcpy(b,a,sizeof(a));
+  pgrid_set(&grid,p,n);
+  r1 = fit_star_grid(&grid,a,400);
+  r2 = fit_star(p,n,b,400);
+  make_profile(p,vrad,200.0,2.3,3000.0,1.5);
+  r3 = fit_profile4(p,2*vrad+1,c,3000);
+  printf("zero start peak: new %d, dbl %d, profile %d (2 = failed) %s\n",
+         r1,r2,r3,((r1 == 2) && (r2 == 2) && (r3 == 2)) ? "ok" : "FAIL");
+  pgrid_free(&grid);
+  free(p);
+  return !((r1 == 2) && (r2 == 2) && (r3 == 2));
+}
+
+/* ---------------------------------------------------------------- */
+
+static void print_row(const char* what,int vrad,double sig,double peak,
+                      const Stats* s)
+{
+  printf("| %-7s | %2dx%-2d | %4.1f | %6.0f | %7.4f | %6.4f | %+8.1e "
+         "| %7.4f | %7.4f | %7.3f | %7.3f | %8.3f | %6.1f | %2d/%-2d | %-4s |\n",
+         what,2*vrad+1,strcmp(what,"star") ? 1 : 2*vrad+1,sig,peak,
+         s->dpos,s->dsig,s->dchi,s->epos,s->eref,
+         1.0e3*s->tnew/s->n,1.0e3*(s->tdbl ? s->tdbl : s->tnew)/s->n,
+         1.0e3*s->tref/s->n,s->tref/s->tnew,
+         s->nnew,s->nref,s->fail ? "FAIL" : "ok");
+}
+
+static const char* simd(void)          /* as gcpho.o was built */
+{
+#if defined(__AVX512F__)
+  return "AVX-512";
+#elif defined(__AVX2__)
+  return "AVX2";
+#elif defined(__AVX__)
+  return "AVX";
+#elif defined(__SSE2__)
+  return "SSE2";
+#elif defined(__ARM_NEON)
+  return "NEON";
+#else
+  return "scalar";
+#endif
+}
+
+static void usage(const char* prog)
+{
+  fprintf(stderr,"usage: %s [-n trials] [-s seed]\n",prog);
+  exit(2);
+}
+
+int main(int argc,char** argv)
+{
+  int    c,i,j,k,ntry=20,fail=0;
+  long   seed=1;
+  const int    vrads[] = {10,20};
+  const double sigs[]  = {1.0,1.5,2.5,4.0};
+  const double peaks[] = {500.0,5000.0};
+  Stats  s;
+
+  while ((c = getopt(argc,argv,"n:s:h")) != -1) {
+    switch (c) {
+    case 'n': ntry = atoi(optarg); break;
+    case 's': seed = atol(optarg); break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (ntry < 1) usage(argv[0]);
+  srand48(seed);
+
+  printf("fit_benchmark  trials=%d  seed=%ld  simd=%s  (d*=max|new-ref|, "
+         "dchi=max new/ref-1, e*=max|fit-true|, ms/fit, nc=not converged new/ref)\n",
+         ntry,seed,simd());
+  printf("| fit     | box   | sig  | peak   | dpos    | dsig   | dchi     "
+         "| epos    | eref    | new ms  | dbl ms  | ref ms   | speed  | nc    | res  |\n");
+  for (i=0; i<2; i++) for (j=0; j<4; j++) for (k=0; k<2; k++) {
+    run_star(&s,vrads[i],sigs[j],peaks[k],ntry);
+    print_row("star",vrads[i],sigs[j],peaks[k],&s);
+    fail |= s.fail;
+  }
+  for (i=0; i<2; i++) for (j=0; j<4; j++) for (k=0; k<2; k++) {
+    run_profile(&s,vrads[i],sigs[j],peaks[k],ntry);
+    print_row("profile",vrads[i],sigs[j],peaks[k],&s);
+    fail |= s.fail;
+  }
+  fail |= run_zero_peak();
+  printf("%s\n",fail ? "FAIL" : "PASS");
+  return fail;
+}
@@ -0,0 +1,231 @@
+/* ----------------------------------------------------------------
+ *
+ * pctile_benchmark.c
+ *
+ * Median/percentile regression test and benchmark (src/gcam/pctile.c).
+ * Compares pct_select (radix select, get_background) and pct_hist
+ * (counting histogram, scale_med) with the recursive quicksort that
+ * qltool.c used before (kept below as reference) and with qsort(),
+ * on the background annulus of typical guider boxes, on the random
+ * samples autoscaling takes from typical frames, and on a full frame.
+ * Exit status 1 if any rank differs from the sorted data.
+ *
+ * ---------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include "pctile.h"
+
+#define NK         5                   /* ranks checked */
+
+/* ---------------------------------------------------------------- */
+
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv,NULL);
+  return (double)tv.tv_sec + 1.0e-6*(double)tv.tv_usec;
+}
+
+static double gnoise(void)             /* Box-Muller, unit sigma */
+{
+  double u = drand48(),v = drand48();
+  return sqrt(-2.0*log(1.0-u))*cos(2.0*M_PI*v);
+}
+
+/* ---------------------------------------------------------------- */
+/* reference: qltool.c s_sort() before pctile.c */
+
+static void s_sort(u_short *zahl, int l, int r)
+{
+  int     i,j;
+  u_short x,h;
+ 
+  i = l;
+  j = r;
+ 
+  if (j>i) {
+    x = zahl[(i+j)/2];
+    do {
+      while (zahl[i] < x) i++;
+      while (zahl[j] > x) j--;
+      if (i<=j) {
+        h         = zahl[i];
+        zahl[i++] = zahl[j];
+        zahl[j--] = h;
+      }
+    } while (!(i>j));
+    s_sort(zahl,l,j);
+    s_sort(zahl,i,r);
+  }
+}
+
+static int cmp_us(const void* a,const void* b)
+{
+  return (int)*(const u_short*)a - (int)*(const u_short*)b;
+}
+
+/* ---------------------------------------------------------------- */
+/* sky 'bias' + noise, a star and a few hot pixels                  */
+
+static void make_frame(u_short* d,int w,int h,double bias)
+{
+  int    i,x,y;
+  double v,xs=0.4*w,ys=0.6*h;
+
+  for (y=0; y<h; y++) for (x=0; x<w; x++) {
+    v = bias + 0.03*bias*gnoise();
+    v += 20000.0*exp(-((x-xs)*(x-xs)+(y-ys)*(y-ys))/(2.0*3.0*3.0));
+    d[x+y*w] = (u_short)((v < 0) ? 0 : (v > 65535) ? 65535 : v);
+  }
+  for (i=0; i<w*h/1000; i++) d[(int)(drand48()*w*h)] = 65535;
+}
+
+/* background annulus of a (2r+1)^2 box, as get_background()        */
+
+static int get_box(const u_short* d,int w,int x0,int y0,int r,u_short* v)
+{
+  int x,y,n=0;
+
+  for (x=x0-r; x<=x0+r; x++) for (y=y0-r; y<=y0+r; y++) {
+    if ((x-x0)*(x-x0)+(y-y0)*(y-y0) < r*r) continue;
+    if (d[x+y*w] > 0) v[n++] = d[x+y*w];
+  }
+  return n;
+}
+
+/* random sample of 'nsamp' pixels, as scale_med()                   */
+
+static int get_sample(const u_short* d,int npix,int nsamp,u_short* v)
+{
+  int n;
+
+  for (n=0; n<nsamp; n++) v[n] = d[(int)(drand48()*npix)];
+  return n;
+}
+
+/* ---------------------------------------------------------------- */
+
+typedef struct {
+  double tsort,tqsort,tsel,thist;      /* [us] per call */
+  int    fail;
+} Stats;
+
+static void run(Stats* s,const u_short* v,int n,u_short* tmp,u_int* hist)
+{
+  int     i,j,r,reps,k[NK];
+  u_short ref[NK],val[NK];
+  double  t;
+
+  k[0] = 0; k[1] = n/10; k[2] = n/2; k[3] = pct_rank(n,0.9); k[4] = n-1;
+  reps = (n < 200000) ? 2000000/n+1 : 3;
+  memset(s,0,sizeof(Stats));
+
+  t = now();
+  for (r=0; r<reps; r++) {
+    memcpy(tmp,v,n*sizeof(u_short)); s_sort(tmp,0,n-1);
+  }
+  s->tsort = 1.0e6*(now()-t)/reps;
+  for (j=0; j<NK; j++) ref[j] = tmp[k[j]];
+
+  t = now();
+  for (r=0; r<reps; r++) {
+    memcpy(tmp,v,n*sizeof(u_short)); qsort(tmp,n,sizeof(u_short),cmp_us);
+  }
+  s->tqsort = 1.0e6*(now()-t)/reps;
+
+  t = now();
+  for (r=0; r<reps; r++) (void)pct_select(v,n,k+2,1,val+2);
+  s->tsel = 1.0e6*(now()-t)/reps;
+  (void)pct_select(v,n,k,NK,val);
+  for (j=0; j<NK; j++) if (val[j] != ref[j]) s->fail = 1;
+
+  t = now();
+  for (r=0; r<reps; r++) {
+    memset(hist,0,PCT_NBIN*sizeof(u_int));
+    for (i=0; i<n; i++) hist[v[i]]++;
+    (void)pct_hist(hist,n,k+2,1,val+2);
+  }
+  s->thist = 1.0e6*(now()-t)/reps;
+  (void)pct_hist(hist,n,k,NK,val);
+  for (j=0; j<NK; j++) if (val[j] != ref[j]) s->fail = 1;
+}
+
+static void print_row(const char* what,int n,const Stats* s)
+{
+  double best = (s->tsel < s->thist) ? s->tsel : s->thist;
+
+  printf("| %-16s | %8d | %10.2f | %10.2f | %10.2f | %10.2f | %6.1fx | %s |\n",
+         what,n,s->tsort,s->tqsort,s->tsel,s->thist,s->tsort/best,
+         s->fail ? "FAIL" : "ok  ");
+}
+
+/* ---------------------------------------------------------------- */
+
+static void usage(const char* prog)
+{
+  fprintf(stderr,"usage: %s [-s seed]\n",prog);
+  exit(2);
+}
+
+int main(int argc,char** argv)
+{
+  int     c,i,n,w,h,fail=0;
+  long    seed=1;
+  char    what[32];
+  const int vrads[]  = {10,15,20,30,50};
+  const int frames[][2] = {{640,480},{1280,960},{1936,1096},{3096,2080}};
+  u_short *frame,*v,*tmp;
+  u_int   *hist;
+  Stats   s;
+
+  while ((c = getopt(argc,argv,"s:h")) != -1) {
+    switch (c) {
+    case 's': seed = atol(optarg); break;
+    default:  usage(argv[0]);
+    }
+  }
+  srand48(seed);
+
+  w = frames[3][0]; h = frames[3][1];
+  frame = (u_short*)malloc(w*h*sizeof(u_short));
+  v     = (u_short*)malloc(w*h*sizeof(u_short));
+  tmp   = (u_short*)malloc(w*h*sizeof(u_short));
+  hist  = (u_int*)malloc(PCT_NBIN*sizeof(u_int));
+  if (!frame || !v || !tmp || !hist) { perror("malloc"); return 2; }
+
+  printf("pctile_benchmark  seed=%ld  (us/call, median; "
+         "speed=s_sort/best)\n",seed);
+  printf("| data             | n        | s_sort     | qsort      "
+         "| select     | hist       | speed   | res  |\n");
+  for (i=0; i<5; i++) {                /* get_background() */
+    make_frame(frame,256,256,1000.0);
+    n = get_box(frame,256,102,154,vrads[i],v);
+    snprintf(what,sizeof(what),"box r=%d",vrads[i]);
+    run(&s,v,n,tmp,hist); print_row(what,n,&s); fail |= s.fail;
+  }
+  for (i=0; i<4; i++) {                /* scale_med() */
+    w = frames[i][0]; h = frames[i][1];
+    make_frame(frame,w,h,1000.0);
+    n = 128*(int)pow((double)(w*h),0.30);
+    n = get_sample(frame,w*h,n,v);
+    snprintf(what,sizeof(what),"sample %dx%d",w,h);
+    run(&s,v,n,tmp,hist); print_row(what,n,&s); fail |= s.fail;
+  }
+  w = frames[2][0]; h = frames[2][1];  /* full frame */
+  make_frame(frame,w,h,1000.0);
+  snprintf(what,sizeof(what),"frame %dx%d",w,h);
+  run(&s,frame,w*h,tmp,hist); print_row(what,w*h,&s); fail |= s.fail;
+
+  printf("%s\n",fail ? "FAIL" : "PASS");
+  free(frame); free(v); free(tmp); free(hist);
+  return fail;
+}
+
+/* ---------------------------------------------------------------- */
@@ -13,6 +13,15 @@
  * ASI_BANDWIDTHOVERLOAD is set via the server's 'usb' command
  * (--usb N, 40..100); sweep it by running once per value.
  *
+ * Duty cycle = exptime / camera frame period, the period taken from
+ * the server's per-frame timestamps (Δts/Δseq), so it is immune to
+ * client-side drops and network jitter. --vmode selects the server's
+ * video acquisition strategy ('adapt', 'free' or 'slice', v1.0.8+).
+ *
+ * Jitter = |Δts - median Δts| of the server timestamps, reported as
+ * percentiles; --rt sweeps the server's run_video SCHED_FIFO priority
+ * (0 = CFS, 'rt' command, v1.0.10+) to compare with and without.
+ *
  * ---------------------------------------------------------------- */
 
 #include <stdio.h>
@@ -34,6 +43,7 @@
 #define MAX_BINS    8
 #define MAX_BITS    4
 #define MAX_ROIS    8
+#define MAX_RTS     8
 #define CMD_BUF   512
 #define LINE_BUF 1024
 
@@ -51,9 +61,14 @@ typedef struct {
   int         bitdepths[MAX_BITS];
   int         n_roi;
   double      rois[MAX_ROIS];      /* window size, percent of full frame */
+  int         n_rt;
+  int         rts[MAX_RTS];        /* server SCHED_FIFO priority, 0=CFS */
+  int         rt_cpu;              /* server run_video CPU, -1=any */
   int         gain, offset, usb, highspeed;
   int         have_gain, have_offset, have_usb, have_highspeed;
   const char *csv_path;
+  const char *vmode;               /* server 'vmode' (optional) */
+  const char *camera;              /* server 'camera' # or serial */
   int         verbose;
 } BenchCfg;
 
@@ -72,6 +87,10 @@ typedef struct {
   double mbps;
   int    drops;
   int    enodata_count;
+  double period_ms;                /* camera frame period (server ts) */
+  double duty_pct;                 /* exptime / period */
+  int    rt;                       /* SCHED_FIFO priority, -1=not set */
+  double jit_p50_us, jit_p99_us, jit_p999_us, jit_max_us;
   char   note[64];
 } BenchRow;
 
@@ -151,6 +170,16 @@ static int set_int_control(int sock, const char *name, int value)
   return 0;
 }
 
+/* run_video SCHED_FIFO priority (0=CFS) and CPU for the next 'start' */
+static int set_rt(int sock, int prio, int cpu)
+{
+  char cmd[CMD_BUF], buf[LINE_BUF];
+  snprintf(cmd, sizeof(cmd), "rt %d %d", prio, cpu);
+  if (zwo_request(sock, cmd, buf, sizeof(buf)) != 0) return -1;
+  if (is_error_response(buf)) { fprintf(stderr, "rt: %s\n", buf); return -1; }
+  return 0;
+}
+
 static int start_stream(int sock)
 {
   char buf[LINE_BUF];
@@ -260,6 +289,9 @@ static void set_defaults(BenchCfg *c)
   memcpy(c->bitdepths, dbt, sizeof(dbt));
   c->n_roi = 1;
   c->rois[0] = 100.0;
+  c->n_rt = 1;
+  c->rts[0] = -1;                  /* leave the server's setting */
+  c->rt_cpu = -1;
 }
 
 static void usage(const char *prog)
@@ -280,6 +312,11 @@ static void usage(const char *prog)
 "  --offset N              (optional)\n"
 "  --usb N                 ASI_BANDWIDTHOVERLOAD 40..100 (optional)\n"
 "  --highspeed N           ASI_HIGH_SPEED_MODE 0/1, 10-bit ADC (optional)\n"
+"  --vmode MODE            server video strategy adapt/free/slice (optional)\n"
+"  --camera N|SERIAL       select a camera of a multi-camera server\n"
+"  --rt CSV                server SCHED_FIFO priorities, 0=CFS (optional,\n"
+"                          e.g. 0,50 compares jitter without/with)\n"
+"  --rt-cpu N              pin server run_video to CPU N (with --rt)\n"
 "  --csv PATH              (optional)\n"
 "  -v, --verbose\n"
 "  -h, --help\n", prog, SERVER_PORT);
@@ -302,6 +339,10 @@ static int parse_args(int argc, char **argv, BenchCfg *c)
     {"offset",       required_argument, 0, 'o'},
     {"usb",          required_argument, 0, 'u'},
     {"highspeed",    required_argument, 0, 'S'},
+    {"vmode",        required_argument, 0, 'm'},
+    {"camera",       required_argument, 0, 'K'},
+    {"rt",           required_argument, 0, 'R'},
+    {"rt-cpu",       required_argument, 0, 'C'},
     {"csv",          required_argument, 0, 'c'},
     {"verbose",      no_argument,       0, 'v'},
     {"help",         no_argument,       0, 'h'},
@@ -345,6 +386,14 @@ static int parse_args(int argc, char **argv, BenchCfg *c)
     case 'o': c->offset = atoi(optarg); c->have_offset = 1; break;
     case 'u': c->usb = atoi(optarg); c->have_usb = 1; break;
     case 'S': c->highspeed = atoi(optarg); c->have_highspeed = 1; break;
+    case 'm': c->vmode = optarg; break;
+    case 'K': c->camera = optarg; break;
+    case 'R': {
+      int n = parse_int_csv(optarg, c->rts, MAX_RTS);
+      if (n <= 0) { fprintf(stderr, "bad --rt\n"); return -1; }
+      c->n_rt = n; break;
+    }
+    case 'C': c->rt_cpu = atoi(optarg); break;
     case 'c': c->csv_path = optarg; break;
     case 'v': c->verbose = 1; break;
     case 'h':
@@ -364,6 +413,26 @@ static int parse_args(int argc, char **argv, BenchCfg *c)
 
 /* ---------------- per-configuration run ---------------- */
 
+static int cmp_double(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/* Percentiles of |dts - median(dts)| in microseconds; sorts `dts`. */
+static void jitter_stats(double *dts, int n, BenchRow *row)
+{
+  if (n < 2) return;
+  qsort(dts, (size_t)n, sizeof(double), cmp_double);
+  double med = dts[n / 2];
+  for (int i = 0; i < n; i++) dts[i] = fabs(dts[i] - med) * 1e6;
+  qsort(dts, (size_t)n, sizeof(double), cmp_double);
+  row->jit_p50_us  = dts[(int)(0.50  * (n - 1))];
+  row->jit_p99_us  = dts[(int)(0.99  * (n - 1))];
+  row->jit_p999_us = dts[(int)(0.999 * (n - 1))];
+  row->jit_max_us  = dts[n - 1];
+}
+
 /* Warmup + measurement window for one (exptime, bin, bits) configuration.
  * Caller owns a reusable frame buffer (`buf`, `buf_cap`) that is grown
  * on demand so we don't pay malloc cost per config. */
@@ -439,6 +508,10 @@ static int run_one(int sock, const BenchCfg *cfg,
   /* Measurement window. */
   int first = 1;
   int frames = 0, drops = 0, enodata = 0;
+  unsigned int seq0 = 0;
+  unsigned long long ts0 = 0, ts_prev = 0;
+  double *dts_buf = NULL;          /* consecutive server intervals [s] */
+  int     n_dts = 0, dts_cap = 0;
   double t0 = walltime(0);
   double t_end = t0 + cfg->duration_s;
   double t_last = t0;
@@ -451,6 +524,19 @@ static int run_one(int sock, const BenchCfg *cfg,
       break;
     }
     if (!first && seq > last_seq + 1) drops += (int)(seq - last_seq - 1);
+    if (first) { seq0 = seq; ts0 = ts_ns; }
+    if (ts0 && ts_ns > ts0 && seq > seq0) {
+      row->period_ms = (double)(ts_ns - ts0) / 1e6 / (double)(seq - seq0);
+    }
+    if (ts_prev && ts_ns > ts_prev && seq == last_seq + 1) {
+      if (n_dts == dts_cap) {
+        dts_cap = dts_cap ? 2 * dts_cap : 1024;
+        dts_buf = realloc(dts_buf, (size_t)dts_cap * sizeof(double));
+        assert(dts_buf);
+      }
+      dts_buf[n_dts++] = (double)(ts_ns - ts_prev) / 1e9;
+    }
+    ts_prev = ts_ns;
     last_seq = seq; first = 0; frames++;
     if (cfg->verbose) {
       /* dt = client-side arrival interval (protocol+network included),
@@ -463,6 +549,16 @@ static int run_one(int sock, const BenchCfg *cfg,
     }
   }
   double elapsed = walltime(0) - t0;
+  if (cfg->verbose) {
+    /* "stalls rearms failed", "prio cpu netcpu lock policy:prio:cpu" */
+    char resp[LINE_BUF];
+    if (zwo_request(sock, "stalls", resp, sizeof(resp)) == 0) {
+      fprintf(stderr, "  stalls: %s\n", resp);
+    }
+    if (zwo_request(sock, "rt", resp, sizeof(resp)) == 0) {
+      fprintf(stderr, "  rt: %s\n", resp);
+    }
+  }
   stop_stream(sock);
 
   row->frames = frames;
@@ -474,6 +570,19 @@ static int run_one(int sock, const BenchCfg *cfg,
               ? (double)frames * (double)nbytes / elapsed / 1.0e6 : 0.0;
   row->drops = drops;
   row->enodata_count = enodata;
+  row->duty_pct = (row->period_ms > 0)
+                  ? 100.0 * exptime / (row->period_ms / 1e3) : 0.0;
+  jitter_stats(dts_buf, n_dts, row);
+  free(dts_buf);
+  if (cfg->verbose) {
+    /* server-side ASIGetVideoData trace of this run (v1.0.8+) */
+    char resp[LINE_BUF];
+    if (zwo_request(sock, "vtrace", resp, sizeof(resp)) == 0 &&
+        !is_error_response(resp)) {
+      fprintf(stderr, "  vtrace: calls timeouts dropped block_ms "
+                      "max_ms gap_ms period_ms = %s\n", resp);
+    }
+  }
   if (g_stop && row->note[0] == '\0')
     snprintf(row->note, sizeof(row->note), "interrupted");
   return 0;
@@ -489,6 +598,8 @@ static void print_session_banner(const BenchCfg *cfg, const char *model,
          cfg->host, cfg->port, cfg->duration_s, cfg->warmup_s);
   if (cfg->have_usb) printf("   usb=%d", cfg->usb);
   if (cfg->have_highspeed) printf("   highspeed=%d", cfg->highspeed);
+  if (cfg->vmode) printf("   vmode=%s", cfg->vmode);
+  if (cfg->camera) printf("   camera=%s", cfg->camera);
   printf("\n");
   printf("camera: %s  %dx%d  cooler=%d color=%d bitDepth=%d\n\n",
          model, W, H, cooler, color, bitDepth);
@@ -509,8 +620,8 @@ static void print_progress_done(const BenchRow *r)
   if (r->note[0]) {
     fprintf(stderr, "%s (fps=%.2f/%.2f)\n", r->note, r->fps, r->expected_fps);
   } else {
-    fprintf(stderr, "fps=%.2f/%.2f eff=%.1f%% drops=%d\n",
-            r->fps, r->expected_fps, r->efficiency_pct, r->drops);
+    fprintf(stderr, "fps=%.2f/%.2f eff=%.1f%% duty=%.1f%% drops=%d\n",
+            r->fps, r->expected_fps, r->efficiency_pct, r->duty_pct, r->drops);
   }
   fflush(stderr);
 }
@@ -521,26 +632,33 @@ static void print_table_separator(FILE *fp)
 {
   fprintf(fp,
     "+--------+-----+------+-------+------+------+--------+---------+---------"
-    "+---------+-------+------+---------+--------+--------------------+\n");
+    "+---------+-------+--------+-------+------+---------+--------"
+    "+-----+--------+---------+--------------------+\n");
 }
 
 static void print_table_header(FILE *fp)
 {
   fprintf(fp,
     "| %-6s | %-3s | %-4s | %-5s | %-4s | %-4s | %-6s | %-7s | %-7s | %-7s | "
-    "%-5s | %-4s | %-7s | %-6s | %-18s |\n",
+    "%-5s | %-6s | %-5s | %-4s | %-7s | %-6s | %-3s | %-6s | %-7s | %-18s |\n",
     "exptim", "bin", "bits", "roi%", "W", "H", "frames", "elapsed", "fps",
-    "expFPS", "eff%", "drop", "enodata", "MB/s", "note");
+    "expFPS", "eff%", "period", "duty%", "drop", "enodata", "MB/s",
+    "rt", "j99us", "jmaxus", "note");
 }
 
 static void print_table_row(FILE *fp, const BenchRow *r)
 {
+  char rt[16] = "-";
+  if (r->rt >= 0) snprintf(rt, sizeof(rt), "%d", r->rt);
   fprintf(fp,
     "| %6.4f | %3d | %4d | %5.1f | %4d | %4d | %6d | %7.2f | %7.2f | %7.2f | "
-    "%5.1f | %4d | %7d | %6.1f | %-18.18s |\n",
+    "%5.1f | %6.1f | %5.1f | %4d | %7d | %6.1f | %3s | %6.0f | %7.0f | "
+    "%-18.18s |\n",
     r->exptime, r->bin, r->bits, r->roi_pct, r->w, r->h,
     r->frames, r->elapsed, r->fps, r->expected_fps,
-    r->efficiency_pct, r->drops, r->enodata_count, r->mbps,
+    r->efficiency_pct, r->period_ms, r->duty_pct,
+    r->drops, r->enodata_count, r->mbps, rt,
+    r->jit_p99_us, r->jit_max_us,
     r->note[0] ? r->note : "");
 }
 
@@ -562,14 +680,19 @@ static int write_csv(const BenchRow *rows, int n, const char *path)
     return -1;
   }
   fprintf(fp, "exptime,bin,bits,roi_pct,x,y,w,h,frames,elapsed,fps,expected_fps,"
-              "efficiency_pct,drops,enodata,bytes_per_frame,mbps,note\n");
+              "efficiency_pct,period_ms,duty_pct,drops,enodata,bytes_per_frame,"
+              "mbps,rt,jit_p50_us,jit_p99_us,jit_p999_us,jit_max_us,note\n");
   for (int i = 0; i < n; i++) {
     const BenchRow *r = &rows[i];
-    fprintf(fp, "%.6f,%d,%d,%.2f,%d,%d,%d,%d,%d,%.4f,%.4f,%.4f,%.2f,%d,%d,%zu,%.3f,\"%s\"\n",
+    fprintf(fp, "%.6f,%d,%d,%.2f,%d,%d,%d,%d,%d,%.4f,%.4f,%.4f,%.2f,%.3f,%.2f,"
+                "%d,%d,%zu,%.3f,%d,%.1f,%.1f,%.1f,%.1f,\"%s\"\n",
             r->exptime, r->bin, r->bits, r->roi_pct, r->x, r->y, r->w, r->h,
             r->frames, r->elapsed, r->fps, r->expected_fps,
-            r->efficiency_pct, r->drops, r->enodata_count,
-            r->bytes_per_frame, r->mbps, r->note);
+            r->efficiency_pct, r->period_ms, r->duty_pct,
+            r->drops, r->enodata_count,
+            r->bytes_per_frame, r->mbps, r->rt,
+            r->jit_p50_us, r->jit_p99_us, r->jit_p999_us, r->jit_max_us,
+            r->note);
   }
   fclose(fp);
   return 0;
@@ -592,6 +715,17 @@ int main(int argc, char **argv)
     return 2;
   }
 
+  if (cfg.camera) {
+    char cmd[CMD_BUF], resp[LINE_BUF];
+    snprintf(cmd, sizeof(cmd), "camera %s", cfg.camera);
+    if (zwo_request(sock, cmd, resp, sizeof(resp)) != 0 ||
+        is_error_response(resp)) {
+      fprintf(stderr, "camera %s: %s\n", cfg.camera, resp);
+      close(sock);
+      return 3;
+    }
+  }
+
   int W = 0, H = 0, cooler = 0, color = 0, bitDepth = 0;
   char model[64] = "";
   if (open_camera(sock, &W, &H, &cooler, &color, &bitDepth,
@@ -604,10 +738,18 @@ int main(int argc, char **argv)
   if (cfg.have_offset) set_int_control(sock, "offset", cfg.offset);
   if (cfg.have_usb)    set_int_control(sock, "usb",    cfg.usb);
   if (cfg.have_highspeed) set_int_control(sock, "highspeed", cfg.highspeed);
+  if (cfg.vmode) {
+    char cmd[CMD_BUF], resp[LINE_BUF];
+    snprintf(cmd, sizeof(cmd), "vmode %s", cfg.vmode);
+    if (zwo_request(sock, cmd, resp, sizeof(resp)) != 0 ||
+        is_error_response(resp)) {
+      fprintf(stderr, "vmode: %s\n", resp);
+    }
+  }
 
   print_session_banner(&cfg, model, W, H, cooler, color, bitDepth);
 
-  int n_rows = cfg.n_bit * cfg.n_bin * cfg.n_roi * cfg.n_exp;
+  int n_rows = cfg.n_bit * cfg.n_bin * cfg.n_roi * cfg.n_exp * cfg.n_rt;
   BenchRow *rows = calloc((size_t)n_rows, sizeof(BenchRow));
   u_char *frame_buf = NULL;
   size_t  frame_cap = 0;
@@ -616,17 +758,21 @@ int main(int argc, char **argv)
     for (int ni = 0; ni < cfg.n_bin && !g_stop; ni++) {
       for (int ri = 0; ri < cfg.n_roi && !g_stop; ri++) {
         for (int ei = 0; ei < cfg.n_exp && !g_stop; ei++) {
-          BenchRow *row = &rows[idx];
-          row->exptime = cfg.exptimes[ei];
-          row->bin     = cfg.bins[ni];
-          row->bits    = cfg.bitdepths[bi];
-          row->roi_pct = cfg.rois[ri];
-          print_progress_start(idx + 1, n_rows, row);
-          (void)run_one(sock, &cfg, W, H,
-                        row->exptime, row->bin, row->bits, row->roi_pct,
-                        &frame_buf, &frame_cap, row);
-          print_progress_done(row);
-          completed = ++idx;
+          for (int ti = 0; ti < cfg.n_rt && !g_stop; ti++) {
+            BenchRow *row = &rows[idx];
+            row->exptime = cfg.exptimes[ei];
+            row->bin     = cfg.bins[ni];
+            row->bits    = cfg.bitdepths[bi];
+            row->roi_pct = cfg.rois[ri];
+            if (cfg.rts[ti] >= 0) set_rt(sock, cfg.rts[ti], cfg.rt_cpu);
+            print_progress_start(idx + 1, n_rows, row);
+            (void)run_one(sock, &cfg, W, H,
+                          row->exptime, row->bin, row->bits, row->roi_pct,
+                          &frame_buf, &frame_cap, row);
+            row->rt = cfg.rts[ti];
+            print_progress_done(row);
+            completed = ++idx;
+          }
         }
       }
     }
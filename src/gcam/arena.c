@@ -0,0 +1,156 @@
+/* ---------------------------------------------------------------- *
+ *
+ * arena.c
+ *
+ * scratch arenas: a block allocated at setup, handed out by bumping
+ * an offset and given back with arena_release() to a mark taken on
+ * entry. A request that does not fit is malloc'ed separately (freed
+ * again at its release); the arena then grows to the high-water mark
+ * at the next release to 0, so a wrong size costs mallocs, not frames.
+ * An arena is not locked: one per thread (or per lock).
+ *
+ * alloc_count(): mallocs by the calling thread, for debugging. By
+ * default only those of the arenas; with -DALLOC_TEST=1 (glibc) every
+ * malloc(), calloc(), realloc() and posix_memalign() is counted.
+ *
+ * ---------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "arena.h"
+
+/* ---------------------------------------------------------------- */
+
+typedef struct spill_tag {             /* header of an overflow block */
+  struct spill_tag *next;
+  size_t           offs;               /* 'used' when allocated */
+} Spill;
+
+#define SPILL_HEAD       ARENA_ALIGN   /* sizeof(Spill), aligned */
+
+static __thread long nalloc=0;         /* mallocs by this thread */
+
+/* ---------------------------------------------------------------- */
+
+static void* amalloc(size_t n)
+{
+  void *p;
+
+#if !(ALLOC_TEST > 0)
+  nalloc++;                            /* counted by posix_memalign() */
+#endif
+  if (posix_memalign(&p,ARENA_ALIGN,n)) return NULL;
+  return p;
+}
+
+/* ---------------------------------------------------------------- */
+/* (re)size to at least 'size' bytes, releases everything;         */
+/* does not allocate if the arena is already large enough          */
+
+int arena_init(Arena* a,size_t size)
+{
+  a->high = 0;                         /* no growth */
+  arena_release(a,0);
+  if (a->base && (size <= a->size)) return 0;
+
+  if (a->base) free((void*)a->base);
+  a->base = (char*)amalloc(size);
+  a->size = (a->base) ? size : 0;
+  return (a->base) ? 0 : -1;
+}
+
+/* ---------------------------------------------------------------- */
+/* 'n' bytes, aligned to ARENA_ALIGN; NULL if out of memory         */
+
+void* arena_alloc(Arena* a,size_t n)
+{
+  char  *p;
+  Spill *s;
+
+  n = (n+ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1);
+  if (a->used+n <= a->size) {          /* fits */
+    p = a->base + a->used;
+  } else {                             /* spill */
+    s = (Spill*)amalloc(SPILL_HEAD+n);
+    if (!s) return NULL;
+    s->next = (Spill*)a->spill;
+    s->offs = a->used;
+    a->spill = (void*)s;
+    p = (char*)s + SPILL_HEAD;
+  }
+  a->used += n;
+  if (a->used > a->high) a->high = a->used;
+  return (void*)p;
+}
+
+/* ---------------------------------------------------------------- */
+/* give back everything allocated after 'mark' (arena_mark())       */
+
+void arena_release(Arena* a,size_t mark)
+{
+  Spill *s;
+
+  while ((s = (Spill*)a->spill) && (s->offs >= mark)) {
+    a->spill = (void*)s->next;
+    free((void*)s);
+  }
+  a->used = mark;
+
+  if ((mark == 0) && (a->high > a->size)) {  /* grow */
+    if (a->base) free((void*)a->base);
+    a->base = (char*)amalloc(a->high);
+    a->size = (a->base) ? a->high : 0;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void arena_free(Arena* a)
+{
+  arena_release(a,0);
+  if (a->base) free((void*)a->base);
+  a->base = NULL;
+  a->size = a->used = a->high = 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+long alloc_count(void)
+{
+  return nalloc;
+}
+
+/* ---------------------------------------------------------------- */
+
+#if (ALLOC_TEST > 0)                   /* glibc: count, then forward */
+
+extern void* __libc_malloc(size_t);
+extern void* __libc_calloc(size_t,size_t);
+extern void* __libc_realloc(void*,size_t);
+extern void* __libc_memalign(size_t,size_t);
+
+void* malloc(size_t n)
+{
+  nalloc++; return __libc_malloc(n);
+}
+
+void* calloc(size_t m,size_t n)
+{
+  nalloc++; return __libc_calloc(m,n);
+}
+
+void* realloc(void* p,size_t n)
+{
+  nalloc++; return __libc_realloc(p,n);
+}
+
+int posix_memalign(void** p,size_t align,size_t n)
+{
+  nalloc++; *p = __libc_memalign(align,n);
+  return (*p) ? 0 : ENOMEM;
+}
+
+#endif
+
+/* ---------------------------------------------------------------- */
@@ -0,0 +1,42 @@
+/* ----------------------------------------------------------------
+ *
+ * arena.h
+ *
+ * scratch arenas: one per thread, sized at box/ROI setup, so the
+ * guide and display loops do not call malloc() per frame
+ *
+ * ---------------------------------------------------------------- */
+
+#ifndef INCLUDE_ARENA_H
+#define INCLUDE_ARENA_H
+
+#include <stddef.h>
+
+/* ---------------------------------------------------------------- */
+
+#ifndef ALLOC_TEST
+#define ALLOC_TEST       0              /* 1: count all mallocs (glibc) */
+#endif
+
+#define ARENA_ALIGN      32             /* bytes, AVX */
+
+typedef struct {
+  char    *base;                       /* [size] */
+  size_t  size,used;                   /* used > size: spilled */
+  size_t  high;                        /* high-water mark */
+  void    *spill;                      /* overflow blocks, malloc'ed */
+} Arena;
+
+/* ---------------------------------------------------------------- */
+
+int     arena_init   (Arena*,size_t);
+void*   arena_alloc  (Arena*,size_t);
+void    arena_release(Arena*,size_t);
+void    arena_free   (Arena*);
+long    alloc_count  (void);
+
+#define arena_mark(a)    ((a)->used)
+
+/* ---------------------------------------------------------------- */
+
+#endif /* INCLUDE_ARENA_H */
@@ -8,6 +8,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 
@@ -21,137 +22,299 @@
 
 /* ---------------------------------------------------------------- */
 
-/* Note: 'static' and 'inline' make code slower */
-
-double gauss2d(Pixel p,double x0,double y0,double bias,
-               double peak,double f2)
+void show_a(double *a,int n)  /* 'static' complains about non-usage */
 {
-  double xx = ((double)p.x-x0);
-  double yy = ((double)p.y-y0);
-  double pexp =  bias + peak*exp(-(xx*xx+yy*yy)/f2);
-
-  return pexp;
+  int i;
+  for (i=0; i<n; i++) printf(" %7.3f",a[i]);
 }
 
-/* --- */
+/* ---------------------------------------------------------------- */
 
-double gauss1d(Pixel p,double y0,double bias,
-               double peak,double f2)
-{
-  double yy = ((double)p.y-y0);
-  double pexp =  bias + peak*exp(-(yy*yy)/f2);
+/* Levenberg-Marquardt with analytic derivatives: one pass over the
+ * pixels (one exp() each) gives chi^2, alpha=J'J and beta=J'r */
 
-  return pexp;
-}
+#define LM_NMAX    5
+#define LM_LAMBDA  1.0e-3              /* initial damping */
+#define LM_LMAX    1.0e7               /* no downhill step left */
+#define LM_DCHI    1.0e-9              /* converged: relative chi^2 gain */
 
-/* ---------------------------------------------------------------- */
+typedef double (*LmSums)(void*,int,const double*,double*,double*);
 
-static double get_chi2(Pixel* p,int n,double *a)
+/* --- */
+
+static double lm_star(void* data,int n,const double* a,double* al,double* be)
 {
-  int    i;
-  double f,chi=0.0;
+  int    i,j,k;
+  Pixel  *p = (Pixel*)data;
+  const int ndeg=5;
+  double dx,dy,r2,e,pe,r,d[5],chi=0.0;
   double bias = a[0];
   double x0 = a[1];
   double y0 = a[2];
   double peak = a[3];
-  double f22 = 2.0*a[4]*a[4];          /* 2*sigma^2 */
-#if (DEBUG > 2)
-  fprintf(stderr,"%s(%p,%d,%p)\n",__func__,p,n,a);
-#endif
+  double s2 = a[4]*a[4];               /* sigma^2 */
+  double s3 = s2*a[4];
 
+  for (j=0; j<ndeg*ndeg; j++) al[j] = 0.0;
+  for (j=0; j<ndeg; j++) be[j] = 0.0;
   for (i=0; i<n; i++) {
-    f = gauss2d(p[i],x0,y0,bias,peak,f22) - p[i].z;
-    chi += f*f;
+    dx = (double)p[i].x-x0;
+    dy = (double)p[i].y-y0;
+    r2 = dx*dx+dy*dy;
+    e  = exp(-r2/(2.0*s2));
+    pe = peak*e;
+    r  = p[i].z - (bias+pe);           /* residual */
+    chi += r*r;
+    d[0] = 1.0;                        /* d(model)/d(a[j]) */
+    d[1] = pe*dx/s2;
+    d[2] = pe*dy/s2;
+    d[3] = e;
+    d[4] = pe*r2/s3;
+    for (j=0; j<ndeg; j++) {
+      be[j] += d[j]*r;
+      for (k=0; k<=j; k++) al[j*ndeg+k] += d[j]*d[k];
+    }
   }
+  for (j=0; j<ndeg; j++) for (k=0; k<j; k++) al[k*ndeg+j] = al[j*ndeg+k];
   return chi;
 }
 
 /* --- */
 
-static double get_chi1(Pixel* p,int n,double *a)
+static double lm_profile(void* data,int n,const double* a,double* al,
+                         double* be)
 {
-  int    i;
-  double f,chi=0.0;
+  int    i,j,k;
+  Pixel  *p = (Pixel*)data;
+  const int ndeg=4;
+  double dy,y2,e,pe,r,d[4],chi=0.0;
   double bias = a[0];
   double y0 = a[1];
   double peak = a[2];
-  double f22 = 2.0*a[3]*a[3];          /* 2*sigma^2 */
-#if (DEBUG > 2)
-  fprintf(stderr,"%s(%p,%d,%p)\n",__func__,p,n,a);
-#endif
+  double s2 = a[3]*a[3];               /* sigma^2 */
+  double s3 = s2*a[3];
 
+  for (j=0; j<ndeg*ndeg; j++) al[j] = 0.0;
+  for (j=0; j<ndeg; j++) be[j] = 0.0;
   for (i=0; i<n; i++) {
-    f = gauss1d(p[i],y0,bias,peak,f22) - p[i].z;
-    chi += f*f;
+    dy = (double)p[i].y-y0;
+    y2 = dy*dy;
+    e  = exp(-y2/(2.0*s2));
+    pe = peak*e;
+    r  = p[i].z - (bias+pe);
+    chi += r*r;
+    d[0] = 1.0;
+    d[1] = pe*dy/s2;
+    d[2] = e;
+    d[3] = pe*y2/s3;
+    for (j=0; j<ndeg; j++) {
+      be[j] += d[j]*r;
+      for (k=0; k<=j; k++) al[j*ndeg+k] += d[j]*d[k];
+    }
   }
+  for (j=0; j<ndeg; j++) for (k=0; k<j; k++) al[k*ndeg+j] = al[j*ndeg+k];
   return chi;
 }
 
-/* ---------------------------------------------------------------- */
+/* --- */
 
-void show_a(double *a,int n)  /* 'static' complains about non-usage */
+/* exp(x) for -87 <= x <= 0: x = k*ln2+r, 2^k*poly(r), rel. error < 3e-7;
+ * branch-free so that the loops over it vectorize */
+
+static inline float fexp(float x)
 {
-  int i;
-  for (i=0; i<n; i++) printf(" %7.3f",a[i]);
+  union { float f; int i; } u;
+  float k,r,p;
+
+  x = fmaxf(x,-87.0f);
+  u.f = x*1.44269504f + 12582912.0f;   /* round(x/ln2) in the mantissa */
+  k = u.f - 12582912.0f;
+  r = x - k*0.693145752f - k*1.42860677e-6f;
+  p = 1.0f+r*(1.0f+r*(0.5f+r*(1.6666667e-1f+r*(4.1666668e-2f+
+      r*(8.3333338e-3f+r*1.3888889e-3f)))));
+  u.i = (u.i - 0x4B400000 + 127) << 23;  /* 2^k */
+  return p*u.f;
 }
 
 /* --- */
 
-int fit_star(Pixel* x,int n,double* a,int itmax)
+/* 2D Gaussian on a PixelGrid: float32 SoA, exp(-dx^2)*exp(-dy^2) needs
+ * w+h exps per pass. With q=exp(-dx^2) all derivatives along a row are
+ * combinations of m,q,q*dx,q*dx^2, so 14 sums per row (float lanes,
+ * vectorized at -O3) give chi^2, alpha and beta (double); 'n' rows */
+
+#define PG_NSUM    14
+#define PG_EMIN    -20.0f              /* exp() below: 0, no denormals */
+
+static double lm_grid(void* data,int n,const double* a,double* al,double* be)
 {
-  int    it,i,conv=0;
+  int    i,j,k,l;
   const int ndeg=5;
-  double da[5]   = {1.0,0.5  ,0.5  ,2.0,0.05}; /* bias,x0,y0,peak,fwhm */
-  double alim[5] = {0.1,0.002,0.002,0.2,0.002};
-  double dc[5],dcold[5],chi,chi1,chi2,chiold,sumdc;
-#if (TIME_TEST > 0)
-  double t1 = walltime(0);
-  static double s1=0,s2=0,sn=0;
-#endif
+  PixelGrid *g = (PixelGrid*)data;
+  float  acc[PG_NSUM][PG_LANES],e;
+  double sum[PG_NSUM],chi=0.0;
+  double bias = a[0];
+  double peak = a[3];
+  double is2 = 1.0/(a[4]*a[4]);        /* 1/sigma^2 */
+  double is3 = is2/a[4];
+  float  f2 = (float)(-0.5*is2);
+  float  *ex=g->ex,*dx=g->dx,*ey=g->ey,*dy=g->dy;
+
+  for (i=0; i<g->stride; i++) {
+    dx[i] = (float)(g->x0+i-a[1]);
+    e = f2*dx[i]*dx[i];
+    ex[i] = ((i < g->w) && (e > PG_EMIN)) ? fexp(e) : 0.0f;
+  }
+  for (j=0; j<n; j++) {
+    dy[j] = (float)(g->y0+j-a[2]);
+    e = f2*dy[j]*dy[j];
+    ey[j] = (e > PG_EMIN) ? fexp(e) : 0.0f;
+  }
+  for (k=0; k<ndeg*ndeg; k++) al[k] = 0.0;
+  for (k=0; k<ndeg; k++) be[k] = 0.0;
+  for (j=0; j<n; j++) {
+    const float *z = g->z + j*g->stride;
+    const float *m = g->m + j*g->stride;
+    const float fb = (float)bias;
+    const float fp = (float)peak*ey[j];
+    double E=ey[j],Y=dy[j],Y2=Y*Y,P=peak*E,u,v,w;
+    for (k=0; k<PG_NSUM; k++) for (l=0; l<PG_LANES; l++) acc[k][l] = 0.0f;
+    for (i=0; i<g->stride; i+=PG_LANES) {
+      for (l=0; l<PG_LANES; l++) {
+        float q  = ex[i+l]*m[i+l];
+        float x  = dx[i+l];
+        float r  = m[i+l]*(z[i+l]-fb) - fp*q;  /* residual */
+        float q1 = q*x;
+        float q2 = q1*x;
+        acc[ 0][l] += r*r;
+        acc[ 1][l] += r;
+        acc[ 2][l] += r*q;
+        acc[ 3][l] += r*q1;
+        acc[ 4][l] += r*q2;
+        acc[ 5][l] += m[i+l];
+        acc[ 6][l] += q;
+        acc[ 7][l] += q1;
+        acc[ 8][l] += q2;
+        acc[ 9][l] += q*q;
+        acc[10][l] += q*q1;
+        acc[11][l] += q*q2;
+        acc[12][l] += q1*q2;
+        acc[13][l] += q2*q2;
+      }
+    }
+    for (k=0; k<PG_NSUM; k++) {
+      for (l=1; l<PG_LANES; l++) acc[k][0] += acc[k][l];
+      sum[k] = acc[k][0];
+    }
+    /* d0=m, d1=P*q*x*is2, d2=P*q*Y*is2, d3=E*q, d4=P*q*(x^2+Y^2)*is3 */
+    chi   += sum[0];
+    u = P*is2; v = u*Y; w = P*is3;
+    be[0] += sum[1];
+    be[1] += u*sum[3];
+    be[2] += v*sum[2];
+    be[3] += E*sum[2];
+    be[4] += w*(sum[4]+Y2*sum[2]);
+    al[0]  += sum[5];
+    al[5]  += u*sum[7];
+    al[6]  += u*u*sum[11];
+    al[10] += v*sum[6];
+    al[11] += u*v*sum[10];
+    al[12] += v*v*sum[9];
+    al[15] += E*sum[6];
+    al[16] += E*u*sum[10];
+    al[17] += E*v*sum[9];
+    al[18] += E*E*sum[9];
+    al[20] += w*(sum[8]+Y2*sum[6]);
+    al[21] += w*u*(sum[12]+Y2*sum[10]);
+    al[22] += w*v*(sum[11]+Y2*sum[9]);
+    al[23] += w*E*(sum[11]+Y2*sum[9]);
+    al[24] += w*w*(sum[13]+2.0*Y2*sum[11]+Y2*Y2*sum[9]);
+  }
+  for (j=0; j<ndeg; j++) for (k=0; k<j; k++) al[k*ndeg+j] = al[j*ndeg+k];
+  return chi;
+}
 
-  for (i=0; i<ndeg; i++) dcold[i] = 0.0;
-  chi = chiold = get_chi2(x,n,a);
+/* --- */
+
+static int lm_solve(double* m,double* b,int n) /* Gauss-Jordan, in place */
+{
+  int    i,j,k,ip;
+  double t;
+
+  for (i=0; i<n; i++) {
+    for (j=i+1,ip=i; j<n; j++) if (fabs(m[j*n+i]) > fabs(m[ip*n+i])) ip = j;
+    if (m[ip*n+i] == 0.0) return -1;   /* singular */
+    if (ip != i) {
+      for (k=0; k<n; k++) { t = m[i*n+k]; m[i*n+k] = m[ip*n+k]; m[ip*n+k] = t; }
+      t = b[i]; b[i] = b[ip]; b[ip] = t;
+    }
+    for (j=0; j<n; j++) if (j != i) {
+      t = m[j*n+i]/m[i*n+i];
+      for (k=i; k<n; k++) m[j*n+k] -= t*m[i*n+k];
+      b[j] -= t*b[i];
+    }
+  }
+  for (i=0; i<n; i++) b[i] /= m[i*n+i];
+  return 0;
+}
+
+/* --- */
+/* returns 0: converged, 1: not converged (itmax), 2: failed (singular */
+/* system, e.g. a zero peak has no x0,y0,sigma derivatives)            */
+
+static int lm_fit(void* x,int n,double* a,int ndeg,const double* alim,
+                  int itmax,LmSums sums)
+{
+  int    it,i,j,conv=0;
+  double al[LM_NMAX*LM_NMAX],be[LM_NMAX],m[LM_NMAX*LM_NMAX],da[LM_NMAX];
+  double al1[LM_NMAX*LM_NMAX],be1[LM_NMAX],a1[LM_NMAX];
+  double chi,chi1,lambda=LM_LAMBDA;
+  assert(ndeg <= LM_NMAX);
 
+  chi = sums(x,n,a,al,be);
   for (it=1; it<=itmax; it++) {
-    for (i=0; i<ndeg; i++) {
-      assert(da[i] > 0);
-      a[i] += da[i];                   /* test small +variation */
-      chi1 = get_chi2(x,n,a);
-      a[i] -= 2*da[i];                 /* test small -variation */
-      chi2 = get_chi2(x,n,a);
-      a[i] += da[i];                   /* restore */
-      dc[i] = chi1-chi2;
-      if ((chi1 > chiold) && (chi2 > chiold)) {  /* found minimum */
-        dc[i] = 0.0;
-        if (da[i] >= alim[i]) { 
-          da[i] *= 0.5;  // printf("SHRINK(%d)\n",i); 
-          if (da[i] < alim[i]) conv++;
-        }
-      } else 
-      if (dc[i]*dcold[i] < 0) {                  /* change of sign */
-        if (da[i] >= alim[i]) {
-          da[i] *= 0.3;  // printf("TURN(%d)\n",i);
-          if (da[i] < alim[i]) conv++;
-        }
-      }
-      dcold[i] = dc[i];
-      // show_a(da); printf(" dc=%.2f\n",dc[i]);
-    } /* endfor(i<ndeg) */
-    for (i=0,sumdc=0; i<ndeg; i++) sumdc += fabs(dc[i]);
-    if (sumdc > 0) {
-      for (i=0; i<ndeg; i++) {         /* apply weighted change */
-        a[i] -= 2.0*da[i]*(dc[i]/sumdc);
+    for (i=0; i<ndeg*ndeg; i++) m[i] = al[i];
+    for (i=0; i<ndeg; i++) { m[i*ndeg+i] *= 1.0+lambda; da[i] = be[i]; }
+    if (lm_solve(m,da,ndeg)) return 2; /* singular: no fit */
+    for (i=0; i<ndeg; i++) a1[i] = a[i]+da[i];
+    chi1 = sums(x,n,a1,al1,be1);       /* residuals+derivatives at 'a1' */
+    if (chi1 < chi) {                  /* accept step */
+      for (i=0,conv=1; i<ndeg; i++) {  /* small step ... */
+        if (fabs(da[i]) >= alim[i]) conv = 0;
       }
+      if (chi-chi1 < LM_DCHI*chi1) conv = 1;  /* ... or no gain */
+      for (i=0; i<ndeg; i++) { a[i] = a1[i]; be[i] = be1[i]; }
+      for (j=0; j<ndeg*ndeg; j++) al[j] = al1[j];
+      chi = chi1;
+      lambda = fmax(0.1*lambda,1.0e-9);
+    } else {                           /* reject, damp */
+      lambda *= 10.0;
+      conv = (lambda > LM_LMAX);       /* at minimum */
     }
-    chi = get_chi2(x,n,a);
-    // show_a(a); printf(" it=%4d chi=%.1f, chiold=%.1f\n",it,chi,chiold);
-    chiold = chi;
-    if (conv == ndeg) break;
+    // show_a(a,ndeg); printf(" it=%d chi=%.1f lambda=%.0e\n",it,chi,lambda);
+    if (conv) break;
   }
 #if (DEBUG > 1)
-  show_a(a,ndeg); printf(" it=%d chiold=%.1f conv=%d (%d)\n",it,chi,conv,itmax);
+  show_a(a,ndeg); printf(" it=%d chi=%.1f conv=%d (%d)\n",it,chi,conv,itmax);
+#endif
+  return (conv) ? 0 : 1;
+}
+
+/* ---------------------------------------------------------------- */
+
+int fit_star(Pixel* x,int n,double* a,int itmax)
+{
+  int    r;
+  const double alim[5] = {0.1,0.002,0.002,0.2,0.002}; /* bias,x0,y0,peak,sig */
+#if (TIME_TEST > 0)
+  double t1 = walltime(0);
+  static double s1=0,s2=0,sn=0;
 #endif
 
+  if (a[3] <= 0.0) return 2;           /* no star to start from */
+  r = lm_fit(x,n,a,5,alim,itmax,lm_star);
+  a[4] = fabs(a[4]);                   /* only sigma^2 matters */
+
 #if (TIME_TEST > 0)
   double t2 = walltime(0)-t1;
   s1 = 0.8*s1 + 0.2*t2;
@@ -166,68 +329,24 @@ int fit_star(Pixel* x,int n,double* a,int itmax)
   printf("walltime=%.3f msec (%.1f,%.2f)\n",1000.0*t2,1000.0*ave,sig);
 #endif
 
-  return (it < itmax) ? 0 : 1;
+  return r;
 }
 
 /* --- */
 
 int fit_profile4(Pixel* x,int n,double* a,int itmax)
 {
-  int    it,i,conv=0;
-  const int ndeg=4;
-  double da[4]   = { 5.0,0.5  , 5.0,0.05};  /* bias,y0,peak,fwhm */
-  double alim[4] = { 0.5,0.002, 0.5,0.002};
-  double dc[4],dcold[4],chi,chi1,chi2,chiold,sumdc;
+  int    r;
+  const double alim[4] = {0.5,0.002,0.5,0.002}; /* bias,y0,peak,sigma */
 #if (TIME_TEST > 0)
   double t1 = walltime(0);
   static double s1=0,s2=0,sn=0;
 #endif
 
-  for (i=0; i<ndeg; i++) dcold[i] = 0.0;
-  chi = chiold = get_chi1(x,n,a);
-#if (DEBUG > 1)
-  show_a(a,ndeg); printf(" chi=%.1e\n",chi); 
-#endif
+  if (a[2] <= 0.0) return 2;           /* no star to start from */
+  r = lm_fit(x,n,a,4,alim,itmax,lm_profile);
+  a[3] = fabs(a[3]);
 
-  for (it=1; it<=itmax; it++) {
-    for (i=0; i<ndeg; i++) {
-      assert(da[i] > 0);
-      a[i] += da[i];                   /* test small +variation */
-      chi1 = get_chi1(x,n,a);
-      a[i] -= 2*da[i];                 /* test small -variation */
-      chi2 = get_chi1(x,n,a);
-      a[i] += da[i];                   /* restore */
-      dc[i] = chi1-chi2;
-      if ((chi1 > chiold) && (chi2 > chiold)) {  /* found minimum */
-        dc[i] = 0.0;
-        if (da[i] >= alim[i]) { 
-          da[i] *= 0.5;  // printf("SHRINK(%d)\n",i); 
-          if (da[i] < alim[i]) conv++;
-        }
-      } else 
-      if (dc[i]*dcold[i] < 0) {        /* change of sign */
-        if (da[i] >= alim[i]) {
-          da[i] *= 0.3;  // printf("TURN(%d)\n",i);
-          if (da[i] < alim[i]) conv++;
-        }
-      }
-      dcold[i] = dc[i];
-      // show_a(da); printf(" dc=%.2f\n",dc[i]);
-    } /* endfor(i<ndeg) */
-    for (i=0,sumdc=0; i<ndeg; i++) sumdc += fabs(dc[i]);
-    if (sumdc > 0) {
-      for (i=0; i<ndeg; i++) {         /* apply weighted change */
-        a[i] -= 2.0*da[i]*(dc[i]/sumdc);
-      }
-    }
-    chi = get_chi1(x,n,a);
-    // show_a(a); printf(" it=%4d chi=%.1f, chiold=%.1f\n",it,chi,chiold);
-    chiold = chi;
-    if (conv == ndeg) break;
-  }
-#if (DEBUG > 1)
-  show_a(a,ndeg); printf(" old=%.1e it=%d conv=%d (%d)\n",chi,it,conv,itmax);
-#endif
 #if (TIME_TEST > 0)
   double t2 = walltime(0)-t1;
   s1 = 0.8*s1 + 0.2*t2;
@@ -242,7 +361,103 @@ int fit_profile4(Pixel* x,int n,double* a,int itmax)
   printf("walltime=%.3f msec (%.1f,%.2f)\n",1000.0*t2,1000.0*ave,sig);
 #endif
 
-  return (it < itmax) ? 0 : 1;
+  return r;
+}
+
+/* ---------------------------------------------------------------- */
+
+int pgrid_alloc(PixelGrid* g,int w,int h) /* grow only */
+{
+  int    stride = (w+PG_LANES-1)/PG_LANES*PG_LANES;
+  int    n = 2*stride*h + 2*stride + 2*h;
+  float  *buf;
+
+  if ((w < 1) || (h < 1)) return -1;
+  if (n > g->nmax) {
+    if (posix_memalign((void**)&buf,32,n*sizeof(float))) return -1;
+    free((void*)g->z);
+    g->z = buf;
+    g->nmax = n;
+  }
+  g->w = w; g->h = h; g->stride = stride;
+  g->m  = g->z + stride*h;
+  g->ex = g->m + stride*h;
+  g->dx = g->ex + stride;
+  g->ey = g->dx + stride;
+  g->dy = g->ey + h;
+  return 0;
+}
+
+/* --- */
+
+void pgrid_free(PixelGrid* g)
+{
+  free((void*)g->z);
+  memset(g,0,sizeof(PixelGrid));
+}
+
+/* --- */
+
+int pgrid_box(PixelGrid* g,const unsigned short* data,int fw,int fh,
+              int ix,int iy,int vrad)
+{ /* copy the box at 'ix,iy' (clipped to the frame), return peak pixel */
+  int    x,y,x1,x2,y1,y2,v,ppix=0;
+
+  x1 = (ix-vrad < 0) ? 0 : ix-vrad;
+  x2 = (ix+vrad >= fw) ? fw-1 : ix+vrad;
+  y1 = (iy-vrad < 0) ? 0 : iy-vrad;
+  y2 = (iy+vrad >= fh) ? fh-1 : iy+vrad;
+  if ((x2 < x1) || (y2 < y1)) return -1;
+  if (pgrid_alloc(g,x2-x1+1,y2-y1+1)) return -1;
+  g->x0 = x1; g->y0 = y1;
+  for (y=y1; y<=y2; y++) {
+    float *z = g->z + (y-y1)*g->stride;
+    float *m = g->m + (y-y1)*g->stride;
+    for (x=x1; x<=x2; x++) {
+      v = data[x+y*fw]; if (v > ppix) ppix = v;
+      z[x-x1] = (float)v;
+      m[x-x1] = 1.0f;
+    }
+    for (x=g->w; x<g->stride; x++) z[x] = m[x] = 0.0f;
+  }
+  return ppix;
+}
+
+/* --- */
+
+int pgrid_set(PixelGrid* g,const Pixel* p,int n)
+{ /* any pixel list, missing pixels are masked */
+  int    i,x1,x2,y1,y2;
+
+  if (n < 1) return -1;
+  x1 = x2 = p[0].x; y1 = y2 = p[0].y;
+  for (i=1; i<n; i++) {
+    if (p[i].x < x1) x1 = p[i].x; else if (p[i].x > x2) x2 = p[i].x;
+    if (p[i].y < y1) y1 = p[i].y; else if (p[i].y > y2) y2 = p[i].y;
+  }
+  if (pgrid_alloc(g,x2-x1+1,y2-y1+1)) return -1;
+  g->x0 = x1; g->y0 = y1;
+  memset(g->z,0,(size_t)g->stride*g->h*sizeof(float));
+  memset(g->m,0,(size_t)g->stride*g->h*sizeof(float));
+  for (i=0; i<n; i++) {
+    int k = (p[i].x-x1) + (p[i].y-y1)*g->stride;
+    g->z[k] = (float)p[i].z;
+    g->m[k] = 1.0f;
+  }
+  return 0;
+}
+
+/* --- */
+
+int fit_star_grid(PixelGrid* g,double* a,int itmax)
+{
+  int    r;
+  const double alim[5] = {0.1,0.002,0.002,0.2,0.002}; /* bias,x0,y0,peak,sig */
+
+  if (a[3] <= 0.0) return 2;           /* no star to start from */
+  r = lm_fit(g,g->h,a,5,alim,itmax,lm_grid);
+  a[4] = fabs(a[4]);
+  return r;
 }
 
 /* ---------------------------------------------------------------- */
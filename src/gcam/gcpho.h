@@ -8,6 +8,17 @@ typedef struct {
   double z;
 } Pixel;
 
+#define PG_LANES   8                   /* floats per vector step */
+
+typedef struct {                       /* float32 box, structure-of-arrays */
+  int    x0,y0;                        /* origin [pixel] */
+  int    w,h,stride;                   /* stride: 'w' padded to PG_LANES */
+  int    nmax;                         /* allocated floats */
+  float  *z;                           /* [h][stride] data */
+  float  *m;                           /* [h][stride] 1=pixel, 0=none */
+  float  *ex,*dx,*ey,*dy;              /* [stride],[stride],[h],[h] */
+} PixelGrid;
+
 int  ccbphot(Pixel* x,int n,double* fit,int itmax);
 int  ccbprofile(Pixel* x,int n,double* fit,int itmax);
 
@@ -15,3 +26,9 @@ int fit_star    (Pixel* x,int n,double* a,int itmax);
 int fit_profile4(Pixel* x,int n,double* a,int itmax);
 int fit_profile3(Pixel* x,int n,double* a,int itmax);
 
+int  pgrid_alloc(PixelGrid*,int w,int h);
+void pgrid_free (PixelGrid*);
+int  pgrid_box  (PixelGrid*,const unsigned short*,int,int,int,int,int);
+int  pgrid_set  (PixelGrid*,const Pixel*,int);
+int  fit_star_grid(PixelGrid*,double* a,int itmax);
+
@@ -32,6 +32,7 @@
 #define PREFUN          __func__
 
 #define SQRLN22         2.35482
+#define GUIDER_WAIT     200        /* [ms] max. wait for a new frame */
 
 /* ---------------------------------------------------------------- */
 
@@ -41,8 +42,12 @@ static void run_guider4(void*);
 
 static void tcs_error(Guider *g,int err);
 static int  tcs_recon(Guider *g);
+#if (ALLOC_TEST > 0)
+static void alloc_check(const char*,long*);
+#endif
 
 static int  tcsOpen=0;
+static int  guiderBus=-1;              /* frame bus consumer */
 
 /* ---------------------------------------------------------------- */
 
@@ -74,6 +79,7 @@ void* run_guider(void* param)
         message(g,buf,MSS_ERROR);
       } else edsOpen = 1;
     }
+    guiderBus = zwo_consumer_add(g->server,"guider",ZWO_LATEST,0);
     switch (g->gmode) {
     case GM_PR:
     case GM_SV5:                       /* v0416 */
@@ -90,6 +96,8 @@ void* run_guider(void* param)
       g->gid = 0;
       break;
     }
+    zwo_consumer_remove(g->server,guiderBus);
+    guiderBus = -1;
   } /* endif(err) */
   g->qltool->guiding = g->update_flag = 0;
 
@@ -113,9 +121,9 @@ static void run_guider1(void* param)
   double next_eds=0;
   double r0=1,a0=0,n0=0;               /* gm5 stuff v0416 */
   int    gm5_locked=0;
-  int    ix,iy,ppix=0,vrad=0,npix=0;
-  u_int  seqNumber=0;
-  Pixel  *pbuf=NULL;
+  int    ix,iy,ppix=0,vrad=0;
+  PixelGrid grid={0};                  /* float32 box */
+  Arena  scratch={0};                  /* this thread's scratch */
   Guider *g = (Guider*)param;
   QlTool *qltool = g->qltool;
   ZwoStruct *server = g->server;
@@ -128,15 +136,21 @@ static void run_guider1(void* param)
   t1 = walltime(0);
 #if (DEBUG > 2)
   int debug_cnt=0;
+#endif
+#if (ALLOC_TEST > 0)
+  long nalloc = alloc_count();
 #endif
   while (g->loop_running && qltool->guiding) {
-    msleep(20);
-    ZwoFrame *frame = zwo_frame4reading(server,seqNumber);
+    ZwoFrame *frame = zwo_consumer_get(server,guiderBus,GUIDER_WAIT);
     if (frame) {
-      seqNumber = frame->seqNumber;
+      if (vrad != qltool->vrad) {      /* box size changed */
+        vrad = qltool->vrad;
+        (void)pgrid_alloc(&grid,1+2*vrad,1+2*vrad);
+        (void)arena_init(&scratch,qltool_scratch(vrad));
+      }
       if (fwhm == 0 || (g->q_flag==2)) {  /* first (or bad) fit */
         fwhm = g->px * get_fwhm(frame->data,frame->w,frame->h,ix,iy,
-                         qltool->vrad,1.0,1.0,&back,&cx,&cy,&peak,&flux);
+                         vrad,1.0,1.0,&back,&cx,&cy,&peak,&flux,&scratch);
         if (!(fwhm > 0)) fwhm = 0.8;   /* default [arcsec] */
       }
 #if (DEBUG > 1)
@@ -144,12 +158,6 @@ static void run_guider1(void* param)
              back,cx,cy,peak,fwhm);
 #endif
       assert(fwhm > 0);
-      if (vrad != qltool->vrad) {      /* box size changed */
-        vrad = qltool->vrad;
-        npix =(1+2*vrad) * (1+2*vrad);
-        pbuf = (Pixel*)realloc(pbuf,npix*sizeof(Pixel));
-      }
-      assert(npix); assert(pbuf);
       if (g->gmode == GM_SV5) {        /* gm5 mode v0416 */
         if (qltool->guiding < 0) gm5_locked = 0;
         if (!gm5_locked) {             /* store distance and angle */
@@ -190,29 +198,15 @@ static void run_guider1(void* param)
           ix = (int)my_round(gx,0); iy = (int)my_round(gy,0);
         }
       } /* endif(SV5) */
-      if (fwhm > 0) { int x,y,v,xx,yy,i=0; /* we have a valid estimate */
-        for (xx=-vrad,ppix=0; xx<=vrad; xx++) {  /* loop over box */
-          x = ix + xx;
-          if (x < 0) continue;             /* outside frame */
-          if (x >= frame->w) break;
-          for (yy=-vrad; yy<=vrad; yy++) {
-            y = iy + yy;
-            if (y < 0) continue;
-            if (y >= frame->h) break;
-            pbuf[i].x = x;
-            pbuf[i].y = y;
-            v = frame->data[x+y*frame->w]; if (v > ppix) ppix = v;
-            pbuf[i].z = (double)v;
-            i++;
-          }
-        } 
-        assert(i <= npix);
+      if (fwhm > 0) {                  /* we have a valid estimate */
+        ppix = pgrid_box(&grid,frame->data,frame->w,frame->h,ix,iy,vrad);
         fit[0] = back;
         fit[1] = cx;
         fit[2] = cy;
         fit[3] = peak;                 /* peak of gauss -- not peak pixel */
         fit[4] = fwhm/(SQRLN22*g->px); /* sigma [pixels] */
-        g->q_flag = fit_star(pbuf,i,fit,400);
+        if (ppix < 0) { ppix = 0; g->q_flag = 2; }  /* no memory */
+        else g->q_flag = fit_star_grid(&grid,fit,400);
         back = fit[0];
         cx   = fit[1];
         cy   = fit[2];
@@ -293,13 +287,17 @@ static void run_guider1(void* param)
       pthread_mutex_unlock(&g->mutex);
 #if (DEBUG > 2)
       debug_cnt++; printf("_cnt=%d\n",debug_cnt);
+#endif
+#if (ALLOC_TEST > 0)
+      alloc_check(PREFUN,&nalloc);
 #endif
     } // endif(frame)
   } // endwhile(loop-doing && guiding)
 
   qltool->arc_radius = 0;
 
-  free((void*)pbuf);
+  pgrid_free(&grid);
+  arena_free(&scratch);
 }
 
 /* ---------------------------------------------------------------- */
@@ -309,20 +307,24 @@ static void run_guider3(void* param)          /* v0350 */
   double t1,t2,last;
   double rx=0,ry=0,dx,dy,azerr,elerr,flux;
   int    ix,iy;
-  u_int  seqNumber=0,counter=0;
+  u_int  counter=0;
+  Arena  scratch={0};                  /* this thread's scratch */
   Guider *g = (Guider*)param;
   QlTool *qltool = g->qltool;
   ZwoStruct *server = g->server;
 
+  (void)arena_init(&scratch,qltool_scratch(qltool->vrad));
+#if (ALLOC_TEST > 0)
+  long nalloc = alloc_count();
+#endif
   last = t1 = walltime(0);
   while (g->loop_running && qltool->guiding) {
-    msleep(20);
-    ZwoFrame *frame = zwo_frame4reading(server,seqNumber);
+    ZwoFrame *frame = zwo_consumer_get(server,guiderBus,GUIDER_WAIT);
     if (frame) {
-      seqNumber = frame->seqNumber;
       ix = (int)my_round(qltool->curx[QLT_BOX],0);
       iy = (int)my_round(qltool->cury[QLT_BOX],0);
-      get_quads(frame->data,frame->w,frame->h,ix,iy,qltool->vrad,&rx,&ry,&flux);
+      get_quads(frame->data,frame->w,frame->h,ix,iy,qltool->vrad,&rx,&ry,&flux,
+                &scratch);
       zwo_frame_release(server,frame);
       t2 = walltime(0);
       pthread_mutex_lock(&g->mutex);
@@ -356,8 +358,13 @@ static void run_guider3(void* param)          /* v0350 */
       } /* endif(counter) */
       g->update_flag = True;           /* update GUI */
       pthread_mutex_unlock(&g->mutex);
+#if (ALLOC_TEST > 0)
+      alloc_check(PREFUN,&nalloc);
+#endif
     } // endif(frame)
   } // endwhile(loop-doing && guiding)
+
+  arena_free(&scratch);
 }
 
 /* ---------------------------------------------------------------- */
@@ -369,18 +376,19 @@ static void run_guider4(void* param)          /* v0404 */
   double dx=0,dy=0,rx,ry,ody=0,ddy,odx=0,ddx,drx,gx,gy,azerr,elerr;
   double back,fwhm=0,flux,cy=0,scale;
   int    ix,iy,vrad=0,ppix,v;
-  u_int  seqNumber=0;
   Guider *g = (Guider*)param;
   QlTool *qltool = g->qltool;
   ZwoStruct *server = g->server;
   Pixel *pbuf=NULL;
+  Arena scratch={0};                   /* this thread's scratch */
 
   t1 = walltime(0);
+#if (ALLOC_TEST > 0)
+  long nalloc = alloc_count();
+#endif
   while (g->loop_running && qltool->guiding) {
-    msleep(20);
-    ZwoFrame *frame = zwo_frame4reading(server,seqNumber);
+    ZwoFrame *frame = zwo_consumer_get(server,guiderBus,GUIDER_WAIT);
     if (frame) { int x,y,xx,yy,npix,n; double s,pk1=0,pk2=0,pk3=0;
-      seqNumber = frame->seqNumber;
       gx = my_round(qltool->curx[QLT_BOX],1); /* 0.1 pixel resolution */
       gy = my_round(qltool->cury[QLT_BOX],1);
       ix = (int)my_round(gx,0);
@@ -388,7 +396,9 @@ static void run_guider4(void* param)          /* v0404 */
       if (vrad != qltool->vrad) {      /* aperture/cross size */
         vrad = qltool->vrad;
         npix = 1+2*vrad;
-        pbuf = (Pixel*)realloc(pbuf,npix*sizeof(Pixel));
+        (void)arena_init(&scratch,npix*sizeof(Pixel)+ARENA_ALIGN+
+                                  qltool_scratch(vrad));
+        pbuf = (Pixel*)arena_alloc(&scratch,npix*sizeof(Pixel)); /* kept */
       }
       for (n=0,yy=-vrad,ppix=0; yy<=vrad; yy++) { /* get profile along y-axis */
         y = iy + yy;
@@ -409,7 +419,8 @@ static void run_guider4(void* param)          /* v0404 */
         n++;
       } 
       assert(n <= npix);
-      back = get_quads(frame->data,frame->w,frame->h,ix,iy,vrad,&rx,&ry,&flux);
+      back = get_quads(frame->data,frame->w,frame->h,ix,iy,vrad,&rx,&ry,&flux,
+                       &scratch);
 #if (DEBUG > 1)
       printf("\nb=%.0f rx=%.3f flux=%.0f p=%.0f,%.0f,%.0f\n",back,rx,flux,pk1,pk2,pk3);
 #endif
@@ -480,8 +491,13 @@ static void run_guider4(void* param)          /* v0404 */
       } /* q_flag */
       g->update_flag = True;           /* update GUI */
       pthread_mutex_unlock(&g->mutex);
+#if (ALLOC_TEST > 0)
+      alloc_check(PREFUN,&nalloc);
+#endif
     } // endif(frame)
   } // endwhile(loop-doing && guiding)
+
+  arena_free(&scratch);
 }
 
 /* ---------------------------------------------------------------- */
@@ -526,6 +542,20 @@ static int tcs_recon(Guider *g)        /* v0417 */
   return err;
 }
 
+/* --- */
+
+#if (ALLOC_TEST > 0)
+
+static void alloc_check(const char* fn,long* nalloc)
+{                                      /* mallocs since the last call */
+  long n = alloc_count() - *nalloc;
+
+  if (n) printf("%s(): %ld malloc(s) in this guide iteration\n",fn,n);
+  *nalloc = alloc_count();             /* after printf() */
+}
+
+#endif
+
 /* ---------------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -0,0 +1,99 @@
+/* ---------------------------------------------------------------- *
+ *
+ * pctile.c
+ *
+ * exact order statistics of 16-bit pixels without sorting. Boxes:
+ * one pass counts the high bytes (256 bins), which picks the bin of
+ * every wanted rank, a second pass counts the low bytes of only the
+ * values in those bins. Frame samples: the caller fills a counting
+ * histogram, PCT_NBIN bins, and the ranks come from one cumulative
+ * walk. The result is the same as 'sorted[k]'.
+ *
+ * ---------------------------------------------------------------- */
+
+#include <string.h>
+
+#include "pctile.h"
+
+/* ---------------------------------------------------------------- */
+/* rank of fraction 'f' of 'n' values, as (int)(f*n), in [0,n-1]    */
+
+int pct_rank(int n,double f)
+{
+  int k = (int)(f*n);
+
+  if (k > n-1) k = n-1;
+  if (k < 0)   k = 0;
+  return k;
+}
+
+/* ---------------------------------------------------------------- */
+/* order 'nk' ranks: idx[] sorted by k[] (insertion, nk is small)   */
+
+static int sort_ranks(const int* k,int nk,int n,int* idx)
+{
+  int i,j,t;
+
+  if ((nk < 1) || (nk > PCT_MAXK)) return -1;
+  for (i=0; i<nk; i++) {
+    if ((k[i] < 0) || (k[i] >= n)) return -1;
+    for (j=i,t=i; (j > 0) && (k[idx[j-1]] > k[t]); j--) idx[j] = idx[j-1];
+    idx[j] = t;
+  }
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+/* values 'val' of ranks 'k' (0: smallest) of 'v[0..n-1]'           */
+
+int pct_select(const u_short* v,int n,const int* k,int nk,u_short* val)
+{
+  int   i,j,b,idx[PCT_MAXK],bin[PCT_MAXK],rem[PCT_MAXK];
+  int   slot[256];
+  u_int hi[256],lo[PCT_MAXK][256],c;
+
+  if (sort_ranks(k,nk,n,idx)) return -1;
+
+  memset(hi,0,sizeof(hi));
+  for (i=0; i<n; i++) hi[v[i]>>8]++;   /* pass 1: high bytes */
+
+  memset(slot,-1,sizeof(slot));
+  for (j=0,b=0,c=0; j<nk; j++) {       /* bin of each rank, ascending */
+    while (c+hi[b] <= (u_int)k[idx[j]]) { c += hi[b]; b++; }
+    bin[j] = b;
+    rem[j] = k[idx[j]] - (int)c;       /* rank inside bin */
+    if (slot[b] < 0) slot[b] = j;      /* one 'lo' per distinct bin */
+  }
+
+  memset(lo,0,nk*sizeof(lo[0]));
+  for (i=0; i<n; i++) {                /* pass 2: low bytes */
+    j = slot[v[i]>>8];
+    if (j >= 0) lo[j][v[i]&0xff]++;
+  }
+
+  for (j=0; j<nk; j++) {
+    u_int *l = lo[slot[bin[j]]];       /* shared if same bin */
+    for (b=0,c=0; c+l[b] <= (u_int)rem[j]; b++) c += l[b];
+    val[idx[j]] = (u_short)((bin[j]<<8) | b);
+  }
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+/* values 'val' of ranks 'k' in a counting histogram of 'n' values  */
+
+int pct_hist(const u_int* h,int n,const int* k,int nk,u_short* val)
+{
+  int   j,b,idx[PCT_MAXK];
+  u_int c;
+
+  if (sort_ranks(k,nk,n,idx)) return -1;
+
+  for (j=0,b=0,c=0; j<nk; j++) {       /* one cumulative walk */
+    while (c+h[b] <= (u_int)k[idx[j]]) { c += h[b]; b++; }
+    val[idx[j]] = (u_short)b;
+  }
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
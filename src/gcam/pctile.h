@@ -0,0 +1,29 @@
+/* ----------------------------------------------------------------
+ *
+ * pctile.h
+ *
+ * exact medians and percentiles of 16-bit pixels in linear time:
+ * two-level (256x256) radix select for boxes, 65536-bin counting
+ * histogram for frame samples; no allocation
+ *
+ * ---------------------------------------------------------------- */
+
+#ifndef INCLUDE_PCTILE_H
+#define INCLUDE_PCTILE_H
+
+#include <sys/types.h>
+
+/* ---------------------------------------------------------------- */
+
+#define PCT_NBIN         65536          /* counting histogram bins */
+#define PCT_MAXK         8              /* ranks per call */
+
+/* ---------------------------------------------------------------- */
+
+int  pct_rank    (int,double);
+int  pct_select  (const u_short*,int,const int*,int,u_short*);
+int  pct_hist    (const u_int*,int,const int*,int,u_short*);
+
+/* ---------------------------------------------------------------- */
+
+#endif /* INCLUDE_PCTILE_H */
@@ -69,6 +69,7 @@ enum scaling_modes { SCALE_CUTS,SCALE_MED,SCALE_MIMA,SCALE_SPAN };
 #include "qltool.h"
 #include "utils.h"
 #include "random.h"
+#include "pctile.h"
 
 /* EXTERNs -------------------------------------------------------- */
 
@@ -101,9 +102,10 @@ static u_short circle             (int,double,double,int);
 static u_short linear             (int,double,double,int);
 static void    create_image       (QlTool*,int,int,void*);
 
-//     double  get_background     (u_short*,int,int,int,int,int,double*);
+//     double  get_background     (u_short*,int,int,int,int,int,double*,
+//                                         Arena*);
 static double  get_centroid       (u_short*,int,int,int,int,int,double,
-                                           double*,double*);
+                                           double*,double*,Arena*);
 static void    update_cursor(QlTool*,int);
 
 /* --- M A I N ---------------------------------------------------- */
@@ -148,6 +150,7 @@ QlTool* qltool_create(MainWindow* mw,Window parent,const char* fontname,
 
   qlt->data_min = qlt->data_max = 0; qlt->data_dyn = 1;
   qlt->sdata = (u_short*)calloc(sizeof(u_short),dim*dim);
+  qlt->hist = (u_int*)malloc(PCT_NBIN*sizeof(u_int));  /* not on stack */
   pthread_mutex_init(&qlt->lock,NULL);
 
   qlt->dimx = qlt->maxx = dim;         /* image geometry */
@@ -719,8 +722,9 @@ static void convolve(u_short* p1,u_short *p2,int w,int h) /* v0059 */
 
 /* --- */
 
-void qltool_update(QlTool* qlt,u_short* p) 
+void qltool_update(QlTool* qlt,u_short* p,Arena* scratch) 
 {
+  size_t mark,nb;
 #if (DEBUG > 1)
   fprintf(stderr,"%s(%p,%p): sm=%d\n",PREFUN,qlt->sdata,p,qlt->smoothing);
 #endif
@@ -731,6 +735,8 @@ void qltool_update(QlTool* qlt,u_short* p)
   double t1 = walltime(0);
 #endif
 
+  mark = arena_mark(scratch);
+  nb = qlt->dimy*qlt->dimx*sizeof(u_short);
   switch (qlt->smoothing) {            /* v0059 */
   case 0: 
     memcpy(qlt->sdata,p,qlt->dimy*qlt->dimx*sizeof(u_short));
@@ -740,16 +746,17 @@ void qltool_update(QlTool* qlt,u_short* p)
     break;
   case 2:
     { u_short *data;
-      data = (u_short*)malloc(qlt->dimy*qlt->dimx*sizeof(u_short));
+      data = (u_short*)arena_alloc(scratch,nb);
+      if (!data) break;
       convolve(p,   data,      qlt->dimx,qlt->dimy);
       convolve(data,qlt->sdata,qlt->dimx,qlt->dimy);
-      free((void*)data);
     }
     break;
   case 3: default:
     { u_short *data1,*data2; int i;
-      data1 = (u_short*)malloc(qlt->dimy*qlt->dimx*sizeof(u_short));
-      data2 = (u_short*)malloc(qlt->dimy*qlt->dimx*sizeof(u_short));
+      data1 = (u_short*)arena_alloc(scratch,nb);
+      data2 = (u_short*)arena_alloc(scratch,nb);
+      if (!data1 || !data2) break;
       convolve(p,    data1,     qlt->dimx,qlt->dimy);
       for (i=0; i<qlt->smoothing-2; i++) {
         convolve(data1,data2,     qlt->dimx,qlt->dimy);
@@ -758,11 +765,10 @@ void qltool_update(QlTool* qlt,u_short* p)
       } 
       if (qlt->smoothing % 2) convolve(data2,qlt->sdata,qlt->dimx,qlt->dimy);
       else                    convolve(data1,qlt->sdata,qlt->dimx,qlt->dimy);
-      free((void*)data2);
-      free((void*)data1);
     }
     break;
   }
+  arena_release(scratch,mark);
 #if (TIME_TEST > 1)
   double t2 = walltime(0);
   printf("%s: time=%.2f [ms]\n",PREFUN,1000.0*(t2-t1));
@@ -784,7 +790,9 @@ void qltool_redraw(QlTool* qlt,Bool rescale)
   if (rescale) {
     switch (qlt->scale) {              /* scaling mode */
     case SCALE_MED:                    /* median -/+ sigma */
+      pthread_mutex_lock(&qlt->lock);  /* 'sdata' and 'hist' */
       scale_med(qlt,qlt->scale_par1,qlt->scale_par2);  
+      pthread_mutex_unlock(&qlt->lock);
       sprintf(qlt->valbox.text,"val  %5d",qlt->data_min);
       CBX_UpdateEditWindow(&qlt->valbox);
       sprintf(qlt->spnbox.text,"span %5d",qlt->data_max-qlt->data_min);
@@ -796,7 +804,9 @@ void qltool_redraw(QlTool* qlt,Bool rescale)
       break;
     case SCALE_SPAN:                   /* legacy scaling */
       if (qlt->pct != 0) {
+        pthread_mutex_lock(&qlt->lock);
         scale_hist(qlt,qlt->pct,qlt->bkg,qlt->span);
+        pthread_mutex_unlock(&qlt->lock);
         sprintf(qlt->valbox.text,"val  %5d",qlt->val);
       } else {
         qlt->data_min = qlt->zero;
@@ -838,8 +848,8 @@ void qltool_redraw(QlTool* qlt,Bool rescale)
 
 /* function prototype(s) */
 
-static void    s_sort     (u_short*,int,int);
-static double  gfit       (double*,double*,int,double*,double*,double,double);
+static double  gfit       (double*,double*,int,double*,double*,double,double,
+                           Arena*);
 static double  lfit       (double*,double*,double*,int,double*,double*);
 #if (GFIT_TEST > 0)
 static double  fn_gauss   (double,double,double);
@@ -1060,11 +1070,12 @@ static void do_lupe24(QlTool* qlt)
 
 static void scale_med(QlTool* qlt,float f1,float f2)
 {
-  auto     int     n=0,m,i,lim1,lim2;
-  auto     int     nsamp,tpix,dmin,dmax;
-  auto     u_short *copy0;
-  auto     double  sum1=0.0,sum2=0.0,sigma=0.0;
-  register u_short *copy,v;
+  auto     int     n=0,i,lim1,lim2;
+  auto     int     nsamp,tpix,dmin,dmax,k[3];
+  auto     u_short val[3];
+  register u_int   *hist=qlt->hist;    /* counting histogram */
+  auto     double  sum1=0.0,sum2=0.0,sigma=0.0,m=0.0;
+  register u_short v;
 #if (DEBUG > 1)
   fprintf(stderr,"%s(%p,%.1f,%.1f)\n",PREFUN,qlt,f1,f2);
 #endif
@@ -1075,7 +1086,7 @@ static void scale_med(QlTool* qlt,float f1,float f2)
   tpix = qlt->dimx*qlt->dimy;      /* number of pixels */
   if (tpix <= 0) { qlt->data_min = qlt->data_max = 0; return; }
   nsamp = imin(128*(int)pow((double)tpix,0.30),tpix); /* sample size */
-  copy = copy0 = (u_short*)malloc(nsamp*sizeof(u_short)); /* sort buffer */
+  memset(hist,0,PCT_NBIN*sizeof(u_int));
 #if (DEBUG > 1)
   fprintf(stderr,"%s(): tpix=%d, nsamp=%d\n",PREFUN,tpix,nsamp);
 #endif
@@ -1085,52 +1096,50 @@ static void scale_med(QlTool* qlt,float f1,float f2)
     if (--timeout < 0) break;
     v = qlt->sdata[(int)DRandom(tpix)]; 
     if ((v == 0) || (v > qlt->satlev)) continue;
-    *copy = v; copy++; n++; 
+    hist[v] += 1; n++; 
   }
   if (n < 2) { qlt->data_min = qlt->data_max = 0; return; }
 
-  s_sort(copy0,0,n-1);                 /* sort pixels */
+  k[0] = 0; k[1] = n/2; k[2] = n-1;    /* min, median, max */
+  (void)pct_hist(hist,n,k,3,val);
 #if (DEBUG > 1)
-  fprintf(stderr,"%s(%d): median=%u\n",PREFUN,n,copy0[n/2]);
+  fprintf(stderr,"%s(%d): median=%u\n",PREFUN,n,val[1]);
 #endif
 
-  if (copy0[0] == copy0[n-1]) {        /* all pixels equal */
-    qlt->data_min = qlt->data_max = (int)copy0[0];
-    free((void*)copy0);
+  if (val[0] == val[2]) {              /* all pixels equal */
+    qlt->data_min = qlt->data_max = (int)val[0];
     return;
   }
 
   if (f1 < 1.0) {                      /* use fraction of pixels  */
-    dmin = (int)copy0[(int)((1.0-f1)*n/2.0)]-1;
-    dmax = (int)copy0[(int)((f1+(1.0-f1)/2.0)*n)]+1;
+    k[0] = pct_rank(n,(1.0-f1)/2.0);
+    k[1] = pct_rank(n,f1+(1.0-f1)/2.0);
+    (void)pct_hist(hist,n,k,2,val);
+    dmin = (int)val[0]-1;
+    dmax = (int)val[1]+1;
   } else {
-    lim1 = copy0[n/2]/2; lim2 = imin(qlt->satlev,2*copy0[n/2]);
+    lim1 = val[1]/2; lim2 = imin(qlt->satlev,2*val[1]);
 #if (DEBUG > 2)
     fprintf(stderr,"%s(): lim1=%d, lim2=%d\n",PREFUN,lim1,lim2);
 #endif
-    for (i=0,m=0,copy=copy0; i<n; i++,copy++) { /* calc. std-dev. */
-      if ((int)*copy > lim1) {
-        if ((int)*copy < lim2) {
-          sum1 += (double)*copy;
-          sum2 += (double)*copy * (double)*copy;
-          m++;
-        }
-      }
+    for (i=lim1+1; i<lim2; i++) {      /* calc. std-dev. */
+      if (!hist[i]) continue;
+      sum1 += (double)hist[i] * i;
+      sum2 += (double)hist[i] * i * i;
+      m    += (double)hist[i];
     }
-    if (m) sigma = sqrt(sum2/m - (sum1/m)*(sum1/m));
-    else   sigma = 1.0;
+    if (m > 0) sigma = sqrt(sum2/m - (sum1/m)*(sum1/m));
+    else       sigma = 1.0;
 #if (DEBUG > 2)
     fprintf(stderr,"%s(): sigma=%.1f\n",PREFUN,sigma);
 #endif
-    dmin = (int)copy0[n/2] - (int)(f1*sigma+1.0);
-    dmax = (int)copy0[n/2] + (int)(f2*sigma+1.0); 
+    dmin = (int)val[1] - (int)(f1*sigma+1.0);
+    dmax = (int)val[1] + (int)(f2*sigma+1.0); 
     dmin = imax(0,imin(MAX_USHORT,dmin));
     dmax = imax(0,imin(MAX_USHORT,dmax));
   }
   qlt->data_min = dmin;
   qlt->data_max = dmax;
- 
-  free((void*)copy0);
 
 #if (TIME_TEST > 1)
   double t2 = walltime(0);
@@ -1143,7 +1152,8 @@ static void scale_med(QlTool* qlt,float f1,float f2)
 static void scale_hist(QlTool* qlt,int pct,int bkg,int spn)
 {
   auto     int     i,m,nsamp,tpix;
-  auto     int     hist[MAX_USHORT+1],n=0;
+  auto     int     n=0;
+  register u_int   *hist=qlt->hist;    /* MAX_USHORT+1 bins */
   register u_short v;
 #if (DEBUG > 1)
   fprintf(stderr,"%s(%p,%d,%d,%d)\n",PREFUN,qlt,pct,bkg,spn);
@@ -1155,7 +1165,7 @@ static void scale_hist(QlTool* qlt,int pct,int bkg,int spn)
   tpix = qlt->dimx * qlt->dimy;
   if (tpix <= 0) { qlt->data_min = qlt->data_max = 0; return; }
 
-  for (i=0; i<=MAX_USHORT; i++) hist[i] = 0;  /* clear histogram */
+  memset(hist,0,(MAX_USHORT+1)*sizeof(u_int));  /* clear histogram */
 
   m = (qlt->satlev < MAX_USHORT) ? qlt->satlev : MAX_USHORT;
   nsamp = (int)pow((double)tpix,0.60);
@@ -1173,7 +1183,7 @@ static void scale_hist(QlTool* qlt,int pct,int bkg,int spn)
   int np = (n*pct)/100;
   for (i=0; i<MAX_USHORT; i++) {
     if (!hist[i]) continue;
-    np -= hist[i]; if (np <= 0) break;
+    np -= (int)hist[i]; if (np <= 0) break;
   }
   qlt->val = i;
   qlt->data_min = i - (spn*bkg)/64;
@@ -1377,32 +1387,6 @@ static void CreateImage(QlTool* qlt,int min,int dyn,u_int* p)
 
 /* ---------------------------------------------------------------- */
 
-static void s_sort(u_short *zahl, int l, int r)
-{
-  int     i,j;
-  u_short x,h;
- 
-  i = l;
-  j = r;
- 
-  if (j>i) {
-    x = zahl[(i+j)/2];
-    do {
-      while (zahl[i] < x) i++;
-      while (zahl[j] > x) j--;
-      if (i<=j) {
-        h         = zahl[i];
-        zahl[i++] = zahl[j];
-        zahl[j--] = h;
-      }
-    } while (!(i>j));
-    s_sort(zahl,l,j);
-    s_sort(zahl,i,r);
-  }
-}
-
-/* ---------------------------------------------------------------- */
-
 static u_short linear(int value,double x1,double x2,int ncolors)
 {
   double  x;
@@ -1435,7 +1419,7 @@ static u_short circle(int value,double m,double radius,int virtcols)
 
 /* ---------------------------------------------------------------- */
 
-void qltool_centroid(QlTool *qlt,double *cx,double* cy)
+void qltool_centroid(QlTool *qlt,double *cx,double* cy,Arena* scratch)
 {
   double nbck,back;
 
@@ -1444,20 +1428,32 @@ void qltool_centroid(QlTool *qlt,double *cx,double* cy)
   int lupex = my_round(qlt->curx[QLT_BOX],0);
   int lupey = my_round(qlt->cury[QLT_BOX],0);
   back = get_background(qlt->sdata,qlt->dimx,qlt->dimy,lupex,lupey,
-                        qlt->vrad,&nbck);
+                        qlt->vrad,&nbck,scratch);
   get_centroid(qlt->sdata,qlt->dimx,qlt->dimy,lupex,lupey,
-               qlt->vrad,back,cx,cy);
+               qlt->vrad,back,cx,cy,scratch);
 
   pthread_mutex_unlock(&qlt->lock);
 }
 
+/* ---------------------------------------------------------------- */
+/* scratch bytes of get_fwhm(), get_quads() for a box of radius 'r' */
+
+size_t qltool_scratch(int r)
+{
+  size_t n = (size_t)(2*r+1)*(2*r+1);
+
+  return 5*n*sizeof(double) + 5*ARENA_ALIGN; /* flux,dist + gfit() */
+}
+
 /* ---------------------------------------------------------------- */
 
 double get_fwhm(u_short *data,int dimx,int dimy,int x0,int y0,int r,
                 double enoise,double egain,
-                double* back,double* cx,double *cy,double *peak,double* flx)
+                double* back,double* cx,double *cy,double *peak,double* flx,
+                Arena* scratch)
 {
   int     x,y,r2,n=0;
+  size_t  mark = arena_mark(scratch);
   double  *flux,*dist,nbck,fwhm,a,b,d;
 #if (DEBUG > 1)
   fprintf(stderr,"%s()\n",PREFUN);
@@ -1467,14 +1463,18 @@ double get_fwhm(u_short *data,int dimx,int dimy,int x0,int y0,int r,
 #endif
  
   r2   = r*r;
-  *back = get_background(data,dimx,dimy,x0,y0,r,&nbck);
-  (void)get_centroid(data,dimx,dimy,x0,y0,r,*back,cx,cy);
+  *back = get_background(data,dimx,dimy,x0,y0,r,&nbck,scratch);
+  (void)get_centroid(data,dimx,dimy,x0,y0,r,*back,cx,cy,scratch);
 #if (DEBUG > 1)
   fprintf(stderr,"%s(): noise=%.1f\n",PREFUN,nbck);
 #endif
 
-  flux = (double*)malloc(4*r2*sizeof(double));
-  dist = (double*)malloc(4*r2*sizeof(double));
+  flux = (double*)arena_alloc(scratch,(2*r+1)*(2*r+1)*sizeof(double));
+  dist = (double*)arena_alloc(scratch,(2*r+1)*(2*r+1)*sizeof(double));
+  if (!flux || !dist) {                /* out of memory */
+    arena_release(scratch,mark);
+    *flx = *peak = 0.0; return 0.0;
+  }
 
   for (x=x0-r; x<=x0+r; x++) {         /* get flux */
     for (y=y0-r; y<=y0+r; y++) {       /* circular aperture */
@@ -1490,7 +1490,7 @@ double get_fwhm(u_short *data,int dimx,int dimy,int x0,int y0,int r,
   }
 
   if (n > 2) { 
-    (void)gfit(dist,flux,n,&a,&b,egain,enoise);
+    (void)gfit(dist,flux,n,&a,&b,egain,enoise,scratch);
     fwhm = 2.35482*b;               /* 2*sqrt(-2*ln(0.5)) */
     *flx = peak2flux(a,fwhm);       /* WARNING: valid only if */
     *peak = a;
@@ -1498,7 +1498,7 @@ double get_fwhm(u_short *data,int dimx,int dimy,int x0,int y0,int r,
     fwhm = *flx = *peak = 0;
   }
 
-  free((void*)flux); free((void*)dist);
+  arena_release(scratch,mark);
 
 #if (TIME_TEST > 1)
   double t2 = walltime(0);
@@ -1511,14 +1511,14 @@ double get_fwhm(u_short *data,int dimx,int dimy,int x0,int y0,int r,
 /* --- */
 
 double get_quads(u_short* data,int dimx,int dimy,int x0,int y0,int r,
-              double *rx,double* ry,double *flux)
+              double *rx,double* ry,double *flux,Arena* scratch)
 {
   int    x,y;
   double xp=0,yp=0,xm=0,ym=0,v;
 
   if ((x0-r<0) || (x0+r>=dimx) || (y0-r<0) || (y0+r>=dimy)) return -1;
 
-  double b = get_background(data,dimx,dimy,x0,y0,r,NULL);
+  double b = get_background(data,dimx,dimy,x0,y0,r,NULL,scratch);
   *flux = 0.0;
   for (x=x0-r; x<=x0+r; x++) { 
     if (x == x0) continue;
@@ -1565,14 +1565,16 @@ double calc_quad(int vrad,int sw,double sig,double dx,double *sf) /* v0409 */
 /* ---------------------------------------------------------------- */
 
 double get_background(u_short* data,int dimx,int dimy,int x0,int y0,
-                             int r,double* noise)
+                             int r,double* noise,Arena* scratch)
 {
   int     r2,n=0,x,y;
-  u_short *sortval,d;
+  size_t  mark = arena_mark(scratch);
+  u_short *bkgval,d;
   double  s1=0.0,s2=0.0,back=0.0;
 
   r2 = r*r;
-  sortval = (u_short*)malloc(4*r2*sizeof(u_short));
+  bkgval = (u_short*)arena_alloc(scratch,(2*r+1)*(2*r+1)*sizeof(u_short));
+  if (!bkgval) return back;
 
   for (x=x0-r; x<=x0+r; x++) {         /* find background */
     for (y=y0-r; y<=y0+r; y++) {       /* circular aperture */
@@ -1580,21 +1582,23 @@ double get_background(u_short* data,int dimx,int dimy,int x0,int y0,
       if ((x-x0)*(x-x0)+(y-y0)*(y-y0) < r2) continue; /* use outside */
       d = data[x+y*dimx];
       if (d > 0) {
-        sortval[n] = d; n++;
+        bkgval[n] = d; n++;
         if (noise) { s1 += (double)d; s2 += (double)d * (double)d; }
       }
     }
   }
   if (n > 0) {                         /* at least 1 pixel */
-    s_sort(sortval,0,n-1);
-    back = (double)sortval[n/2];
+    int     k = n/2;
+    u_short med;
+    (void)pct_select(bkgval,n,&k,1,&med);
+    back = (double)med;
     if (noise) *noise = sqrt(s2/n - (s1/n)*(s1/n));
   }
 #if (DEBUG > 1)
   fprintf(stderr,"%s(): x0=%d, y0=%d, back=%.0f (n=%d)\n",PREFUN,
           x0+1,y0+1,back,n);
 #endif
-  free((void*)sortval);
+  arena_release(scratch,mark);
 
   return back;
 }
@@ -1602,12 +1606,12 @@ double get_background(u_short* data,int dimx,int dimy,int x0,int y0,
 /* ---------------------------------------------------------------- */
 
 static double get_centroid(u_short* data,int dimx,int dimy,int x0,int y0,
-                    int r,double back,double* cx,double* cy)
+                    int r,double back,double* cx,double* cy,Arena* scratch)
 {
   int    r2,x,y;
   double m=0.0,h;
 
-  if (back < 0.0) back = get_background(data,dimx,dimy,x0,y0,r,NULL);
+  if (back < 0.0) back = get_background(data,dimx,dimy,x0,y0,r,NULL,scratch);
 
   r2 = r*r;
   *cx = *cy = 0.0;
@@ -1648,14 +1652,19 @@ static double fn_gauss(double x,double a,double b)
 /* ---------------------------------------------------------------- */
 
 static double gfit(double* x,double* y,int n,double* a,double* b,
-                   double egain,double enoise)
+                   double egain,double enoise,Arena* scratch)
 {
   int    i;
+  size_t mark = arena_mark(scratch);
   double *xval,*yval,*eval,chi2;
 
-  xval = (double*)malloc(n*sizeof(double));
-  yval = (double*)malloc(n*sizeof(double));
-  eval = (double*)malloc(n*sizeof(double));
+  xval = (double*)arena_alloc(scratch,n*sizeof(double));
+  yval = (double*)arena_alloc(scratch,n*sizeof(double));
+  eval = (double*)arena_alloc(scratch,n*sizeof(double));
+  if (!xval || !yval || !eval) {       /* out of memory */
+    arena_release(scratch,mark);
+    *a = *b = 0.0; return -1.0;
+  }
 
   for (i=0; i<n; i++) {                /* 'linearize' data */
     xval[i] = x[i]*x[i];
@@ -1678,7 +1687,7 @@ static double gfit(double* x,double* y,int n,double* a,double* b,
   fprintf(stderr,"%s(): a=%f, b=%f\n",PREFUN,*a,*b);
 #endif
   
-  free((void*)xval); free((void*)yval); free((void*)eval);
+  arena_release(scratch,mark);
 
   return(chi2);
 }
@@ -18,6 +18,8 @@ enum guider_modes { GM_PR=1,GM_SH,GM_SV3,GM_SV4,GM_SV5 };
 
 #include <cxt.h>
 
+#include "arena.h"
+
 /* ---------------------------------------------------------------- */
 
 typedef struct qltool_tag {
@@ -45,6 +47,7 @@ typedef struct qltool_tag {
   size_t       imgsize,lupsize;
   pthread_mutex_t lock;
   u_short*     sdata;
+  u_int*       hist;                   /* scale_med/hist(), 'lock' */
   u_short      satlev;
   void*        picture0;               /* pointer to image data */
   void*        lupe0;
@@ -65,7 +68,7 @@ typedef struct qltool_tag {
 QlTool* qltool_create   (MainWindow*,Window,const char*,int,int,int,
                          int,int,int,int,int,int,int,int);
 void    qltool_reset    (QlTool*,int,int,int);
-void    qltool_update   (QlTool*,u_short*);
+void    qltool_update   (QlTool*,u_short*,Arena*);
 void    qltool_redraw   (QlTool*,Bool);
 void    qltool_cursor_set(QlTool*,int,int,int,double);
 void    qltool_cursor_off(QlTool*,int,int,int,double,double*,double*);
@@ -73,16 +76,18 @@ void    qltool_cursor_off(QlTool*,int,int,int,double,double*,double*);
 int     qltool_event     (QlTool*,XEvent*);
 int     qltool_handle_key(QlTool*,XKeyEvent*,int);
 
-void    qltool_centroid(QlTool*,double*,double*);
+void    qltool_centroid(QlTool*,double*,double*,Arena*);
 
 void    qltool_lut(QlTool*,const char*);
 void    qltool_scale(QlTool*,const char*,const char*,const char*);
 void    qltool_lmag(QlTool*,int);
 
-double get_background(u_short*,int,int,int,int,int,double*);
+size_t qltool_scratch(int);
+double get_background(u_short*,int,int,int,int,int,double*,Arena*);
 double get_fwhm(u_short*,int,int,int,int,int,double,double,
-                double*,double*,double*,double*,double*);
-double get_quads(u_short*,int,int,int,int,int,double*,double*,double*);
+                double*,double*,double*,double*,double*,Arena*);
+double get_quads(u_short*,int,int,int,int,int,double*,double*,double*,
+                 Arena*);
 double calc_quad(int,int,double,double,double*);
 
 /* ---------------------------------------------------------------- */
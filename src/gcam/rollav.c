@@ -0,0 +1,126 @@
+/* ---------------------------------------------------------------- *
+ *
+ * rollav.c
+ *
+ * rolling average of guider frames ('av'), in place, integer only:
+ * EMA with a Q8 state and a Q16 weight, running mean from a sum and
+ * a ring of the last 'n' frames, divided by a reciprocal multiply.
+ * 32x32->64 bit unsigned products (SSE2 pmuludq, NEON vmull): the
+ * loops are built with -O3 (see makefile) and are memory bound.
+ *
+ * ---------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rollav.h"
+
+/* ---------------------------------------------------------------- */
+/* 'n' frames (1: no averaging) of 'npix' pixels; the running mean   */
+/* keeps at most ROLLAV_MBMAX of history, i.e. 'n' may be reduced     */
+
+int rollav_init(RollAvg* s,int mode,int n,int npix)
+{
+  memset(s,0,sizeof(RollAvg));
+  if (n < 1) n = 1;
+  if (mode == ROLLAV_MEAN) {
+    long nmax = (long)ROLLAV_MBMAX*1024*1024/((long)npix*sizeof(u_short));
+    if (n > nmax) n = (int)((nmax > 1) ? nmax : 1);
+  }
+  s->mode = mode;
+  s->n = n;
+  s->npix = npix;
+  s->k = (65536+n/2)/n;
+  s->recip = (u_int)((0x100000000ULL+n-1)/n);
+  s->acc = (u_int*)malloc(npix*sizeof(u_int));
+  if (mode == ROLLAV_MEAN) {
+    s->ring = (u_short*)malloc((size_t)n*npix*sizeof(u_short));
+  }
+  if (!s->acc || ((mode == ROLLAV_MEAN) && !s->ring)) {
+    rollav_free(s);
+    return -1;
+  }
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+static void ema_add(u_int* restrict acc,u_short* restrict d,int npix,
+                    u_int k)
+{
+  int   i;
+  u_int k1=65536-k;
+
+  for (i=0; i<npix; i++) {             /* data in the high 14-bits */
+    unsigned long long a = (unsigned long long)acc[i]*k1 +
+                           (unsigned long long)((u_int)(d[i] >> 2) << 8)*k;
+    acc[i] = (u_int)((a+32768) >> 16);
+    d[i] = (u_short)((acc[i]+128) >> 8);
+  }
+}
+
+/* --- */
+
+static void first_add(u_int* restrict acc,u_short* restrict d,int npix,
+                      int q)
+{
+  int i;
+
+  for (i=0; i<npix; i++) {             /* EMA: q=8, MEAN: q=0 */
+    d[i] >>= 2;
+    acc[i] = (u_int)d[i] << q;
+  }
+}
+
+/* --- */
+
+static void mean_add(u_int* restrict acc,u_short* restrict old,
+                     u_short* restrict d,int npix,u_int c,u_int recip,
+                     int full)
+{
+  int i;
+
+  for (i=0; i<npix; i++) {             /* data in the high 14-bits */
+    u_short v = d[i] >> 2;
+    u_int   a = acc[i] + v - ((full) ? old[i] : 0);
+    acc[i] = a;
+    old[i] = v;                        /* slot of the oldest frame */
+    d[i] = (u_short)(((unsigned long long)(a+c/2)*recip) >> 32); /* a/c */
+  }
+}
+
+/* ---------------------------------------------------------------- */
+/* shift the raw frame 'd' (high 14-bits) and replace it by the      */
+/* average of the frames added so far (at most 'n')                  */
+
+void rollav_add(RollAvg* s,u_short* d)
+{
+  if ((s->count == 0) || (s->n == 1)) {  /* first frame */
+    first_add(s->acc,d,s->npix,(s->mode == ROLLAV_MEAN) ? 0 : 8);
+    if (s->mode == ROLLAV_MEAN) memcpy(s->ring,d,s->npix*sizeof(u_short));
+  } else
+  if (s->mode == ROLLAV_MEAN) {
+    u_short *old = s->ring + (size_t)(s->count % s->n)*s->npix;
+    if (s->count < s->n) {             /* not full yet: mean of count+1 */
+      u_int c = s->count+1;
+      mean_add(s->acc,old,d,s->npix,c,(u_int)((0x100000000ULL+c-1)/c),0);
+    } else {
+      mean_add(s->acc,old,d,s->npix,s->n,s->recip,1);
+    }
+  } else {
+    ema_add(s->acc,d,s->npix,s->k);
+  }
+  s->count++;
+}
+
+/* ---------------------------------------------------------------- */
+
+void rollav_free(RollAvg* s)
+{
+  if (s->acc)  free((void*)s->acc);
+  if (s->ring) free((void*)s->ring);
+  s->acc  = NULL;
+  s->ring = NULL;
+}
+
+/* ---------------------------------------------------------------- */
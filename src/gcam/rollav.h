@@ -0,0 +1,38 @@
+/* ----------------------------------------------------------------
+ *
+ * rollav.h
+ *
+ * rolling average of guider frames ('av'): exponential moving
+ * average or running mean, integer arithmetic
+ *
+ * ---------------------------------------------------------------- */
+
+#ifndef INCLUDE_ROLLAV_H
+#define INCLUDE_ROLLAV_H
+
+#include <sys/types.h>
+
+/* ---------------------------------------------------------------- */
+
+#define ROLLAV_MBMAX     256            /* running mean: max. history */
+
+enum rollav_modes_enum { ROLLAV_EMA, ROLLAV_MEAN };
+
+typedef struct {
+  int     mode,n,npix;                 /* n: frames averaged */
+  u_int   count;                       /* frames added */
+  u_int   k;                           /* EMA: 65536/n */
+  u_int   recip;                       /* MEAN: 2^32/n, rounded up */
+  u_int   *acc;                        /* EMA: Q8 state, MEAN: sum */
+  u_short *ring;                       /* MEAN: last n frames */
+} RollAvg;
+
+/* ---------------------------------------------------------------- */
+
+int  rollav_init  (RollAvg*,int,int,int);
+void rollav_add   (RollAvg*,u_short*);
+void rollav_free  (RollAvg*);
+
+/* ---------------------------------------------------------------- */
+
+#endif /* INCLUDE_ROLLAV_H */
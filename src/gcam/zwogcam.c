@@ -106,6 +106,7 @@
 
 #include "zwogcam.h"
 #include "zwotcp.h"
+#include "rollav.h"
 #include "tcpip.h"                     /* TCPIP stuff */
 #include "utils.h"                     /* generic utilities */
 #include "ptlib.h"                     /* POSIX threads lib */
@@ -1309,7 +1310,18 @@ static int handle_command(Guider* g,const char* command,int showMsg)
 #endif
   } else
   if (!strncasecmp(cmd,"av",2)) {      /* AVF,AVG */
-    if (n >= 2) set_av(g,atoi(par1));
+    int mode=g->server->rollMode;
+    if (n >= 3) {                      /* 'av N ema|mean' */
+      if      (!strcasecmp(par2,"ema"))  mode = ROLLAV_EMA;
+      else if (!strcasecmp(par2,"mean")) mode = ROLLAV_MEAN;
+      else err = E_MISSPAR;            /* nothing changes */
+    }
+    if (!err) {
+      g->server->rollMode = mode;
+      if (n >= 2) set_av(g,atoi(par1));
+      sprintf(msgstr,"%d %s",g->server->rolling,
+              (g->server->rollMode == ROLLAV_MEAN) ? "mean" : "ema");
+    }
   } else 
   if (!strcasecmp(cmd,"bf") || !strcasecmp(cmd,"bg")) {
     err = E_NOTIMP;
@@ -1582,6 +1594,12 @@ static int handle_command(Guider* g,const char* command,int showMsg)
   if (!strncasecmp(cmd,"scale",3)) {   /* scaling mode */
     qltool_scale(g->qltool,par1,par2,par3);
   } else
+  if (!strcasecmp(cmd,"bus")) {        /* frame bus: got, skipped */
+    if (!zwo_consumer_stats(g->server,msgstr,sizeof(g->command_msg))) {
+      strcpy(msgstr,"-");
+    }
+    message(g,msgstr,MSS_WINDOW);
+  } else
   if (!strncasecmp(cmd,"dt",2)) {      /* display throttle */
     if (*par1) throttle = fmax(0,atof(par1));
     else               sprintf(msgstr,"%.0f",throttle); 
@@ -2021,7 +2039,6 @@ static void* run_cycle(void* param)
   int    err=0,dt=0,q_flag=0;
   double tFrame,tSend,tNow,tTemp,nodata=2+MAX_EXPTIME,cnt=1;
   char buf[128];
-  u_int seqNumber=0;
   pthread_t disp_tid=0;                 
   Guider *g = (Guider*)param;
 #if (DEBUG > 0)
@@ -2043,6 +2060,7 @@ static void* run_cycle(void* param)
   }
 
   if (!err) { ZwoFrame *frame=NULL;
+    int bus = zwo_consumer_add(server,"send",ZWO_LATEST,0);
     while (!g->stop_flag) {
       msleep(350);                     /* see 0.175s correction below */
       tNow = walltime(0);              /* now */
@@ -2060,9 +2078,8 @@ static void* run_cycle(void* param)
       } else {
         tSend = tNow;
       }
-      frame = zwo_frame4reading(server,seqNumber);
+      frame = zwo_consumer_get(server,bus,0);
       if (frame) {                     /* a new frame has arrived */
-        seqNumber = frame->seqNumber;  /* most recent frame */
         if ((g->send_flag) && (cnt <= 0.0)) { /* send frame */
           update_status(&g->status,g,frame);
           if (g->send_port > 0) {
@@ -2143,6 +2160,7 @@ static void* run_cycle(void* param)
         }
       } /* endif(update) */
     } /* endwhile(!stop_flag) */
+    zwo_consumer_remove(server,bus);
     zwo_cycle_stop(server);
   } /* endif(!err) */
   g->loop_running = False;
@@ -2165,38 +2183,38 @@ static void* run_cycle(void* param)
 static void* run_display(void* param) 
 {
   Guider *g = (Guider*)param;
-  u_int seqNumber=0;
-  double fps=1,t1,t2,slpt=0.350,tmax;
+  double fps=1,t1,t2;
   QlTool *qltool = g->qltool;
   ZwoStruct *server = g->server;
+  Arena  scratch={0};                  /* smoothing buffers */
   assert(server);
   assert(g->init_flag == 1);
 
   int gx = g->status.dimx;
   int gy = g->status.dimy;
   qltool_reset(qltool,gx,gy,1);
+  (void)arena_init(&scratch,2*(gx*gy*sizeof(u_short)+ARENA_ALIGN));
+  int bus = zwo_consumer_add(server,"display",ZWO_LATEST,0);
 
   t1 = walltime(0);
-  while (g->loop_running) {
-    ZwoFrame *frame = zwo_frame4reading(server,seqNumber);
+  while (g->loop_running) {           /* woken by a new frame */
+    ZwoFrame *frame = zwo_consumer_get(server,bus,350);
     if (frame) {
-      seqNumber = frame->seqNumber; 
-      qltool_update(qltool,frame->data);
+      qltool_update(qltool,frame->data,&scratch);
       zwo_frame_release(server,frame);
       qltool_redraw(qltool,True);
       t2 = walltime(0); 
       fps = 0.7*fps + 0.3/(t2-t1);
       update_fps(&g->fdbox,fps);
+      if (throttle) {                  /* at most 'throttle' Hz */
+        double slpt = 1.0/throttle - (walltime(0)-t1);
+        if (slpt > 0.001) msleep((int)(1000.0*slpt));
+      }
       t1 = t2;
     } // endif(frame)
-    slpt = (throttle) ? 0.6*slpt + 0.4*slpt*(fps/throttle) : 0.02;
-    tmax = (throttle) ? 1.0/throttle : 0.35;
-    slpt = fmax(0.02,fmin(tmax,fmax(slpt,g->status.exptime/3.0)));
-#if (DEBUG > 3)
-    fprintf(stderr,"slpt=%.3f\n",slpt);
-#endif
-    msleep((int)(1000.0*slpt)); 
   } // endwhile(!stop)
+  zwo_consumer_remove(server,bus);
+  arena_free(&scratch);
   sprintf(g->fdbox.text,"%d",0); CBX_UpdateEditWindow(&g->fdbox);
   fprintf(stderr,"%s() done\n",PREFUN);
 
@@ -2219,9 +2237,16 @@ static void* run_write(void* param)
     weStartedTheLoop = do_start(g,2000);
   }
 
+  int bus = zwo_consumer_add(server,"write",ZWO_EVERY,ZWO_QSLOTS);
+  if (bus < 0) {                       /* no frames left to queue */
+    message(g,"write: no frame bus slot",MSS_WARN);
+    g->write_flag = 0;
+  }
+
   t1 = walltime(0);
-  while (g->loop_running) {
-    ZwoFrame *frame = zwo_frame4reading(server,st->seqNumber);
+  while (g->loop_running && (bus >= 0)) {            /* every frame, none skipped */
+    ZwoFrame *frame = zwo_consumer_get(server,bus,
+                                       (int)(1000.0*st->exptime)+2000);
     if (!frame) {
       sprintf(buf,"failed to get new frame (>%u)",st->seqNumber);
       message(g,buf,MSS_WINDOW);
@@ -2250,8 +2275,8 @@ static void* run_write(void* param)
       g->write_flag -= 1;
     } // endif(frame)
     if (g->write_flag <= 0) break;
-    msleep(50);
   } // endwhile(loop-doing)
+  zwo_consumer_remove(server,bus);
 
   if (weStartedTheLoop) do_stop(g,0);
   printf("%s() done\n",PREFUN);
@@ -2303,6 +2328,7 @@ static void load_mask(Guider *g)       /* v0322 */
       printf("loaded %s\n",file);
     }
   }
+  zwo_mask_changed(server);            /* rebuild the bad pixel list */
 }
 
 /* --- */
@@ -2323,6 +2349,7 @@ static void make_mask(Guider *g,const char* par)  /* v0319 */
 
   if (!strcmp(par,"off")) {            /* turn OFF mask */
     memset(server->mask,0,npix*sizeof(char));
+    zwo_mask_changed(server);
     return;
   } else 
   if (!strcmp(par,"on")) {             /* load mask v0322 */
@@ -2367,6 +2394,7 @@ static void make_mask(Guider *g,const char* par)  /* v0319 */
   zwo_frame_release(server,frame);
 
   memcpy(server->mask,mask,npix*sizeof(char));
+  zwo_mask_changed(server);
 
   FILE *fp = fopen(file,"w");
   if (!fp) {
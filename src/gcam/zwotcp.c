@@ -14,9 +14,13 @@
 #include <math.h>
 #include <assert.h>
 #include <unistd.h>
+#include <sys/socket.h>                /* recv() */
+#include <sys/time.h>
+#include <time.h>                      /* clock_gettime() */
 
 #include "zwogcam.h"
 #include "zwotcp.h"
+#include "rollav.h"
 #include "tcpip.h"
 #include "ptlib.h"
 #include "utils.h"
@@ -33,6 +37,12 @@
 
 #define SQR(x)         ((x)*(x))
 
+#ifdef MACOSX                          /* no pthread_condattr_setclock() */
+#define FRAME_CLOCK     CLOCK_REALTIME
+#else
+#define FRAME_CLOCK     CLOCK_MONOTONIC /* 'frameCond' deadlines */
+#endif
+
 int    sim_star=1,sim_slit=4;          /* v0406 slitWidth=7 */
 int    sim_cx,sim_cy;                  /* v0408 */
 int    sim_cx2,sim_cy2;                /* v0416 */
@@ -53,6 +63,8 @@ ZwoStruct* zwo_create(const char* host,int port)
   strcpy(self->host,host);
   self->port = port;
   self->handle = -1;                   /* connection closed */
+  self->ctrl = -1;
+  self->camera = 0;
   self->err = 0;                       /* used from threads */
   self->serverVersion[0] = '\0';
   self->modelName[0] = '\0';
@@ -65,16 +77,28 @@ ZwoStruct* zwo_create(const char* host,int port)
   self->gain = 0;
   self->fps = 0.0;
   self->rolling = 0;
+  self->rollMode = ROLLAV_EMA;
   self->mask = NULL;
+  self->maskVersion = 0;
 
   pthread_mutex_init(&self->ioLock,NULL);
   pthread_mutex_init(&self->frameLock,NULL);
+  pthread_mutex_init(&self->ctrlLock,NULL);
+  { pthread_condattr_t attr;           /* waits immune to clock steps */
+    pthread_condattr_init(&attr);
+#ifndef MACOSX
+    pthread_condattr_setclock(&attr,FRAME_CLOCK);
+#endif
+    pthread_cond_init(&self->frameCond,&attr);
+    pthread_condattr_destroy(&attr);
+  }
 
   self->seqNumber = 0;
-  for (i=0; i<ZWO_NBUFS; i++) {
+  for (i=0; i<ZWO_NFRAMES; i++) {
     ZwoFrame *frame = &self->frames[i];
     frame->data = NULL;
   }
+  for (i=0; i<ZWO_CMAX; i++) self->cons[i].name[0] = '\0';
   self->tid = 0;
   self->stop_flag = 1;
 
@@ -98,6 +122,70 @@ static int zwo_request(ZwoStruct* self,const char* cmd,char* res,int tout)
   return err;
 }
 
+/* ---------------------------------------------------------------- */
+/* open the 'control' connection to the camera of 'handle' (ctrlLock */
+/* held); only v1.0.22+ servers have it: older ones serve a single   */
+/* connection and would not answer until 'handle' hangs up           */
+
+static int has_control(const ZwoStruct* self)
+{
+  int  v1=0,v2=0,v3=0;
+
+  if (sscanf(self->serverVersion,"%d.%d.%d",&v1,&v2,&v3) != 3) return 0;
+  return (v1*10000+v2*100+v3 >= 10022);
+}
+
+static void ctrl_open(ZwoStruct* self)
+{
+  int  e=0,handle;
+  char cmd[32],buf[128];
+
+  if (!has_control(self)) return;
+
+  handle = TCPIP_CreateClientSocket(self->host,self->port,&e);
+  if (e) return;
+  e = TCPIP_Request3(handle,"control\n",buf,sizeof(buf),2);
+  if (!e && strncmp(buf,"OK",2)) e = E_ERROR;
+  if (!e) {
+    sprintf(cmd,"camera %d\n",self->camera);
+    e = TCPIP_Request3(handle,cmd,buf,sizeof(buf),2);
+    if (!e && (buf[0] == '-')) e = E_ERROR;
+  }
+  if (e) close(handle);
+  else   self->ctrl = handle;
+}
+
+/* ---------------------------------------------------------------- */
+/* housekeeping: on the 'control' connection it never waits behind  */
+/* a frame transfer on 'handle'; old servers: fall back to 'handle' */
+
+static int zwo_control(ZwoStruct* self,const char* cmd,char* res,int tout)
+{
+  int  err;
+  char command[128],answer[128];
+
+  pthread_mutex_lock(&self->ctrlLock);
+  if (self->ctrl >= 0) {
+    assert(strlen(cmd) < sizeof(command)+2);
+    sprintf(command,"%s\n",cmd);
+    err = TCPIP_Request3(self->ctrl,command,answer,sizeof(answer),tout);
+    if (!err) { if (res) strcpy(res,answer); }
+    if ((err == E_tcpip_timeout) || (err == E_tcpip_nodata)) {
+      close(self->ctrl);               /* a late answer would be read */
+      self->ctrl = -1;                 /* as the next one: start over */
+      ctrl_open(self);
+    }
+    pthread_mutex_unlock(&self->ctrlLock);
+  } else {
+    pthread_mutex_unlock(&self->ctrlLock);
+    pthread_mutex_lock(&self->ioLock);
+    err = zwo_request(self,cmd,res,tout);
+    pthread_mutex_unlock(&self->ioLock);
+  }
+
+  return err;
+}
+
 /* ---------------------------------------------------------------- */
 
 int zwo_connect(ZwoStruct* self)
@@ -126,7 +214,15 @@ int zwo_connect(ZwoStruct* self)
       message(self,buf,MSS_FILE);
     }
   }
+  if (!err && has_control(self)) { char buf[128];  /* camera # */
+    if (!zwo_request(self,"camera",buf,5)) sscanf(buf,"%d",&self->camera);
+  }
   pthread_mutex_unlock(&self->ioLock);
+  if (!err) {                          /* 'control' v1.0.22 */
+    pthread_mutex_lock(&self->ctrlLock);
+    ctrl_open(self);
+    pthread_mutex_unlock(&self->ctrlLock);
+  }
 
   return err;
 }
@@ -229,6 +325,10 @@ int zwo_disconnect(ZwoStruct* self)
   if (self->handle >= 0) err = close(self->handle);
   self->handle = -1;
   pthread_mutex_unlock(&self->ioLock);
+  pthread_mutex_lock(&self->ctrlLock);
+  if (self->ctrl >= 0) close(self->ctrl);
+  self->ctrl = -1;
+  pthread_mutex_unlock(&self->ctrlLock);
 
   return err;
 }
@@ -265,6 +365,8 @@ void zwo_free(ZwoStruct* self)
 
   pthread_mutex_destroy(&self->ioLock);
   pthread_mutex_destroy(&self->frameLock);
+  pthread_mutex_destroy(&self->ctrlLock);
+  pthread_cond_destroy(&self->frameCond);
 
   free((void*)self);
 }
@@ -298,9 +400,7 @@ int zwo_temperature(ZwoStruct *self,const char* value)
   } else {
     strcpy(cmd,"tempcon");
   }
-  pthread_mutex_lock(&self->ioLock); 
-  int err = zwo_request(self,cmd,buf,5);  /* -40..30 [0] */
-  pthread_mutex_unlock(&self->ioLock);
+  int err = zwo_control(self,cmd,buf,5);  /* -40..30 [0] */
   if (!err) { float t,p;
     if (sscanf(buf,"%f %f",&t,&p) == 2) {
       self->tempSensor = t;
@@ -323,9 +423,7 @@ int zwo_exptime(ZwoStruct* self,double exptime)
 
   exptime = fmin(MAX_EXPTIME,fmax(0.01,exptime));
   sprintf(cmd,"exptime %.3f",exptime);
-  pthread_mutex_lock(&self->ioLock);
-  int err = zwo_request(self,cmd,buf,5);
-  pthread_mutex_unlock(&self->ioLock);
+  int err = zwo_control(self,cmd,buf,5);
   if (!err) self->expTime = exptime;
 
   return err;
@@ -338,33 +436,114 @@ int zwo_gain(ZwoStruct* self,int gain,int offset)
   int  err=0;
   char cmd[128],buf[128];
 
-  pthread_mutex_lock(&self->ioLock);
-
   if (gain < 0)  strcpy(cmd,"gain");
   else          sprintf(cmd,"gain %d",gain); /* 0..570 [200] */
-  if (!err) err = zwo_request(self,cmd,buf,5);
+  if (!err) err = zwo_control(self,cmd,buf,5);
   if (!err) self->gain = atoi(buf);
 
   if (offset < 0)  strcpy(cmd,"offset"); /* 0..80 [8] */
   else            sprintf(cmd,"offset %d",offset);
-  if (!err) err = zwo_request(self,cmd,buf,5);
+  if (!err) err = zwo_control(self,cmd,buf,5);
   if (!err) self->offset = atoi(buf);
 
-  pthread_mutex_unlock(&self->ioLock);
-
   return err;
 }
 
 /* ---------------------------------------------------------------- */
 
+/* receive 'nbytes' of a frame straight into 'p', SO_RCVTIMEO bounds  */
+/* a stall; returns the number of bytes received                      */
+
+static int zwo_recv_frame(ZwoStruct* self,void* p,int nbytes)
+{
+  int n=0;
+
+  while (n < nbytes) {
+    ssize_t r = recv(self->handle,(char*)p+n,nbytes-n,MSG_WAITALL);
+    if (r <= 0) break;                 /* timeout, hangup */
+    n += r;
+  }
+  return n;
+}
+
+/* ---------------------------------------------------------------- */
+/* bad pixel with the offsets and weights of its unmasked neighbours, */
+/* precomputed from 'mask' for the current window                     */
+
+typedef struct {
+  int    p;                            /* index in the window */
+  short  n,wsum;                       /* neighbours, sum of weights */
+  int    q[8];                         /* offsets */
+  u_char m[8];                         /* weights: 2 edge, 1 corner */
+} BadPixel;
+
+/* list of the masked pixels (not on the border) of a w*h window */
+
+static BadPixel* bad_pixels(const char* mask,int w,int h,int *nbad)
+{
+  int x,y,dx,dy,p,n=0,nmax=0;
+  BadPixel *list=NULL;
+
+  for (y=1; y<h-1; y++) {              /* loop over rows */
+    p = 1 + y*w;
+    for (x=1; x<w-1; x++,p++) {        /* loop over columns */
+      if (!mask[p]) continue;
+      if (n == nmax) {
+        nmax = (nmax) ? 2*nmax : 256;
+        list = (BadPixel*)realloc(list,nmax*sizeof(BadPixel));
+      }
+      BadPixel *b = &list[n];
+      b->p = p; b->n = b->wsum = 0;
+      for (dy=-1; dy<=1; dy++) {       /* 8 pixels around */
+        for (dx=-1; dx<=1; dx++) {
+          if ((dx) || (dy)) {          /* not center */
+            int q = dx + dy*w;
+            if (!mask[p+q]) {          /* not masked */
+              b->q[b->n] = q;
+              b->m[b->n] = ((dx) && (dy)) ? 1 : 2; /* weight */
+              b->wsum += b->m[b->n++];
+            }
+          }
+        }
+      }
+      if (b->wsum) n++;                /* no good neighbour: keep */
+    }
+  }
+  *nbad = n;
+  return list;
+}
+
+/* replace the bad pixels by the weighted mean of their neighbours;  */
+/* neighbours are never bad, so the order does not matter (v0320)    */
+
+static void fix_pixels(const BadPixel* list,int nbad,u_short* udata)
+{
+  int i,j,s;
+
+  for (i=0; i<nbad; i++) {
+    const BadPixel *b = &list[i];
+    for (j=0,s=0; j<b->n; j++) s += b->m[j] * (int)udata[b->p+b->q[j]];
+    udata[b->p] = (u_short)((2*s+b->wsum)/(2*b->wsum)); /* rounded */
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
 static void* run_cycle(void* param)
 {
   ZwoStruct *self=(ZwoStruct*)param;
-  int     i,n=0,err=0,per,last_err=0;
+  int     n=0,err=0,per,last_err=0;
   u_int   seq=0;
   double  t1,t2,tmp=0;
   char    cmd[128],buf[256];
-  u_short *roll_buf=NULL;
+  RollAvg roll={0};                    /* rolling average */
+  int     roll_n=0,roll_mode=0;        /* 'roll' set up for */
+  u_char  *spill=NULL;                 /* no free slot: drain here */
+  BadPixel *bad=NULL;                  /* from 'mask' */
+  int     nbad=0;
+  u_int   mask_version=0;
+  char    *mask=NULL;
+  struct timeval tv={2,0};
 #if (DEBUG > 0)
   fprintf(stderr,"%s: %s(%p)\n",__FILE__,PREFUN,param);
 #endif
@@ -379,7 +558,9 @@ static void* run_cycle(void* param)
 
   int npix = self->aoiW * self->aoiH;
   int nbytes = npix * sizeof(u_short);
-  u_char *data = (u_char*)malloc(nbytes);
+
+  /* 'next' requests use select() */
+  (void)setsockopt(self->handle,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
 
   self->fps = 0;
   self->err = 0;
@@ -410,16 +591,23 @@ static void* run_cycle(void* param)
       if (n != 3) fprintf(stderr,"bad line '%s'\n",buf);
       self->tempSensor = (float)tmp;
       self->coolerPercent = (float)per;
-      for (i=0,n=0; i<nbytes/42; i++) { /* transfer image data */
-        ssize_t r = TCPIP_Recv(self->handle,(char*)data+n,nbytes-n,2);
-        if (r <= 0) break;
-        n += r; if (n >= nbytes) break;
+      /* receive straight into the slot: no copy of the frame */
+      ZwoFrame *frame = zwo_frame4writing(self,seq);
+      if (frame) {
+        n = zwo_recv_frame(self,frame->data,nbytes);
+      } else {
+        if (!spill) spill = (u_char*)malloc(nbytes);
+        n = zwo_recv_frame(self,spill,nbytes);
       }
       t2 = walltime(0);
       self->fps = 0.7*self->fps + 0.3/(t2-t1);
       t1 = t2;
       if (n != nbytes) {               /* data missing */
         err = E_INCFRAME;
+        if (frame) {                   /* not a valid frame any more */
+          frame->seqNumber = 0;
+          zwo_frame_release(self,frame);
+        }
       } else {
 #if (DEBUG > 1)
         if (seq > self->seqNumber+1) {
@@ -427,111 +615,44 @@ static void* run_cycle(void* param)
           message(self,buf,MSS_WINDOW);
         }
 #endif
-        /* NOTE: data is in the high 14-bits, shifted at rolling average */
-#if 0 // TESTING
-        if ((sim_north != 0) && (sim_angle == 225)) sim_angle -= sim_north;
-        sim_cx2 = sim_cx+sim_radius*cos((sim_angle+sim_north)/RADS);
-        sim_cy2 = sim_cy+sim_radius*sin((sim_angle+sim_north)/RADS);
-#endif
-        if (self->mask) { int x,y,dx,dy;      /* v0320 */
-          // double c1 = walltime(0);
-          char* mask = self->mask;
-          u_short *udata = (u_short*)data;
-          int x2=self->aoiW-1,y2=self->aoiH-1,p,q;
-          for (y=1; y<y2; y++) {              /* loop over rows */
-            p = 1 + y*self->aoiW;
-            for (x=1; x<x2; x++,p++) {        /* loop over columns */
-              if (mask[p]) { int s=0,w=0,m;   /* masked */
-                for (dy=-1; dy<=1; dy++) {    /* 8 pixels around */
-                  for (dx=-1; dx<=1; dx++) {
-                    if ((dx) || (dy)) {       /* not center */
-                      q = p + dx + dy*self->aoiW;
-                      if (!mask[q]) {         /* not masked */
-                        m = ((dx) && (dy)) ? 1 : 2;  /* weight */
-                        s += m * (int)udata[q]; 
-                        w += m;
-                      }
-                    } /* endif(!center) */
-                  } /* endfor(dx) */
-                } /* endfor(dy) */
-                if (w) udata[p] = (u_short)(0.5+(double)s/(double)w);
-              } /* endif(masked) */
-#if 0 // TESTING -- center cross 5 pixels 
-              if ((x==sim_cx)   && (y==sim_cy))   udata[p] = 0x3f00; 
-              if ((x==sim_cx-1) && (y==sim_cy))   udata[p] = 0x1f00; 
-              if ((x==sim_cx)   && (y==sim_cy-1)) udata[p] = 0x1f00; 
-              if ((x==sim_cx+1) && (y==sim_cy))   udata[p] = 0x1f00; 
-              if ((x==sim_cx)   && (y==sim_cy+1)) udata[p] = 0x1f00;
-#endif
-              /* flux = 2*PI*peak*sig*sig */
-              /* flux = 1.133*peak*fw*fw */
-#if 0 // TESTING -- gauss with slit 
-              static const int ww=30;
-              if ((x>=sim_cx-ww) && (x<=sim_cx+ww)) { 
-                if (abs(x-self->aoiW/2) < sim_slit) continue; /* blank out slit */
-                if ((y>=sim_cy-ww) && (y<=sim_cy+ww)) { 
-                  double r2 = ((x-sim_cx)*(x-sim_cx)+(y-sim_cy)*(y-sim_cy));
-                  int f = PRandom(sim_peak*exp(-r2/sim_sig2));
-                  if (f > 0x3b00) f = 0x3b00;  /* 15104 v0411 */
-                  udata[p] += (f << 2);
-                }
-              }
-#endif
-#if 0 // TESTING -- gauss without slit 
-              static const int w2=30;
-              if ((x>=sim_cx2-w2) && (x<=sim_cx2+w2)) { 
-                if ((y>=sim_cy2-w2) && (y<=sim_cy2+w2)) { 
-                  double r2 = ((x-sim_cx2)*(x-sim_cx2)+(y-sim_cy2)*(y-sim_cy2));
-                  int f = PRandom(sim_peak*exp(-r2/sim_sig2));
-                  if (f > 0x3b00) f = 0x3b00;  /* 15104 */
-                  udata[p] += (f << 2);
-                }
-              }
-#endif
-            } /* endfor(x) */
-          } /* endfor(y) */
-          // double dt = (walltime(0)-c1)*1000.0;   /* [ms] */
-          // printf("mask: %.2f [ms]\n",dt); /* takes about 5-10 ms */
-        } /* endif(mask) */
         self->seqNumber = seq;
-        ZwoFrame *frame = zwo_frame4writing(self,seq);
         if (frame) {
-          frame->seqNumber = seq;
-          register u_short *d=(u_short*)data;
-          if (self->rolling == 0) {    /* rolling average */
-            register u_short *p=frame->data;
-            for (i=0; i<npix; i++,p++,d++) *p = *d >> 2; // shift data
-            if (roll_buf) { free((void*)roll_buf); roll_buf=NULL; }
-          } else { int mul=self->rolling; float div=1+self->rolling;
 #if (TIME_TEST > 1)
-            double c1 = walltime(0);
+          double c1 = walltime(0);
 #endif
-            if (!roll_buf) {
-              roll_buf = (u_short*)malloc(npix*sizeof(u_short));
-              register u_short *p=roll_buf;
-              for (i=0; i<npix; i++,p++,d++) *p = *d >> 2;
-            } else {
-              register u_short *p=roll_buf;
-              for (i=0; i<npix; i++,p++,d++) {
-                *p = (u_short)(0.5f+(((int)*p * mul) + (int)(*d >> 2)) / div);
-              }
-            }
-            memcpy(frame->data,roll_buf,nbytes);
+          if ((self->rolling+1 != roll_n) || (self->rollMode != roll_mode)) {
+            rollav_free(&roll);        /* restart the average */
+            roll_n = self->rolling+1; roll_mode = self->rollMode;
+            if (roll_n > 1) (void)rollav_init(&roll,roll_mode,roll_n,
+                                              npix);
+          }
+          if ((self->mask != mask) || (self->maskVersion != mask_version)) {
+            mask = self->mask; mask_version = self->maskVersion;
+            if (bad) { free((void*)bad); bad=NULL; }
+            nbad = 0;
+            if (mask) bad = bad_pixels(mask,self->aoiW,self->aoiH,&nbad);
+          }
+          fix_pixels(bad,nbad,frame->data);   /* raw data */
+          if (roll.acc) {              /* shift and average */
+            rollav_add(&roll,frame->data);
+          } else { int i; u_short *p=frame->data;
+            for (i=0; i<npix; i++,p++) *p >>= 2;  /* data in high 14-bits */
+          }
 #if (TIME_TEST > 1)
-            if (self->expTime != last_expt) { 
-              s1 = s2 = sn = sm = 0; last_expt = self->expTime;
-            }
-            dt = (walltime(0)-c1)*1000.0;   /* [ms] */
-            s1 += dt; s2 += dt*dt; sn += 1.0; if (dt > sm) sm = dt;
-            if (cor_time(0) > last) { 
-              double ave = s1/sn;
-              double sig = sqrt(s2/sn-ave*ave);
-              sprintf(buf,"%s: ave=%.1f +- %.2f (%.1f)",PREFUN,ave,sig,sm);
-              message(self,buf,MSS_FILE); printf("%s\n",buf);
-              last = cor_time(0);
-            }
-#endif
+          if (self->expTime != last_expt) { 
+            s1 = s2 = sn = sm = 0; last_expt = self->expTime;
           }
+          dt = (walltime(0)-c1)*1000.0;   /* [ms] */
+          s1 += dt; s2 += dt*dt; sn += 1.0; if (dt > sm) sm = dt;
+          if (cor_time(0) > last) { 
+            double ave = s1/sn;
+            double sig = sqrt(s2/sn-ave*ave);
+            sprintf(buf,"%s: ave=%.1f +- %.2f (%.1f)",PREFUN,ave,sig,sm);
+            message(self,buf,MSS_FILE); printf("%s\n",buf);
+            last = cor_time(0);
+          }
+#endif
+          frame->seqNumber = seq;
           zwo_frame_release(self,frame);
         } // endif(frame)
       } // endif(incomplete frame)
@@ -567,8 +688,11 @@ static void* run_cycle(void* param)
     }
   } /* endwhile (!stop_flag) */
 
-  if (roll_buf) { free((void*)roll_buf); roll_buf=NULL; }
-  free((void*)data);
+  rollav_free(&roll);
+  if (spill) free((void*)spill);
+  if (bad) free((void*)bad);
+  tv.tv_sec = 0;
+  (void)setsockopt(self->handle,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));
   self->err = err;
 #if (DEBUG > 0)
   fprintf(stderr,"%s %s() done\n",__FILE__,PREFUN);
@@ -579,6 +703,16 @@ static void* run_cycle(void* param)
 
 /* ---------------------------------------------------------------- */
 
+/* call after changing the contents of 'mask': run_cycle rebuilds its */
+/* list of bad pixels (a new 'mask' pointer is noticed anyway)        */
+
+void zwo_mask_changed(ZwoStruct* self)
+{
+  self->maskVersion++;
+}
+
+/* ---------------------------------------------------------------- */
+
 int zwo_cycle_start(ZwoStruct* self)
 {
   char buf[128];
@@ -591,9 +725,16 @@ int zwo_cycle_start(ZwoStruct* self)
 
   if (!err) { int i;
     self->seqNumber = 0;
-    for (i=0; i<ZWO_NBUFS; i++) {
+    self->busCount = 0;
+    pthread_mutex_lock(&self->frameLock);
+    for (i=0; i<ZWO_CMAX; i++) {
+      ZwoConsumer *c = &self->cons[i];
+      c->last = 0; c->head = c->count = 0;
+    }
+    pthread_mutex_unlock(&self->frameLock);
+    for (i=0; i<ZWO_NFRAMES; i++) {
       ZwoFrame *frame = &self->frames[i];    
-      frame->seqNumber = 0;
+      frame->seqNumber = frame->busNumber = 0;
       assert(!frame->data);
       frame->data = (u_short*)malloc(size);
       assert(((u_long)frame->data & 0x07) == 0);
@@ -626,6 +767,9 @@ int zwo_cycle_stop(ZwoStruct *self)
 #endif
 
   self->stop_flag = 1;
+  pthread_mutex_lock(&self->frameLock);  /* wake zwo_frame_wait() */
+  pthread_cond_broadcast(&self->frameCond);
+  pthread_mutex_unlock(&self->frameLock);
   pthread_join(self->tid,NULL);  
   self->tid = 0;
 
@@ -633,7 +777,17 @@ int zwo_cycle_stop(ZwoStruct *self)
   zwo_request(self,"stop",buf,5);
   pthread_mutex_unlock(&self->ioLock);
 
-  for (i=0; i<ZWO_NBUFS; i++) {
+  pthread_mutex_lock(&self->frameLock);  /* drop queued frames */
+  for (i=0; i<ZWO_CMAX; i++) {
+    ZwoConsumer *c = &self->cons[i];
+    while (c->count > 0) {
+      c->queue[c->head]->rlock -= 1;
+      c->head = (c->head+1) % ZWO_QSLOTS; c->count--;
+    }
+  }
+  pthread_mutex_unlock(&self->frameLock);
+
+  for (i=0; i<ZWO_NFRAMES; i++) {
     ZwoFrame *f = &self->frames[i]; 
     while (f->wlock != 0) { 
       msleep(50); fprintf(stderr,"%s: f=%d, wlock=%d\n",PREFUN,i,f->wlock); 
@@ -659,7 +813,7 @@ ZwoFrame* zwo_frame4writing(ZwoStruct* self,u_int s)
 
   pthread_mutex_lock(&self->frameLock);
   
-  for (i=0; i<ZWO_NBUFS; i++) {
+  for (i=0; i<ZWO_NFRAMES; i++) {
     ZwoFrame *f = &self->frames[i];    
     assert(f->data);
     assert(f->wlock == 0);             // no frame locked for writing
@@ -692,7 +846,7 @@ ZwoFrame* zwo_frame4reading(ZwoStruct* self,u_int s)
 
   pthread_mutex_lock(&self->frameLock);
   
-  for (i=0; i<ZWO_NBUFS; i++) {
+  for (i=0; i<ZWO_NFRAMES; i++) {
     ZwoFrame *f = &self->frames[i];    
     assert(f->data);
     if (f->wlock == 0) {               // not locked for writing
@@ -711,6 +865,46 @@ ZwoFrame* zwo_frame4reading(ZwoStruct* self,u_int s)
 }
 
 
+/* ---------------------------------------------------------------- */
+
+static void deadline(struct timespec* ts,int tout)  /* now + 'tout' [ms] */
+{
+  clock_gettime(FRAME_CLOCK,ts);
+  ts->tv_sec  += tout/1000;
+  ts->tv_nsec += (long)(tout%1000)*1000000L;
+  if (ts->tv_nsec >= 1000000000L) { ts->tv_sec++; ts->tv_nsec -= 1000000000L; }
+}
+
+/* ---------------------------------------------------------------- */
+/* newest frame after 's' like zwo_frame4reading(), but blocks until  */
+/* one lands (woken by run_cycle) or 'tout' [ms] passes              */
+
+ZwoFrame* zwo_frame_wait(ZwoStruct* self,u_int s,int tout)
+{
+  int i,err=0;
+  ZwoFrame *frame=NULL;
+  struct timespec ts;
+
+  deadline(&ts,tout);
+
+  pthread_mutex_lock(&self->frameLock);
+  while (!err) {                       /* stopped: just wait 'tout' */
+    for (i=0; (i<ZWO_NFRAMES) && !self->stop_flag; i++) {
+      ZwoFrame *f = &self->frames[i];
+      if ((f->wlock == 0) && (f->seqNumber > s)) {  /* newest frame */
+        frame = f;
+        s = frame->seqNumber;
+      }
+    }
+    if (frame) break;
+    err = pthread_cond_timedwait(&self->frameCond,&self->frameLock,&ts);
+  }
+  if (frame) frame->rlock += 1;
+  pthread_mutex_unlock(&self->frameLock);
+
+  return frame;
+}
+
 /* ---------------------------------------------------------------- */
 
 void zwo_frame_release(ZwoStruct* self,ZwoFrame *frame)
@@ -721,6 +915,22 @@ void zwo_frame_release(ZwoStruct* self,ZwoFrame *frame)
     assert(frame->rlock == 0);
     assert(frame->wlock == 1);
     frame->wlock = 0;
+    frame->busNumber = 0;
+    if (frame->seqNumber) { int i;
+      frame->busNumber = ++self->busCount;
+      for (i=0; i<ZWO_CMAX; i++) {     /* frame bus: 'every' queues */
+        ZwoConsumer *c = &self->cons[i];
+        if (!c->name[0] || (c->policy != ZWO_EVERY)) continue;
+        if (c->count < c->depth) {
+          c->queue[(c->head+c->count) % ZWO_QSLOTS] = frame;
+          c->count++;
+          frame->rlock += 1;
+        } else {                       /* queue full: skipped */
+          c->ndrop++;
+        }
+      }
+      pthread_cond_broadcast(&self->frameCond);
+    }
   } else {                             /* is locked for reading */
     assert(frame->rlock >  0);
     frame->rlock -= 1;
@@ -730,18 +940,155 @@ void zwo_frame_release(ZwoStruct* self,ZwoFrame *frame)
   pthread_mutex_unlock(&self->frameLock);
 }
 
+/* ---------------------------------------------------------------- */
+/* frame bus: a consumer gets either the newest frame (ZWO_LATEST,    */
+/* e.g. display, guider) or every frame through a queue of 'depth'    */
+/* (ZWO_EVERY, e.g. writer); 'ndrop' counts the frames it skipped.    */
+/* Consumers share ZWO_QSLOTS frames: ZWO_LATEST takes one (the frame */
+/* it holds), ZWO_EVERY depth+1; a new ZWO_LATEST consumer shortens   */
+/* the deepest queue if needed. Returns the id or -1 (no slots left). */
+
+int zwo_consumer_add(ZwoStruct* self,const char* name,int policy,int depth)
+{
+  int i,id=-1,used=0;
+  ZwoConsumer *deep=NULL;
+
+  pthread_mutex_lock(&self->frameLock);
+  for (i=0; i<ZWO_CMAX; i++) {
+    ZwoConsumer *c = &self->cons[i];
+    if (!c->name[0]) { if (id < 0) id = i; continue; }
+    if (c->policy == ZWO_EVERY) {
+      used += c->depth+1;
+      if (!deep || (c->depth > deep->depth)) deep = c;
+    } else {
+      used += 1;
+    }
+  }
+  if (policy == ZWO_EVERY) {
+    depth = (depth < ZWO_QSLOTS-used-1) ? depth : ZWO_QSLOTS-used-1;
+    if (depth < 1) id = -1;            /* no slots left */
+  } else {
+    depth = 0;
+    if (used >= ZWO_QSLOTS) {          /* frames held by a queue */
+      if (deep && (deep->depth > 1)) deep->depth -= 1;
+      else id = -1;
+    }
+  }
+  if (id >= 0) {
+    ZwoConsumer *c = &self->cons[id];
+    strncpy(c->name,(*name) ? name : "?",sizeof(c->name)-1);
+    c->name[sizeof(c->name)-1] = '\0';
+    c->policy = policy;
+    c->depth = depth;
+    c->last = 0;
+    c->nget = c->ndrop = 0;
+    c->head = c->count = 0;
+  }
+  pthread_mutex_unlock(&self->frameLock);
+
+  return id;
+}
+
+/* --- */
+
+void zwo_consumer_remove(ZwoStruct* self,int id)
+{
+  if ((id < 0) || (id >= ZWO_CMAX)) return;
+
+  pthread_mutex_lock(&self->frameLock);
+  ZwoConsumer *c = &self->cons[id];
+  while (c->count > 0) {               /* release queued frames */
+    c->queue[c->head]->rlock -= 1;
+    c->head = (c->head+1) % ZWO_QSLOTS; c->count--;
+  }
+  c->name[0] = '\0';
+  pthread_mutex_unlock(&self->frameLock);
+}
+
+/* --- */
+/* next frame for consumer 'id', waits up to 'tout' [ms] for it;      */
+/* release it with zwo_frame_release()                                */
+
+ZwoFrame* zwo_consumer_get(ZwoStruct* self,int id,int tout)
+{
+  int i,err=0;
+  ZwoFrame *frame=NULL;
+  struct timespec ts;
+
+  if ((id < 0) || (id >= ZWO_CMAX)) return NULL;
+  ZwoConsumer *c = &self->cons[id];
+
+  deadline(&ts,tout);
+
+  pthread_mutex_lock(&self->frameLock);
+  while (!err) {
+    if (c->policy == ZWO_EVERY) {      /* queued: holds an 'rlock' */
+      if (c->count > 0) {
+        frame = c->queue[c->head];
+        c->head = (c->head+1) % ZWO_QSLOTS; c->count--;
+      }
+    } else { u_int s=c->last;          /* newest frame */
+      for (i=0; (i<ZWO_NFRAMES) && !self->stop_flag; i++) {
+        ZwoFrame *f = &self->frames[i];
+        if ((f->wlock == 0) && (f->busNumber > s)) {
+          frame = f;
+          s = frame->busNumber;
+        }
+      }
+      if (frame) frame->rlock += 1;
+    }
+    if (frame) break;
+    err = pthread_cond_timedwait(&self->frameCond,&self->frameLock,&ts);
+  }
+  if (frame) {                         /* published, not fetched */
+    if ((c->policy == ZWO_LATEST) && c->last &&
+        (frame->busNumber > c->last+1)) {
+      c->ndrop += frame->busNumber-c->last-1;
+    }
+    c->last = frame->busNumber;
+    c->nget++;
+  }
+  pthread_mutex_unlock(&self->frameLock);
+
+  return frame;
+}
+
+/* --- */
+/* "name got skipped ..." of all consumers                            */
+
+int zwo_consumer_stats(ZwoStruct* self,char* buf,size_t size)
+{
+  int    i,n=0;
+  size_t len=0;
+
+  *buf = '\0';
+  pthread_mutex_lock(&self->frameLock);
+  for (i=0; i<ZWO_CMAX; i++) {
+    ZwoConsumer *c = &self->cons[i];
+    if (!c->name[0]) continue;
+    if (len >= size) break;
+    len += snprintf(buf+len,size-len,"%s%s %u %u",
+                    (n) ? " " : "",c->name,c->nget,c->ndrop);
+    n++;
+  }
+  pthread_mutex_unlock(&self->frameLock);
+
+  return n;
+}
+
 /* ---------------------------------------------------------------- */
 
 int zwo_server(ZwoStruct* self,const char* cmd,char* res)
 {
+  int err;
 #if (DEBUG > 1)
   fprintf(stderr,"%s(%p,%s,%s)\n",PREFUN,self,cmd,res);
 #endif
   assert(self);
   if (self->handle < 0) return E_NOTINIT;
 
-  pthread_mutex_lock(&self->ioLock);
-  int err = zwo_request(self,cmd,res,5);
+  pthread_mutex_lock(&self->ioLock);   /* not housekeeping: 'handle' */
+  err = zwo_request(self,cmd,res,5);
   pthread_mutex_unlock(&self->ioLock);
 
   return err;
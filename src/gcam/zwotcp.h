@@ -20,17 +20,35 @@ enum zwo_errors_enum { E_zwo_error = 1+ASI_ERROR_END,
                        E_zwo_last };
 
 #define ZWO_NBUFS   3
+#define ZWO_QSLOTS  8               /* for the 'every' queues */
+#define ZWO_NFRAMES (ZWO_NBUFS+ZWO_QSLOTS)
+#define ZWO_CMAX    8               /* consumers */
+
+enum zwo_policies_enum { ZWO_LATEST,  /* newest frame, may skip */
+                         ZWO_EVERY }; /* all, queued up to 'depth' */
 
 typedef struct zwo_frame_tag {
   u_int seqNumber;
+  u_int busNumber;            /* published as #, 0 = not (yet) */
   u_short *data;
   int w,h;
   volatile int wlock,rlock;
 } ZwoFrame;
 
+typedef struct zwo_consumer_tag {   /* frame bus, frameLock */
+  char   name[16];                  /* "" = unused */
+  int    policy,depth;
+  u_int  last;                      /* busNumber of the last frame */
+  u_int  nget,ndrop;                /* frames got, skipped */
+  int    head,count;                /* 'every' queue */
+  ZwoFrame *queue[ZWO_QSLOTS];      /* each holds an 'rlock' */
+} ZwoConsumer;
+
 typedef struct zwo_struct_tag {
   char   host[128];
   int    port,handle;        /* handle=socket */
+  int    ctrl;               /* 'control' socket, -1 if none */
+  int    camera;             /* server camera # of 'handle' */
   volatile int err;
   char   serverVersion[32],modelName[32],serialNumber[32];
   u_int  cookie;
@@ -39,14 +57,20 @@ typedef struct zwo_struct_tag {
   int    aoiW,aoiH;
   double expTime;  
   int    gain,offset;
-  volatile int rolling;
+  volatile int rolling;       /* 'av': frames-1 */
+  volatile int rollMode;      /* ROLLAV_EMA, ROLLAV_MEAN */
   double fps;
   pthread_mutex_t ioLock,frameLock;
+  pthread_mutex_t ctrlLock;
+  pthread_cond_t  frameCond;  /* a frame landed, frameLock */
   u_int seqNumber;
-  ZwoFrame frames[ZWO_NBUFS];
+  u_int busCount;             /* frames published, frameLock */
+  ZwoFrame frames[ZWO_NFRAMES];
+  ZwoConsumer cons[ZWO_CMAX];
   pthread_t tid;
   volatile int stop_flag;
   char *mask;                 /* v0320 */
+  volatile u_int maskVersion; /* zwo_mask_changed() */
 } ZwoStruct;
 
 /* ---------------------------------------------------------------- */
@@ -64,11 +88,19 @@ int zwo_temperature (ZwoStruct*,const char*);
 int zwo_exptime     (ZwoStruct*,double);
 int zwo_gain        (ZwoStruct*,int,int);
 
+void zwo_mask_changed(ZwoStruct*);
+
 int zwo_cycle_start (ZwoStruct*);
 int zwo_cycle_stop  (ZwoStruct*);
 
 ZwoFrame* zwo_frame4writing(ZwoStruct*,u_int);
 ZwoFrame* zwo_frame4reading(ZwoStruct*,u_int);
+ZwoFrame* zwo_frame_wait   (ZwoStruct*,u_int,int);
+
+int       zwo_consumer_add   (ZwoStruct*,const char*,int,int);
+void      zwo_consumer_remove(ZwoStruct*,int);
+ZwoFrame* zwo_consumer_get   (ZwoStruct*,int,int);
+int       zwo_consumer_stats (ZwoStruct*,char*,size_t);
 void      zwo_frame_release(ZwoStruct*,ZwoFrame*);
 
 int zwo_server(ZwoStruct*,const char*,char*);
@@ -12,9 +12,11 @@ Protocol Summary (from zwoserver.c):
 
 Commands:
 - version: Returns server version, cookie, and startup time
+- camera [#|serial]: Selects the camera of this connection (single camera)
 - open: Opens camera, returns "width height cooler color bitDepth model"
 - close: Closes camera
-- setup [params]: Configures ROI (x, y, w, h, bin, bits)
+- setup [params]: Configures ROI (x, y, w, h, bin, bits), also while streaming
+- move x y: Moves the window start, also while streaming
 - exptime [seconds]: Sets/gets exposure time
 - gain [value]: Sets/gets gain
 - offset [value]: Sets/gets offset
@@ -23,6 +25,20 @@ Commands:
 - data [max_size]: Gets image data after exposure
 - tempcon [temp|off]: Temperature control
 - filter [position]: Filter wheel control
+- burst N: Takes N back-to-back exposures, queued for 'next'
+- calib [on|off|load]: Server-side calibration (no masters here)
+- stats [on [nhist]|off]: Per-frame statistics appended to 'next'
+- auto [on [target [pct]]|off|region x y w h|limits emin emax [gmin gmax]]:
+  Exposure/gain control (settings only, no control loop here)
+- tune fps=N [box=W]: Largest window/bits for a frame rate (readout model)
+- preview [on [width [rate [avg|stride]]]|off]: 8-bit thumbnails for 'thumb'
+- thumb [timeout]: Newest thumbnail, "seq ts_ns x y w h bin tw th f" + data
+- record [on [seconds [MB]]|off|trigger jump drop|trigger off]: Flight
+  recorder (settings only, nothing is recorded here)
+- dump: Writes the flight recorder to disk (no frames here)
+- control: Makes this a housekeeping connection beside the data connection:
+  only version, status, exptime, gain, offset, tempcon, fancon, stalls,
+  vtrace, rt and camera; its hangup does not close the camera
 - quit: Terminates server
 
 Image Format:
@@ -37,7 +53,7 @@ import struct
 import time
 import argparse
 import numpy as np
-from typing import Optional, Tuple
+from typing import List, Optional, Tuple
 
 
 class ZwoEmulator:
@@ -56,6 +72,13 @@ class ZwoEmulator:
     STATE_IDLE = "idle"
     STATE_EXPOSING = "exposing"
     STATE_VIDEO = "streaming"
+    STATE_BURST = "burst"
+
+    # Exposures queued on the server in burst mode (BURST_NBUFS)
+    BURST_NBUFS = 4
+
+    # Max. sub-windows for 'cut' (BOX_NMAX)
+    BOX_NMAX = 16
     
     def __init__(self, port: int = 52311, random_seed: Optional[int] = None):
         self.port = port
@@ -116,6 +139,30 @@ class ZwoEmulator:
         self.video_last = 0
         self.video_thread: Optional[threading.Thread] = None
         self.video_data: Optional[bytes] = None
+        self.video_geom = (0, 0, 0, 0, 1, 16)  # x y w h bin bits of video_data
+
+        # Server-side 'track': (st x y dx dy) of video_data, None if off
+        self.track_on = False
+        self.track_ref: Optional[Tuple[float, float]] = None
+        self.video_track: Optional[Tuple[int, float, float, float, float]] = None
+
+        # Sub-windows cut from each video frame ('box', 'cut')
+        self.boxes: List[Tuple[int, int, int, int]] = []
+        self.stats_on = False
+        self.stats_nhist = 0
+        self.auto_on = False
+        self.auto_target, self.auto_pct = 0.5, 100.0
+        self.pv_on, self.pv_width, self.pv_rate, self.pv_mode = False, 512, 2.0, "avg"
+        self.pv_seq, self.pv_t, self.pv_frame = 0, 0.0, 0  # pv_frame: video seq
+        self.rec_on, self.rec_seconds, self.rec_mb = False, 10.0, 256
+        self.rec_jump, self.rec_drop = 0.0, 0.0
+
+        # Burst exposures
+        self.burst_n = 0
+        self.burst_seq = 0
+        self.burst_last = 0
+        self.burst_queue: List[Tuple[bytes, int, int]] = []
+        self.burst_thread: Optional[threading.Thread] = None
         
         # Tracking star for video mode (simulates a guide star that drifts)
         self.star_x = 0.0
@@ -124,6 +171,20 @@ class ZwoEmulator:
         self.star_center_y = 0.0
         self.star_initialized = False
         
+    def _frame_stats(self, data: bytes, bits: int) -> str:
+        """'stats' fields: " min max mean bg noise nsat [hist..]" """
+        a = np.frombuffer(data, dtype=np.uint8 if bits == 8 else "<u2")
+        full = 256 if bits == 8 else 65536
+        sat = 255 if bits == 8 else 65520
+        bg = float(np.median(a))
+        noise = bg - float(np.percentile(a, 15.87))
+        out = (f" {a.min()} {a.max()} {a.mean():.1f} {bg:.1f} {noise:.1f} "
+               f"{int((a >= sat).sum())}")
+        if self.stats_nhist:
+            hist, _ = np.histogram(a, bins=self.stats_nhist, range=(0, full))
+            out += "".join(f" {v}" for v in hist)
+        return out
+
     def _draw_gaussian_star(self, image: np.ndarray, x: float, y: float, 
                             brightness: float, sigma: float = 2.5) -> None:
         """Draw a Gaussian star profile at the given position."""
@@ -250,8 +311,46 @@ class ZwoEmulator:
             with self.lock:
                 if self.state == self.STATE_VIDEO:
                     self.video_data = self.generate_random_image(is_video=True)
+                    self.video_geom = (self.roi_x, self.roi_y, self.roi_w,
+                                       self.roi_h, self.binning, self.bits)
+                    self.video_track = None
+                    if self.track_on:
+                        # Star position in binned sensor pixels
+                        x = self.roi_x + self.star_x
+                        y = self.roi_y + self.star_y
+                        if self.track_ref is None:
+                            self.track_ref = (x, y)
+                        self.video_track = (1, x, y, x - self.track_ref[0],
+                                            y - self.track_ref[1])
                     self.video_seq += 1
+
+    def _start_video(self):
+        """Enter streaming state and spawn the video thread."""
+        self.state = self.STATE_VIDEO
+        self.video_seq = 0
+        self.video_last = 0
+        self.video_data = None
+        self.pv_frame = 0
+        self.star_initialized = False  # Reset star position for new video session
+        self.video_thread = threading.Thread(target=self._video_thread_func)
+        self.video_thread.daemon = True
+        self.video_thread.start()
     
+    def _burst_thread_func(self):
+        """Burst thread - back-to-back exposures into a bounded queue."""
+        while self.state == self.STATE_BURST and self.burst_seq < self.burst_n:
+            if self.burst_seq - self.burst_last >= self.BURST_NBUFS:
+                time.sleep(0.001)  # queue full, client not fetching
+                continue
+            t0 = time.time_ns()
+            time.sleep(self.exp_time)
+            with self.lock:
+                if self.state != self.STATE_BURST:
+                    break
+                data = self.generate_random_image()
+                self.burst_queue.append((data, time.time_ns(), t0))
+                self.burst_seq += 1
+
     def handle_command(self, command: str) -> Tuple[str, Optional[bytes]]:
         """
         Handle a command and return (response_text, optional_binary_data).
@@ -283,6 +382,12 @@ class ZwoEmulator:
                 # Return camera serial number as hex string
                 response = self.serial_number
                 
+            elif cmd == "camera":
+                # one camera: index 0, selected by number or serial
+                if args and args[0] not in ("0", self.serial_number):
+                    return "-Eerr=20", None  # E_no_camera
+                response = f"0 1 {self.serial_number}"
+
             elif cmd == "open":
                 if self.state == self.STATE_CLOSED:
                     self.state = self.STATE_IDLE
@@ -293,6 +398,196 @@ class ZwoEmulator:
                     self.state = self.STATE_CLOSED
                 response = "OK"
                 
+            elif cmd == "setup" and self.state == self.STATE_VIDEO and len(args) >= 6:
+                # New window between frames, not stored
+                x, y, w, h, b, bits = (int(a) for a in args[:6])
+                w, h = (w // 8) * 8, (h // 2) * 2
+                if (b < 1 or b > 4 or bits not in (8, 16) or w < 8 or h < 2 or
+                        x < 0 or y < 0 or (x + w) * b > self.width or
+                        (y + h) * b > self.height):
+                    return "-Einvalid geometry", None
+                self.roi_x, self.roi_y, self.roi_w, self.roi_h = x, y, w, h
+                self.binning, self.bits = b, bits
+                self.star_initialized = False
+                response = f"{x} {y} {w} {h} {b} {bits}"
+
+            elif cmd == "auto":
+                # "on|off target pct exptime gain level steps"
+                if args and args[0] == "on":
+                    t = float(args[1]) if len(args) > 1 else self.auto_target
+                    p = float(args[2]) if len(args) > 2 else self.auto_pct
+                    if not (0 < t < 1) or not (50 <= p <= 100):
+                        return "-Einvalid auto", None
+                    self.auto_on, self.auto_target, self.auto_pct = True, t, p
+                elif args and args[0] == "off":
+                    self.auto_on = False
+                elif args and args[0] == "region" and len(args) >= 5:
+                    pass
+                elif args and args[0] == "limits" and len(args) >= 3:
+                    if float(args[1]) <= 0 or float(args[2]) < float(args[1]):
+                        return "-Einvalid auto", None
+                elif args:
+                    return "-Einvalid command", None
+                response = (f"{'on' if self.auto_on else 'off'} {self.auto_target:.2f} "
+                            f"{self.auto_pct:.1f} {self.exp_time:.6f} {self.gain} 0.000 0")
+
+            elif cmd == "tune":
+                # "x y w h bin bits predicted measured", from the readout
+                # law of the ASI294MM (no sweep, no link limit here)
+                opts = dict(a.split("=", 1) for a in args if "=" in a)
+                fps, box = float(opts.get("fps", 0)), int(opts.get("box", 0))
+                if fps <= 0 or box < 0:
+                    return "-Einvalid tune", None
+                if self.state != self.STATE_IDLE:
+                    return "-Eerr=22", None  # E_not_idle
+                for b in (1, 2, 4):
+                    a0, b0 = (0.0074, 38e-6) if b == 1 else (0.00515, 10e-6)
+                    if a0 + 32 * b0 > 1 / fps:
+                        continue
+                    n = min(int((1 / fps - a0) / b0), self.width // b,
+                            self.height // b) & ~7
+                    if n >= 8 and n * b >= box:
+                        break
+                else:
+                    return "-Efps not reachable", None
+                cx = (self.roi_x + self.roi_w // 2) * self.binning
+                cy = (self.roi_y + self.roi_h // 2) * self.binning
+                self.roi_x = max(0, min(cx // b - n // 2, self.width // b - n)) & ~1
+                self.roi_y = max(0, min(cy // b - n // 2, self.height // b - n)) & ~1
+                self.roi_w = self.roi_h = n
+                self.binning, self.bits = b, 16
+                f = 1 / max(self.exp_time, a0 + b0 * n)
+                response = (f"{self.roi_x} {self.roi_y} {n} {n} {b} 16 "
+                            f"{f:.1f} {f:.1f}")
+
+            elif cmd == "preview":
+                # "on|off width rate avg|stride n"
+                if args and args[0] == "on":
+                    w = int(args[1]) if len(args) > 1 else self.pv_width
+                    r = float(args[2]) if len(args) > 2 else self.pv_rate
+                    m = args[3] if len(args) > 3 else self.pv_mode
+                    if not (64 <= w <= 1024) or not (0 < r <= 10) or m not in ("avg", "stride"):
+                        return "-Einvalid preview", None
+                    self.pv_on, self.pv_width, self.pv_rate, self.pv_mode = True, w, r, m
+                elif args and args[0] == "off":
+                    self.pv_on = False
+                elif args:
+                    return "-Einvalid command", None
+                response = (f"{'on' if self.pv_on else 'off'} {self.pv_width} "
+                            f"{self.pv_rate:.1f} {self.pv_mode} {self.pv_seq}")
+
+            elif cmd == "thumb":
+                # newest video frame reduced by f, 8 bits, at <= 'rate' Hz
+                if self.state != self.STATE_VIDEO:
+                    return "-Eerr=24", None  # E_not_video
+                if not self.pv_on:
+                    return "-Eno preview", None
+                timeout = float(args[0]) if args else 0.0
+                start_time = time.time()
+                self.lock.release()
+                try:
+                    while (self.video_seq <= self.pv_frame or
+                           time.time() < self.pv_t + 1 / self.pv_rate):
+                        if time.time() - start_time >= timeout:
+                            break
+                        time.sleep(0.005)
+                finally:
+                    self.lock.acquire()
+                if (self.video_seq <= self.pv_frame or
+                        time.time() < self.pv_t + 1 / self.pv_rate):
+                    return "-Enodata", None
+                gx, gy, gw, gh, gb, gbits = self.video_geom
+                f = max(1, -(-max(gw, gh) // self.pv_width))
+                tw, th = gw // f, gh // f
+                a = np.frombuffer(self.video_data, dtype=np.uint8 if gbits == 8 else "<u2")
+                a = a.reshape(gh, gw)[:th * f, :tw * f]
+                if self.pv_mode == "stride":
+                    t = a[f // 2::f, f // 2::f]
+                else:
+                    t = a.reshape(th, f, tw, f).mean(axis=(1, 3))
+                t = (t / (256 if gbits == 16 else 1)).astype(np.uint8)
+                self.pv_seq, self.pv_t, self.pv_frame = self.pv_seq + 1, time.time(), self.video_seq
+                binary_data = t.tobytes()
+                response = (f"{self.video_seq} {time.time_ns()} {gx} {gy} {gw} {gh} {gb} "
+                            f"{tw} {th} {f}")
+
+            elif cmd == "record":
+                # "on|off seconds MB frames span ndrop ndump dumping jump drop"
+                if args and args[0] == "on":
+                    t = float(args[1]) if len(args) > 1 else self.rec_seconds
+                    mb = int(args[2]) if len(args) > 2 else self.rec_mb
+                    if t <= 0 or mb < 1:
+                        return "-Einvalid record", None
+                    self.rec_on, self.rec_seconds, self.rec_mb = True, t, mb
+                elif args and args[0] == "off":
+                    self.rec_on = False
+                elif len(args) > 1 and args[0] == "trigger":
+                    if args[1] == "off":
+                        self.rec_jump, self.rec_drop = 0.0, 0.0
+                    elif (len(args) > 2 and float(args[1]) >= 0 and
+                          0 <= float(args[2]) < 1):
+                        self.rec_jump, self.rec_drop = float(args[1]), float(args[2])
+                    else:
+                        return "-Einvalid record", None
+                elif args:
+                    return "-Einvalid command", None
+                response = (f"{'on' if self.rec_on else 'off'} {self.rec_seconds:.1f} "
+                            f"{self.rec_mb if self.rec_on else 0} 0 0.00 0 0 0 "
+                            f"{self.rec_jump:.2f} {self.rec_drop:.2f}")
+
+            elif cmd == "dump":
+                return "-Eno frames", None
+
+            elif cmd == "stats":
+                # per-frame statistics, appended to 'next'
+                if args and args[0] == "on":
+                    nh = int(args[1]) if len(args) > 1 else 0
+                    if nh < 0 or nh > 64 or (nh & (nh - 1)):
+                        return "-Einvalid histogram", None
+                    self.stats_on, self.stats_nhist = True, nh
+                elif args and args[0] == "off":
+                    self.stats_on = False
+                elif args:
+                    return "-Einvalid command", None
+                response = f"{'on' if self.stats_on else 'off'} {self.stats_nhist}"
+
+            elif cmd == "calib":
+                # no master bias/dark/flat on the emulator
+                if args and args[0] in ("on", "load"):
+                    return "-Eno masters", None
+                if args and args[0] != "off":
+                    return "-Einvalid command", None
+                response = "off 0 0 0 0 0 0 0 0"
+
+            elif cmd == "box":
+                # Register a sub-window (binned sensor pixels) for 'cut'
+                if args and args[0].lower() == "clear":
+                    self.boxes = []
+                elif args:
+                    if len(args) < 4:
+                        return "-Einvalid box", None
+                    x, y, w, h = (int(a) for a in args[:4])
+                    if (len(self.boxes) >= self.BOX_NMAX or w < 1 or h < 1 or
+                            x < 0 or y < 0 or w > self.roi_w or h > self.roi_h or
+                            (x + w) * self.binning > self.width or
+                            (y + h) * self.binning > self.height):
+                        return "-Einvalid box", None
+                    self.boxes.append((x, y, w, h))
+                response = str(len(self.boxes))
+
+            elif cmd == "move":
+                # Window start position, between frames while streaming
+                if len(args) < 2:
+                    return "-Einvalid geometry", None
+                if self.state not in (self.STATE_IDLE, self.STATE_VIDEO):
+                    return "-Eerr=22", None  # E_not_idle
+                x, y = int(args[0]), int(args[1])
+                if (x < 0 or y < 0 or (x + self.roi_w) * self.binning > self.width or
+                        (y + self.roi_h) * self.binning > self.height):
+                    return "-Einvalid geometry", None
+                self.roi_x, self.roi_y = x, y
+                response = f"{x} {y}"
+
             elif cmd == "setup":
                 if self.state != self.STATE_IDLE:
                     return "-Eerr=22", None  # E_not_idle
@@ -350,7 +645,9 @@ class ZwoEmulator:
                 response = str(self.offset)
                 
             elif cmd == "status":
-                if self.state == self.STATE_EXPOSING:
+                if self.state == self.STATE_BURST:
+                    response = f"burst {self.burst_seq} {self.burst_n}"
+                elif self.state == self.STATE_EXPOSING:
                     elapsed = time.time() - self.exposure_start_time
                     if elapsed >= self.exp_time:
                         self.state = self.STATE_IDLE
@@ -359,6 +656,9 @@ class ZwoEmulator:
                         response = f"exposing {elapsed:.1f}"
                 else:
                     response = self.state
+
+            elif cmd == "stalls":
+                response = "0 0 0"  # stalls re-arms failed-re-arms
                     
             elif cmd == "expose":
                 if self.state != self.STATE_IDLE:
@@ -428,35 +728,100 @@ class ZwoEmulator:
                 # Start video capture mode
                 if self.state != self.STATE_IDLE:
                     return "-Eerr=22", None  # E_not_idle
-                self.state = self.STATE_VIDEO
-                self.video_seq = 0
-                self.video_last = 0
-                self.video_data = None
-                self.star_initialized = False  # Reset star position for new video session
-                # Start video thread
-                self.video_thread = threading.Thread(target=self._video_thread_func)
-                self.video_thread.daemon = True
-                self.video_thread.start()
+                self.track_on = False
+                self._start_video()
                 response = "OK"
-                
+
+            elif cmd == "track":
+                # Acquire-then-track: the emulator locks on its drifting
+                # star right away (no acquisition frame) in a box*box window
+                if self.state == self.STATE_VIDEO and self.track_on:
+                    if args and args[0].lower() == "off":
+                        self.track_on = False
+                    st, x, y, dx, dy = self.video_track or (0, 0.0, 0.0, 0.0, 0.0)
+                    response = f"{st} {x:.2f} {y:.2f} {dx:.2f} {dy:.2f}"
+                elif self.state != self.STATE_IDLE:
+                    return "-Eerr=22", None  # E_not_idle
+                else:
+                    box = max(16, min(512, int(args[0]) if args else 64)) & ~7
+                    b = max(1, min(4, int(args[1]) if len(args) > 1 else 2))
+                    self.binning, self.bits = b, 16
+                    self.roi_w = self.roi_h = box
+                    self.roi_x = ((self.width // b - box) // 2) & ~1
+                    self.roi_y = ((self.height // b - box) // 2) & ~1
+                    self.track_on = True
+                    self.track_ref = None
+                    self._start_video()
+                    response = f"{box} {b}"
+
+            elif cmd == "burst":
+                # N back-to-back exposures, fetched with 'next'
+                if self.state != self.STATE_IDLE:
+                    return "-Eerr=22", None  # E_not_idle
+                if not args or int(args[0]) < 1:
+                    return "-Einvalid burst length", None
+                self.state = self.STATE_BURST
+                self.burst_n = int(args[0])
+                self.burst_seq = 0
+                self.burst_last = 0
+                self.burst_queue = []
+                self.burst_thread = threading.Thread(target=self._burst_thread_func)
+                self.burst_thread.daemon = True
+                self.burst_thread.start()
+                response = str(self.burst_n)
+
             elif cmd == "stop":
                 # Stop video capture mode
-                if self.state == self.STATE_VIDEO:
+                if self.state == self.STATE_BURST:
                     self.state = self.STATE_IDLE
+                    self.burst_queue = []
+                elif self.state == self.STATE_VIDEO:
+                    self.state = self.STATE_IDLE
+                    self.track_on = False
                     # Thread will exit on next iteration
                     if self.video_thread:
                         self.video_thread.join(timeout=1.0)
                         self.video_thread = None
                 response = "OK"
                 
-            elif cmd == "next":
+            elif cmd in ("next", "cut"):
                 # Get next video frame (used in video streaming mode)
                 # Format: next [timeout]
-                # Returns: "sequence_num temperature cooler_power" + binary image data
+                # Returns: "seq temp power ts_ns x y w h bin bits" + binary image data
+                # ('track': + "st x y dx dy" of the star)
                 # Or "-Enodata" if no new frame within timeout
+                if self.state == self.STATE_BURST:
+                    # Oldest queued exposure: "seq temp power ts_ns start_ns"
+                    timeout = float(args[0]) if args else 0.0
+                    start_time = time.time()
+                    self.lock.release()
+                    try:
+                        while (not self.burst_queue and
+                               self.burst_thread and self.burst_thread.is_alive()):
+                            if time.time() - start_time >= timeout:
+                                break
+                            time.sleep(0.001)
+                    finally:
+                        self.lock.acquire()
+                    if self.burst_queue:
+                        data, ts, t0 = self.burst_queue.pop(0)
+                        self.burst_last += 1
+                        if self.burst_last >= self.burst_n:
+                            self.state = self.STATE_IDLE
+                        binary_data = data
+                        response = (f"{self.burst_last} {self.temperature:.1f} "
+                                    f"{self.cooler_power:.0f} {ts} {t0}")
+                    else:
+                        if not (self.burst_thread and self.burst_thread.is_alive()):
+                            self.state = self.STATE_IDLE
+                        response = "-Enodata"
+                    return response, binary_data
+
                 if self.state != self.STATE_VIDEO:
                     return "-Eerr=24", None  # E_not_video
-                    
+                if cmd == "cut" and not self.boxes:
+                    return "-Eno boxes", None
+
                 timeout = float(args[0]) if args else 0.0
                 start_time = time.time()
                 current_last = self.video_last
@@ -478,7 +843,34 @@ class ZwoEmulator:
                     self.image_data = self.video_data
                     self.image_size = len(self.image_data) if self.image_data else 0
                     binary_data = self.image_data
-                    response = f"{self.video_last} {self.temperature:.1f} {self.cooler_power:.0f} {time.time_ns()}"
+                    if cmd == "cut":
+                        # Boxes of one frame, shifted into the window:
+                        # "seq temp power ts_ns k x1 y1 .. xk yk" + data
+                        gx, gy, gw, gh, _, gbits = self.video_geom
+                        bpp = gbits // 8
+                        if any(w > gw or h > gh for _, _, w, h in self.boxes):
+                            return "-Eerr=23", None  # E_no_data
+                        frame = np.frombuffer(self.image_data, dtype=np.uint8)
+                        frame = frame.reshape((gh, gw * bpp))
+                        cuts, offsets = [], []
+                        for bx, by, w, h in self.boxes:
+                            x = max(0, min(bx - gx, gw - w))
+                            y = max(0, min(by - gy, gh - h))
+                            cuts.append(frame[y:y + h, x * bpp:(x + w) * bpp].tobytes())
+                            offsets.append(f"{gx + x} {gy + y}")
+                        binary_data = b"".join(cuts)
+                        return (f"{self.video_last} {self.temperature:.1f} "
+                                f"{self.cooler_power:.0f} {time.time_ns()} "
+                                f"{len(self.boxes)} " + " ".join(offsets)), binary_data
+                    geom = " ".join(str(v) for v in self.video_geom)
+                    response = (f"{self.video_last} {self.temperature:.1f} "
+                                f"{self.cooler_power:.0f} {time.time_ns()} {geom}")
+                    if self.video_track:
+                        st, x, y, dx, dy = self.video_track
+                        response += f" {st} {x:.2f} {y:.2f} {dx:.2f} {dy:.2f}"
+                    if self.stats_on:
+                        response += self._frame_stats(self.image_data,
+                                                      self.video_geom[5])
                 else:
                     response = "-Enodata"
                 
@@ -495,6 +887,7 @@ class ZwoEmulator:
         """Handle a single client connection."""
         print(f"Connection accepted from {address[0]}:{address[1]}")
         
+        control = False
         try:
             buffer = b""
             while self.running:
@@ -521,7 +914,17 @@ class ZwoEmulator:
                     buffer = buffer[term_pos + 1:]
                     
                     if command:
-                        response, binary_data = self.handle_command(command)
+                        word = (command.split() or [""])[0].lower()
+                        if word == "control":
+                            control = True
+                            response, binary_data = "OK", None
+                        elif control and word not in \
+                                ("version", "status", "exptime", "gain",
+                                 "offset", "tempcon", "fancon", "stalls",
+                                 "vtrace", "rt", "camera"):
+                            response, binary_data = "-Edata connection only", None
+                        else:
+                            response, binary_data = self.handle_command(command)
                         
                         # Send text response
                         client_socket.sendall((response + "\n").encode("utf-8"))
@@ -537,9 +940,10 @@ class ZwoEmulator:
         finally:
             print(f"Connection closed from {address[0]}:{address[1]}")
             client_socket.close()
-            # Reset state on disconnect
-            with self.lock:
-                self.state = self.STATE_CLOSED
+            # Reset state on disconnect (not for 'control' connections)
+            if not control:
+                with self.lock:
+                    self.state = self.STATE_CLOSED
     
     def start(self, blocking: bool = True):
         """Start the emulator server."""
@@ -9,7 +9,7 @@ Usage:
     # Test emulator only:
     python zwo_test.py --emulator-only
     
-    # Compare emulator with real camera on localhost:52311:
+    # Emulator, then the feature table (tests 11-22) on a real server:
     python zwo_test.py --real-host localhost --real-port 52311
     
     # Compare with custom ports:
@@ -38,6 +38,133 @@ class TestResult:
     real_response: Optional[str] = None
 
 
+def _geom(r):
+    """x y w h bin bits of a 'next' header."""
+    return r.split()[4:10]
+
+
+def _frame_bytes(r):
+    """Binary size announced by a 'next' header (0 for '-E...')."""
+    g = _geom(r)
+    return int(g[2]) * int(g[3]) * int(g[5]) // 8 if len(g) == 6 else 0
+
+
+def _burst_ok(r, seq):
+    p = r.split()
+    return len(p) == 5 and p[0] == str(seq) and int(p[4]) < int(p[3])
+
+
+def _stats_ok(r):
+    f = r.split()
+    return (len(f) == 10 + 6 + 16 and sum(int(v) for v in f[16:]) == 64 * 64
+            and int(f[10]) <= float(f[12]) <= int(f[11]))
+
+
+# Tests 11-22: one row per server feature, (name, expected answer, steps).
+# A step is (command, binary bytes, check[, tries]): 'command' may be a
+# function of the previous answer, "ctl:cmd" goes to a second connection
+# ("ctl:" hangs it up), 'bytes' may be a function of the answer, 'check'
+# None accepts any answer and 'tries' repeats until the check passes.
+FEATURE_TESTS = [
+    ("burst", "seq temp power ts_ns start_ns", [
+        ("setup 0 0 64 64 1 16", 0, None),
+        ("exptime 0.01", 0, None),
+        ("burst 3", 0, lambda r: r == "3"),
+        ("next 2.0", 64 * 64 * 2, lambda r: _burst_ok(r, 1)),
+        ("next 2.0", 64 * 64 * 2, lambda r: _burst_ok(r, 2)),
+        ("next 2.0", 64 * 64 * 2, lambda r: _burst_ok(r, 3)),
+        ("status", 0, lambda r: r == "idle"),
+    ]),
+    ("move", "seq temp power ts_ns x y w h bin bits", [
+        ("setup 0 0 128 128 1 16", 0, None),
+        ("start", 0, None),
+        ("next 2.0", _frame_bytes,
+         lambda r: _geom(r) == ["0", "0", "128", "128", "1", "16"]),
+        ("setup 32 16 64 32 1 16", 0, lambda r: r == "32 16 64 32 1 16"),
+        ("move 40 20", 0, lambda r: r == "40 20"),
+        ("next 2.0", _frame_bytes,
+         lambda r: _geom(r) == ["40", "20", "64", "32", "1", "16"], 20),
+        ("stop", 0, None),
+    ]),
+    ("track", "... x y w h bin bits st x y dx dy", [
+        ("track 64 2", 0, lambda r: r == "64 2"),
+        ("next 2.0", _frame_bytes,
+         lambda r: (_geom(r)[2:] == ["64", "64", "2", "16"]
+                    and len(r.split()) == 15 and r.split()[10] == "1"), 50),
+        ("track", 0, lambda r: len(r.split()) == 5),
+        ("stop", 0, None),
+    ]),
+    ("cut", "seq temp power ts_ns k x1 y1 .. xk yk", [
+        ("setup 0 0 128 128 1 16", 0, None),
+        ("box 8 8 16 16", 0, lambda r: r == "1"),
+        ("box 120 100 32 8", 0, lambda r: r == "2"),
+        ("start", 0, None),
+        ("cut 2.0", (16 * 16 + 32 * 8) * 2,
+         lambda r: r.split()[4:] == ["2", "8", "8", "96", "100"]),
+        ("stop", 0, None),
+        ("box clear", 0, lambda r: r == "0"),
+    ]),
+    ("camera", "index ncameras serial", [
+        ("camera", 0, lambda r: r.split()[:2] == ["0", "1"]),
+        (lambda prev: f"camera {prev.split()[-1]}", 0,
+         lambda r: r.split()[0] == "0"),
+        ("camera 3", 0, lambda r: r.startswith("-E")),
+    ]),
+    ("calib", "on|off bin bias dark flat nbad pedestal frames skipped", [
+        ("calib", 0,
+         lambda r: r.split()[0] in ("on", "off") and len(r.split()) == 9),
+        ("calib on", 0, lambda r: r.startswith("-E")),
+    ]),
+    ("stats", "... bits min max mean bg noise nsat h1..h16", [
+        ("setup 0 0 64 64 1 16", 0, None),
+        ("stats on 16", 0, lambda r: r == "on 16"),
+        ("start", 0, None),
+        ("next 2.0", 64 * 64 * 2, _stats_ok),
+        ("stop", 0, None),
+        ("stats off", 0, None),
+    ]),
+    ("auto", "on|off target pct exptime gain level steps", [
+        ("auto on 0.4 99", 0,
+         lambda r: r.split()[:3] == ["on", "0.40", "99.0"] and len(r.split()) == 7),
+        ("auto on 1.5", 0, lambda r: r.startswith("-E")),
+        ("auto off", 0, lambda r: r.startswith("off")),
+    ]),
+    ("tune", "x y w h bin bits predicted measured", [
+        ("exptime 0.001", 0, None),
+        ("tune fps=100 box=100", 0,
+         lambda r: (len(r.split()) == 8
+                    and int(r.split()[2]) * int(r.split()[4]) >= 100
+                    and float(r.split()[6]) >= 99.5)),
+        ("tune fps=100000", 0, lambda r: r.startswith("-E")),
+    ]),
+    ("preview", "seq ts_ns x y w h bin tw th f", [
+        ("preview on 128 10", 0,
+         lambda r: r.split()[:4] == ["on", "128", "10.0", "avg"]),
+        ("setup 0 0 512 256 1 16", 0, None),
+        ("start", 0, None),
+        ("thumb 2.0", 128 * 64,
+         lambda r: len(r.split()) == 10 and r.split()[7:] == ["128", "64", "4"]),
+        ("stop", 0, None),
+        ("preview off", 0, None),
+    ]),
+    ("record", "on|off seconds MB frames span ndrop ndump dumping jump drop", [
+        ("record on 5 32", 0,
+         lambda r: r.split()[:3] == ["on", "5.0", "32"] and len(r.split()) == 10),
+        ("record trigger 2.5 0.3", 0,
+         lambda r: r.split()[8:] == ["2.50", "0.30"]),
+        ("record trigger 1 1.5", 0, lambda r: r.startswith("-E")),
+        ("record off", 0, None),
+    ]),
+    ("control", "OK, no binary data, camera stays open", [
+        ("ctl:control", 0, lambda r: r == "OK"),
+        ("ctl:gain", 0, lambda r: not r.startswith("-E")),
+        ("ctl:thumb 0.1", 0, lambda r: r.startswith("-E")),
+        ("ctl:", 0, None),
+        ("status", 0, lambda r: r != "closed"),
+    ]),
+]
+
+
 class ZwoTestClient:
     """Test client for ZWO camera server."""
     
@@ -109,6 +236,16 @@ class ZwoTestClient:
                 
         return text_response, binary_data
         
+    def recv_exact(self, n: int) -> bytes:
+        """Read n bytes (recv() with a timeout may return fewer)."""
+        data = b""
+        while len(data) < n:
+            chunk = self.socket.recv(min(1 << 20, n - len(data)))
+            if not chunk:
+                break
+            data += chunk
+        return data
+
     def __enter__(self):
         self.connect()
         return self
@@ -357,19 +494,72 @@ class ZwoProtocolTester:
                 print(f"   Passed: {passed}")
                 self.results.append(TestResult("filters", passed, "", resp))
                 
-                # Test 11: Close
-                print("\n11. Testing 'close' command...")
+                # Tests 11-22: feature table (also run on a real server)
+                self.run_feature_tests(emu_client)
+
+                # Test 23: Close
+                print("\n23. Testing 'close' command...")
                 resp, _ = emu_client.send_command("close")
                 passed = resp == "OK"
                 print(f"   Emulator: {resp}")
                 print(f"   Passed: {passed}")
                 self.results.append(TestResult("close", passed, "", resp))
                 
+            if self.real_host:         # the same table on the real server
+                print(f"\n[Feature table on {self.real_host}:{self.real_port}]")
+                with ZwoTestClient(self.real_host, self.real_port, "real") as real:
+                    real.send_command("open")
+                    self.run_feature_tests(real)
+
         finally:
             self.stop_emulator()
             
         # Print summary
         self.print_summary()
+
+    def run_feature_tests(self, client: ZwoTestClient, first: int = 11):
+        """Run FEATURE_TESTS on the open camera of 'client'."""
+        client.socket.settimeout(30.0)   # 'tune' measures for seconds
+        for k, (name, expects, steps) in enumerate(FEATURE_TESTS, first):
+            print(f"\n{k}. Testing '{name}'...")
+            passed, resp, ctl = True, "", None
+            try:
+                for step in steps:
+                    cmd, nbytes, check = step[:3]
+                    tries = step[3] if len(step) > 3 else 1
+                    conn = client
+                    if callable(cmd):
+                        cmd = cmd(resp)
+                    if cmd.startswith("ctl:"):    # second connection
+                        cmd = cmd[4:]
+                        if not cmd:                  # hang it up
+                            ctl.disconnect()
+                            time.sleep(0.1)
+                            continue
+                        if ctl is None:
+                            ctl = ZwoTestClient(client.host, client.port, "control")
+                            ctl.connect()
+                        conn = ctl
+                    for _ in range(tries):         # frames in flight
+                        resp, _ = conn.send_command(cmd)
+                        if callable(nbytes):
+                            n = nbytes(resp)
+                        else:
+                            n = 0 if resp.startswith("-E") else nbytes
+                        data = conn.recv_exact(n)
+                        ok = len(data) == n and (check is None or check(resp))
+                        if ok:
+                            break
+                    passed = passed and ok
+            except (OSError, ValueError, IndexError) as e:
+                passed, resp = False, str(e)
+            finally:
+                if ctl:
+                    ctl.disconnect()
+            print(f"   {client.name}: {resp}")
+            print(f"   Passed: {passed} (expects: {expects})")
+            label = name if client.name == "emulator" else f"{name} ({client.name})"
+            self.results.append(TestResult(label, passed, "", resp))
         
     def run_comparison_test(self):
         """Run comparison tests between emulator and real server."""
@@ -537,11 +537,14 @@ static void* run_cycle(void* param)
         do {
           ASIGetExpStatus(self->handle,&status); // printf("status=%d\n",status);
           if (status != ASI_EXP_WORKING) break;
+          msleep(1);                   /* don't spin on the USB bus */
         } while (walltime(0) < timeout);
         err = E_asi_timeout;
         if (status == ASI_EXP_SUCCESS) { 
           int ret = ASIGetDataAfterExp(self->handle,self->data_0,bufSize);
           err = (ret == ASI_SUCCESS) ? 0 : E_asi_timeout;
+          /* restart right away: next exposure overlaps the processing */
+          if (!err && !self->stop_flag) ASIStartExposure(self->handle,ASI_FALSE);
         }
       }
       pthread_mutex_unlock(&self->ioLock);
@@ -571,9 +574,6 @@ static void* run_cycle(void* param)
         memcpy(frame->data,self->data_0,bufSize);
         asi_frame_release(self,frame);
       }
-      pthread_mutex_lock(&self->ioLock);
-      if (!self->videoMode) ASIStartExposure(self->handle,ASI_FALSE);
-      pthread_mutex_unlock(&self->ioLock);
       if (err) {  
         sprintf(buf,"%s: PANIC -- buffer queue failed, err=%d",PREFUN,err);
         message(self,buf,MSG_FILE);
@@ -0,0 +1,403 @@
+/* -----------------------------------------------------------------
+ *
+ * calib.c
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * Server-side calibration of 16-bit frames before they are handed to
+ * any client: master bias, dark and flat (FITS, e.g. stacked from
+ * 'write' frames) per camera and binning, and a sparse bad pixel list
+ * (hot in the dark, dead in the flat, plus a text file). The masters
+ * are folded into one offset, one dark rate and one gain (Q15) per
+ * pixel at load time, so a frame of any exptime costs a multiply and
+ * a multiply-add per pixel of its window plus the bad pixels.
+ * The row kernels are built with -O3 (see makefile): SSE2/NEON.
+ *
+ * ---------------------------------------------------------------- */
+
+/* DEFINEs -------------------------------------------------------- */
+
+#ifndef DEBUG
+#define DEBUG           1
+#endif
+
+#define CALIB_NSAMPLE   4096           /* median/sigma sample */
+
+/* INCLUDEs ------------------------------------------------------- */
+
+#include <stdlib.h>                    /* qsort() */
+#include <stdio.h>
+#include <string.h>                    /* memset() */
+#include <math.h>                      /* lround() */
+
+#include "calib.h"
+
+/* TYPEDEFs ------------------------------------------------------- */
+
+typedef struct {
+  int    x,y,w,h,bin;                  /* WINDOW, BINNING */
+  double exptime;                      /* EXPTIME */
+  float  *data;
+} Master;
+
+/* ---------------------------------------------------------------- */
+
+void calib_init(Calib *cal)
+{
+  memset(cal,0,sizeof(Calib));
+  pthread_mutex_init(&cal->lock,NULL);
+}
+
+/* ---------------------------------------------------------------- */
+/* FITS as written by 'write' (or any 2-D image): BITPIX 8,16,32,-32 */
+/* returns 0 and the data as float; WINDOW/BINNING are optional      */
+
+static int read_fits(const char *file,Master *m)
+{
+  int    i,bitpix=0,naxis=0,end=0,nb;
+  long   npix;
+  double bzero=0,bscale=1;
+  char   card[81],key[9],*val;
+  u_char *raw;
+  FILE   *fp;
+
+  memset(m,0,sizeof(Master));
+  m->bin = 0;                          /* not given */
+  m->x = m->y = -1;
+  if ((fp = fopen(file,"r")) == NULL) return -1;
+  for (i=0; !end; i++) {               /* 36 cards per 2880 block */
+    if (fread(card,1,80,fp) != 80) { fclose(fp); return -1; }
+    card[80] = '\0';
+    sscanf(card,"%8s",key);
+    val = (card[8] == '=') ? card+10 : card+80;
+    if      (!strcmp(key,"END"))     end = 1;
+    else if (!strcmp(key,"BITPIX"))  bitpix = atoi(val);
+    else if (!strcmp(key,"NAXIS"))   naxis = atoi(val);
+    else if (!strcmp(key,"NAXIS1"))  m->w = atoi(val);
+    else if (!strcmp(key,"NAXIS2"))  m->h = atoi(val);
+    else if (!strcmp(key,"BZERO"))   bzero = atof(val);
+    else if (!strcmp(key,"BSCALE"))  bscale = atof(val);
+    else if (!strcmp(key,"EXPTIME")) m->exptime = atof(val);
+    else if (!strcmp(key,"BINNING")) m->bin = atoi(val);
+    else if (!strcmp(key,"WINDOW")) { int x1,x2,y1,y2;  /* [x1:x2,y1:y2] */
+      if (sscanf(val," '[%d:%d,%d:%d]",&x1,&x2,&y1,&y2) == 4) {
+        m->x = x1-1; m->y = y1-1;
+      }
+    }
+  }
+  (void)fseek(fp,(i+35)/36*2880L,SEEK_SET);
+  nb = abs(bitpix)/8;
+  npix = (long)m->w*m->h;
+  if ((naxis != 2) || (npix <= 0) || ((nb != 1) && (nb != 2) && (nb != 4))) {
+    fclose(fp); return -1;
+  }
+  raw = (u_char*)malloc(npix*nb);
+  m->data = (float*)malloc(npix*sizeof(float));
+  if (!raw || !m->data || (fread(raw,nb,npix,fp) != (size_t)npix)) {
+    free((void*)raw); free((void*)m->data); m->data = NULL;
+    fclose(fp); return -1;
+  }
+  fclose(fp);
+  for (i=0; i<npix; i++) {             /* big endian */
+    const u_char *b = raw+(size_t)i*nb;
+    u_int  u = (nb == 1) ? b[0] : (nb == 2) ? (b[0]<<8)|b[1] :
+               ((u_int)b[0]<<24)|(b[1]<<16)|(b[2]<<8)|b[3];
+    double v;
+    if      (bitpix ==   8) v = u;
+    else if (bitpix ==  16) v = (short)u;
+    else if (bitpix ==  32) v = (int)u;
+    else { float f; memcpy(&f,&u,sizeof(f)); v = f; }
+    m->data[i] = (float)(bscale*v+bzero);
+  }
+  free((void*)raw);
+  if (m->x < 0) m->x = m->y = 0;       /* no WINDOW: full frame */
+
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+static int cmp_float(const void *a,const void *b)
+{
+  float u=*(const float*)a,v=*(const float*)b;
+  return (u > v) - (u < v);
+}
+
+/* median and sigma (from the median absolute deviation) of 'data'   */
+
+static void sample_stats(const float *data,size_t n,double *med,double *sig)
+{
+  int    i,k;
+  size_t j,step=n/CALIB_NSAMPLE | 1;
+  float  s[CALIB_NSAMPLE];
+
+  for (j=k=0; (j<n) && (k<CALIB_NSAMPLE); j+=step) s[k++] = data[j];
+  qsort(s,k,sizeof(float),cmp_float);
+  *med = s[k/2];
+  for (i=0; i<k; i++) s[i] = fabsf(s[i]-(float)*med);
+  qsort(s,k,sizeof(float),cmp_float);
+  *sig = 1.4826*s[k/2];
+}
+
+/* ---------------------------------------------------------------- */
+/* load the masters '<path>_bias.fits', '<path>_dark.fits' (EXPTIME) */
+/* and '<path>_flat.fits' and the bad pixel list '<path>.bad' ("x y" */
+/* per line, binned sensor pixels); all masters must have the same   */
+/* window and binning 'bin'; returns the number of masters (0: off)  */
+
+int calib_load(Calib *cal,const char *path,int bin,char *msg)
+{
+  int      i,k,nm=0,nbad=0,ped=0,have=0;
+  size_t   n=0;
+  char     file[600],line[128],*kind[3]={"bias","dark","flat"};
+  double   med,sig;
+  Master   m[3],*w=NULL;
+  u_short  *gain=NULL;
+  float    *dark=NULL;
+  int      *offs=NULL;
+  u_int    *bad=NULL;
+  u_char   *mask=NULL;
+  FILE     *fp;
+
+  *msg = '\0';
+  for (k=0; k<3; k++) {                /* read all, check geometry */
+    sprintf(file,"%s_%s.fits",path,kind[k]);
+    if (read_fits(file,&m[k])) continue;
+    if ((m[k].bin && (m[k].bin != bin)) ||
+        (w && ((m[k].x != w->x) || (m[k].y != w->y) ||
+               (m[k].w != w->w) || (m[k].h != w->h)))) {
+      sprintf(msg+strlen(msg),"%s: wrong window, ",kind[k]);
+      free((void*)m[k].data); m[k].data = NULL;
+      continue;
+    }
+    if (!w) w = &m[k];
+    sprintf(msg+strlen(msg),"%s ",kind[k]);
+    have |= 1<<k;
+    nm++;
+  }
+  if (nm == 0) {
+    strcat(msg,"no masters");
+  } else {
+    n = (size_t)w->w*w->h;
+    mask = (u_char*)calloc(n,sizeof(u_char));
+    offs = (int*)malloc(n*sizeof(int));
+    Master *b = (m[0].data) ? &m[0] : (m[1].data) ? &m[1] : NULL;
+    if (b) {                           /* bias, or dark at its exptime */
+      sample_stats(b->data,n,&med,&sig);
+      ped = (int)med;
+    }
+    if (m[1].data) {                   /* dark: hot pixels */
+      float *d = m[1].data;
+      if (m[0].data) for (i=0; i<n; i++) d[i] -= m[0].data[i];
+      sample_stats(d,n,&med,&sig);
+      sig = fmax(sig,1.0);             /* quantized: MAD can be 0 */
+      for (i=0; i<n; i++) if (d[i] > med+CALIB_HOT*sig) mask[i] = 1;
+      if (m[0].data && (m[1].exptime > 0)) {  /* dark current [ADU/s] */
+        dark = (float*)malloc(n*sizeof(float));
+        for (i=0; i<n; i++) dark[i] = d[i]/m[1].exptime;
+      }
+    }
+    if (m[2].data) {                   /* flat: gain, dead pixels */
+      float *f = m[2].data;
+      if (m[0].data) for (i=0; i<n; i++) f[i] -= m[0].data[i];
+      sample_stats(f,n,&med,&sig);
+      if (med > 0) {
+        gain = (u_short*)malloc(n*sizeof(u_short));
+        for (i=0; i<n; i++) {
+          if (f[i] < CALIB_DEAD*med) {
+            mask[i] = 1;
+            gain[i] = CALIB_ONE;
+          } else {
+            gain[i] = (u_short)fmin(65535,CALIB_ONE*med/f[i]+0.5);
+          }
+        }
+      } else {
+        strcat(msg,"(flat<=0) ");
+      }
+    }
+    sprintf(file,"%s.bad",path);
+    if ((fp = fopen(file,"r")) != NULL) { int x,y;
+      while (fgets(line,sizeof(line),fp)) {
+        if (sscanf(line,"%d %d",&x,&y) != 2) continue;  /* '#' comment */
+        x -= w->x; y -= w->y;
+        if ((x >= 0) && (x < w->w) && (y >= 0) && (y < w->h)) {
+          mask[(size_t)y*w->w+x] = 1;
+        }
+      }
+      fclose(fp);
+      strcat(msg,"bad ");
+    }
+    for (i=0; i<n; i++) {              /* fold in the flat gain */
+      double g = (gain) ? gain[i]/(double)CALIB_ONE : 1.0;
+      double o = (b) ? fmax(0,fmin(65535,b->data[i])) : 0;
+      offs[i] = (int)lround(o*g)-ped;
+      if (dark) dark[i] *= (float)g;
+    }
+    for (i=0; i<n; i++) nbad += mask[i];
+    bad = (u_int*)malloc((nbad+1)*sizeof(u_int));
+    for (i=k=0; i<n; i++) if (mask[i]) bad[k++] = (u_int)i;
+    sprintf(msg+strlen(msg),"%d bad pixels, pedestal %d",nbad,ped);
+  }
+  for (k=0; k<3; k++) if (m[k].data) free((void*)m[k].data);
+
+  pthread_mutex_lock(&cal->lock);      /* swap */
+  { u_short *g=cal->gain; float *r=cal->dark;
+    int *o=cal->offs; u_int *l=cal->bad; u_char *s=cal->mask;
+    cal->dark = dark; cal->gain = gain;
+    cal->offs = offs; cal->bad = bad; cal->mask = mask;
+    cal->nbad = nbad; cal->pedestal = ped; cal->have = have;
+    cal->bin = bin;
+    if (w) { cal->x = w->x; cal->y = w->y; cal->w = w->w; cal->h = w->h; }
+    else   { cal->x = cal->y = cal->w = cal->h = 0; }
+    pthread_mutex_unlock(&cal->lock);
+    free((void*)g); free((void*)r);
+    free((void*)o); free((void*)l); free((void*)s);
+  }
+#if (DEBUG > 0)
+  fprintf(stderr,"%s(%s): %s\n",__func__,path,msg);
+#endif
+
+  return nm;
+}
+
+/* ---------------------------------------------------------------- */
+/* row kernels: auto-vectorized (-O3) widening multiply, clamp       */
+
+static void sub_row(u_short *restrict d,const int *restrict o,int n)
+{
+  int i;
+
+  for (i=0; i<n; i++) {
+    int v = (int)d[i]-o[i];
+    d[i] = (u_short)((v < 0) ? 0 : (v > 65535) ? 65535 : v);
+  }
+}
+
+static void flat_row(u_short *restrict d,const int *restrict o,
+                     const u_short *restrict g,int n)
+{
+  int i;
+
+  for (i=0; i<n; i++) {
+    int v = (int)(((u_int)d[i]*g[i]+CALIB_ONE/2) >> 15)-o[i];
+    d[i] = (u_short)((v < 0) ? 0 : (v > 65535) ? 65535 : v);
+  }
+}
+
+static void dark_row(u_short *restrict d,const int *restrict o,
+                     const float *restrict k,float t,int n)
+{
+  int i;
+
+  for (i=0; i<n; i++) {
+    float v = (float)((int)d[i]-o[i])-k[i]*t+0.5f;
+    v = (v < 0.0f) ? 0.0f : v;         /* float clamp: vectorizes */
+    v = (v > 65535.0f) ? 65535.0f : v;
+    d[i] = (u_short)(int)v;
+  }
+}
+
+static void flat_dark_row(u_short *restrict d,const int *restrict o,
+                          const float *restrict k,const u_short *restrict g,
+                          float t,int n)
+{
+  int i;
+
+  for (i=0; i<n; i++) {
+    float v = (float)((int)(((u_int)d[i]*g[i]+CALIB_ONE/2) >> 15)-o[i])-
+              k[i]*t+0.5f;
+    v = (v < 0.0f) ? 0.0f : v;
+    v = (v > 65535.0f) ? 65535.0f : v;
+    d[i] = (u_short)(int)v;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+/* bad pixels of the window at (x0,y0) of the masters: weighted mean */
+/* of the good neighbours (2 for edge, 1 for corner, as gcam 'mask') */
+
+static void repair(const Calib *cal,u_short *d,int x0,int y0,int w,int h)
+{
+  int    lo=0,hi=cal->nbad,dx,dy;
+  u_int  first=(u_int)y0*cal->w;
+
+  while (lo < hi) {                    /* first bad pixel in row y0 */
+    int mid = (lo+hi)/2;
+    if (cal->bad[mid] < first) lo = mid+1; else hi = mid;
+  }
+  for (; lo<cal->nbad; lo++) {
+    int x = cal->bad[lo] % cal->w - x0;
+    int y = cal->bad[lo] / cal->w - y0;
+    if (y >= h) break;
+    if ((x < 0) || (x >= w)) continue;
+    int s=0,sw=0;
+    for (dy=-1; dy<=1; dy++) {
+      if ((y+dy < 0) || (y+dy >= h)) continue;
+      for (dx=-1; dx<=1; dx++) {
+        if ((x+dx < 0) || (x+dx >= w) || (!dx && !dy)) continue;
+        if (cal->mask[cal->bad[lo]+dy*cal->w+dx]) continue;
+        int m = (dx && dy) ? 1 : 2;
+        s  += m*d[(y+dy)*w+x+dx];
+        sw += m;
+      }
+    }
+    if (sw) d[y*w+x] = (u_short)((s+sw/2)/sw);
+  }
+}
+
+/* ---------------------------------------------------------------- */
+/* calibrate a 16-bit frame of window (x,y,w,h,bin) in place; never  */
+/* blocks the capture thread: returns -1 (and counts) if the masters */
+/* are being loaded or do not cover the window                       */
+
+int calib_apply(Calib *cal,u_char *data,int x,int y,int w,int h,int bin,
+                int bits,double exptime)
+{
+  int    r;
+  u_short *d=(u_short*)data;
+
+  if (!cal->on) return 0;
+  if ((bits != 16) || pthread_mutex_trylock(&cal->lock)) {
+    cal->nskip++;
+    return -1;
+  }
+  if (!cal->offs || (bin != cal->bin) || (x < cal->x) || (y < cal->y) ||
+      (x+w > cal->x+cal->w) || (y+h > cal->y+cal->h)) {
+    pthread_mutex_unlock(&cal->lock);
+    cal->nskip++;
+    return -1;
+  }
+  x -= cal->x; y -= cal->y;
+  for (r=0; r<h; r++) {
+    size_t   k = (size_t)(y+r)*cal->w+x;
+    u_short *p = d+(size_t)r*w;
+    if (cal->dark) {
+      if (cal->gain) flat_dark_row(p,cal->offs+k,cal->dark+k,cal->gain+k,
+                                   (float)exptime,w);
+      else           dark_row(p,cal->offs+k,cal->dark+k,(float)exptime,w);
+    } else {
+      if (cal->gain) flat_row(p,cal->offs+k,cal->gain+k,w);
+      else           sub_row (p,cal->offs+k,w);
+    }
+  }
+  if (cal->nbad) repair(cal,d,x,y,w,h);
+  cal->nframes++;
+  pthread_mutex_unlock(&cal->lock);
+
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+void calib_free(Calib *cal)
+{
+  pthread_mutex_lock(&cal->lock);
+  free((void*)cal->dark); free((void*)cal->gain);
+  free((void*)cal->offs); free((void*)cal->bad); free((void*)cal->mask);
+  cal->dark = NULL; cal->gain = NULL;
+  cal->offs = NULL; cal->bad = NULL; cal->mask = NULL;
+  cal->nbad = cal->have = 0; cal->w = cal->h = 0;
+  pthread_mutex_unlock(&cal->lock);
+}
+
+/* ---------------------------------------------------------------- */
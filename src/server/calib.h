@@ -0,0 +1,51 @@
+/* ----------------------------------------------------------------
+ *
+ * calib.h
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * bias/dark/flat calibration and bad pixel repair of raw frames
+ *
+ * ---------------------------------------------------------------- */
+
+#ifndef INCLUDE_CALIB_H
+#define INCLUDE_CALIB_H
+
+#include <sys/types.h>
+#include <pthread.h>
+
+/* DEFINEs -------------------------------------------------------- */
+
+#define CALIB_HOT       8.0            /* hot pixel in the dark [sigma] */
+#define CALIB_DEAD      0.5            /* dead pixel in the flat [mean] */
+#define CALIB_ONE       32768          /* gain 1.0 (Q15) */
+
+/* TYPEDEFs ------------------------------------------------------- */
+
+typedef struct calib_tag {
+  pthread_mutex_t lock;                /* 'load' vs. capture thread */
+  int      on;
+  int      x,y,w,h,bin;                /* masters [binned sensor px] */
+  int      have;                       /* 1=bias, 2=dark, 4=flat */
+  u_short  *gain;                      /* 1/flat [Q15] or NULL */
+  int      *offs;                      /* bias*gain-pedestal */
+  float    *dark;                      /* dark current*gain [ADU/s] */
+  int      pedestal;                   /* keeps the raw zero point */
+  u_int    *bad;                       /* bad pixels, index into w*h */
+  u_char   *mask;                      /* w*h, 1=bad */
+  int      nbad;
+  u_int    nframes,nskip;              /* calibrated, not covered */
+} Calib;
+
+/* function prototype(s) ------------------------------------------ */
+
+void    calib_init    (Calib*);
+int     calib_load    (Calib*,const char*,int,char*);
+int     calib_apply   (Calib*,u_char*,int,int,int,int,int,int,double);
+void    calib_free    (Calib*);
+
+/* ---------------------------------------------------------------- */
+
+#endif /* INCLUDE_CALIB_H */
+
+/* ---------------------------------------------------------------- */
@@ -0,0 +1,100 @@
+/* -----------------------------------------------------------------
+ *
+ * fpool.c
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * Frame buffer pool: all frame buffers of a camera (video ring,
+ * burst queue) come out of a single
+ * allocation, sized for the current ROI and pre-faulted at 'setup'
+ * time, so the first frames of a stream see no page-fault stalls.
+ * The memory budget decides the ring depth.
+ *
+ * ---------------------------------------------------------------- */
+
+/* DEFINEs -------------------------------------------------------- */
+
+#ifndef DEBUG
+#define DEBUG           1
+#endif
+
+#define _GNU_SOURCE                    /* MADV_HUGEPAGE */
+
+/* INCLUDEs ------------------------------------------------------- */
+
+#include <stdlib.h>                    /* posix_memalign() */
+#include <stdio.h>
+#include <string.h>                    /* memset() */
+#include <unistd.h>                    /* sysconf() */
+#include <sys/mman.h>                  /* madvise() */
+
+#include "fpool.h"
+
+/* ---------------------------------------------------------------- */
+
+static size_t round_up(size_t v,size_t a)
+{
+  return (v+a-1)/a*a;
+}
+
+/* ---------------------------------------------------------------- */
+/* (re)allocate for 'frame' bytes (+'pad' for SDK overruns) per slot */
+/* ring depth: as many slots as fit into the budget, 2..FPOOL_NMAX;  */
+/* returns the ring depth                                            */
+
+int fpool_setup(FramePool *pool,size_t frame,size_t pad,int prefault)
+{
+  int    n;
+  size_t align,slot,page=(size_t)sysconf(_SC_PAGESIZE);
+
+  align = (frame+pad >= FPOOL_HUGE) ? FPOOL_HUGE : FPOOL_ALIGN;
+  slot  = round_up(frame+pad,align);
+  n = (int)(pool->budget/slot);
+  if (n > FPOOL_NMAX) n = FPOOL_NMAX;
+  if (n < 2) n = 2;                    /* budget too small */
+#if (DEBUG > 1)
+  fprintf(stderr,"%s(%zu,%zu): n=%d slot=%zu\n",__func__,frame,pad,n,slot);
+#endif
+
+  if (pool->base && (pool->slot == slot) && (pool->n == n)) {
+    pool->frame = frame;
+    return n;                          /* same geometry */
+  }
+  fpool_free(pool);
+  if (posix_memalign((void**)&pool->base,align,(size_t)n*slot)) {
+    pool->base = NULL;
+    return 0;
+  }
+  pool->huge = 0;
+#ifdef MADV_HUGEPAGE
+  if (align == FPOOL_HUGE) {           /* fewer TLB misses on memcpy */
+    pool->huge = !madvise(pool->base,(size_t)n*slot,MADV_HUGEPAGE);
+  }
+#endif
+  pool->frame = frame;
+  pool->slot  = slot;
+  pool->n     = n;
+  if (prefault) { size_t i;            /* touch every page now */
+    for (i=0; i<(size_t)n*slot; i+=page) pool->base[i] = 0;
+  }
+  return n;
+}
+
+/* ---------------------------------------------------------------- */
+
+u_char* fpool_slot(const FramePool *pool,int i)
+{
+  return pool->base + (size_t)(i % pool->n)*pool->slot;
+}
+
+/* ---------------------------------------------------------------- */
+
+void fpool_free(FramePool *pool)
+{
+  if (pool->base) free((void*)pool->base);
+  pool->base = NULL;
+  pool->n = 0;
+  pool->slot = pool->frame = 0;
+}
+
+/* ---------------------------------------------------------------- */
@@ -0,0 +1,43 @@
+/* ----------------------------------------------------------------
+ *
+ * fpool.h
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * pre-allocated, pre-faulted frame buffer pool
+ *
+ * ---------------------------------------------------------------- */
+
+#ifndef INCLUDE_FPOOL_H
+#define INCLUDE_FPOOL_H
+
+#include <sys/types.h>
+
+/* DEFINEs -------------------------------------------------------- */
+
+#define FPOOL_NMAX      8              /* max. ring depth */
+#define FPOOL_ALIGN     64             /* cache line */
+#define FPOOL_HUGE      (2L<<20)       /* hugepage alignment above this */
+
+/* TYPEDEFs ------------------------------------------------------- */
+
+typedef struct frame_pool_tag {
+  u_char *base;                        /* one allocation for all slots */
+  size_t  frame;                       /* bytes per frame (ROI) */
+  size_t  slot;                        /* frame+pad, aligned */
+  size_t  budget;                      /* [bytes] */
+  int     n;                           /* ring slots */
+  int     huge;                        /* madvise(MADV_HUGEPAGE) */
+} FramePool;
+
+/* function prototype(s) ------------------------------------------ */
+
+int     fpool_setup   (FramePool*,size_t,size_t,int);
+u_char* fpool_slot    (const FramePool*,int);
+void    fpool_free    (FramePool*);
+
+/* ---------------------------------------------------------------- */
+
+#endif /* INCLUDE_FPOOL_H */
+
+/* ---------------------------------------------------------------- */
@@ -0,0 +1,242 @@
+/* -----------------------------------------------------------------
+ *
+ * frec.c
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * Flight recorder: one copier thread puts every video frame with its
+ * header into one pre-faulted ring buffer (positions count bytes from
+ * the start, a frame never wraps): frec_reserve() a place, copy, then
+ * frec_commit() the frame, or frec_lost() if the copy is no good; the
+ * oldest frames are retired as the ring fills. A dump writes the frames
+ * of the last 'seconds' on its own thread to <path>.raw (frames back to
+ * back) and <path>.txt (one line per frame: header and offset). Frames
+ * not yet written are protected: while dumping, a frame that would
+ * overwrite them is not recorded ('ndrop') rather than stalling.
+ *
+ * ---------------------------------------------------------------- */
+
+/* DEFINEs -------------------------------------------------------- */
+
+#ifndef DEBUG
+#define DEBUG           1
+#endif
+
+/* INCLUDEs ------------------------------------------------------- */
+
+#include <stdlib.h>                    /* posix_memalign() */
+#include <stdio.h>
+#include <string.h>                    /* memset() */
+#include <unistd.h>                    /* sysconf() */
+
+#include "frec.h"
+
+/* ---------------------------------------------------------------- */
+
+void frec_init(FlightRec *rec)
+{
+  memset(rec,0,sizeof(FlightRec));
+  pthread_mutex_init(&rec->lock,NULL);
+}
+
+/* ---------------------------------------------------------------- */
+/* (re)allocate 'bytes' for the last 'seconds', pre-faulted; not    */
+/* while the copier may run unless the size is the same             */
+
+int frec_alloc(FlightRec *rec,size_t bytes,double seconds)
+{
+  size_t i,page=(size_t)sysconf(_SC_PAGESIZE);
+
+  rec->seconds = seconds;
+  if (rec->base && (rec->cap == bytes)) return 0;
+  if (rec->dumping) return -1;
+  frec_free(rec);
+  rec->head = 0;
+  rec->first = rec->n = 0;
+  if (!rec->idx) rec->idx = (FrecFrame*)malloc(FREC_NMAX*sizeof(FrecFrame));
+  if (!rec->idx ||
+      posix_memalign((void**)&rec->base,FREC_ALIGN,bytes)) {
+    rec->base = NULL;
+    return -1;
+  }
+  for (i=0; i<bytes; i+=page) rec->base[i] = 0;  /* touch every page */
+  rec->cap = bytes;
+
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+/* place for the frame 'hdr' in the ring (copier thread), its       */
+/* position in 'pos'; NULL if not recorded (does not fit, or would  */
+/* overwrite frames being dumped)                                   */
+
+u_char* frec_reserve(FlightRec *rec,const FrecFrame *hdr,
+                     unsigned long long *pos)
+{
+  unsigned long long end;
+  size_t size=(size_t)hdr->w*hdr->h*hdr->bits/8;
+
+  if (!rec->base || (size > rec->cap)) return NULL;
+
+  pthread_mutex_lock(&rec->lock);
+  *pos = rec->head;
+  if (*pos % rec->cap + size > rec->cap) *pos += rec->cap - *pos % rec->cap;
+  end = *pos + size;
+  if (rec->dumping && (rec->dump_next < rec->dump_end) &&
+      ((end - rec->idx[rec->dump_next % FREC_NMAX].pos > rec->cap) ||
+       (rec->n - rec->dump_next >= FREC_NMAX))) {
+    rec->ndrop++;
+    pthread_mutex_unlock(&rec->lock);
+    return NULL;
+  }
+  while ((rec->first < rec->n) &&      /* retire overwritten frames */
+         ((end - rec->idx[rec->first % FREC_NMAX].pos > rec->cap) ||
+          (rec->n - rec->first >= FREC_NMAX))) rec->first++;
+  pthread_mutex_unlock(&rec->lock);
+
+  return rec->base + *pos % rec->cap;
+}
+
+/* ---------------------------------------------------------------- */
+/* the frame 'hdr' copied to 'pos' (frec_reserve) is in the ring     */
+
+void frec_commit(FlightRec *rec,const FrecFrame *hdr,unsigned long long pos)
+{
+  size_t size=(size_t)hdr->w*hdr->h*hdr->bits/8;
+
+  pthread_mutex_lock(&rec->lock);
+  FrecFrame *f = &rec->idx[rec->n % FREC_NMAX];
+  *f = *hdr;
+  f->pos = pos;
+  f->size = (u_int)size;
+  rec->n++;
+  rec->head = (pos+size+FREC_ALIGN-1)/FREC_ALIGN*FREC_ALIGN;
+  pthread_mutex_unlock(&rec->lock);
+}
+
+/* ---------------------------------------------------------------- */
+/* 'n' frames the copier could not record ('ndrop')                  */
+
+void frec_lost(FlightRec *rec,u_int n)
+{
+  pthread_mutex_lock(&rec->lock);
+  rec->ndrop += n;
+  pthread_mutex_unlock(&rec->lock);
+}
+
+/* ---------------------------------------------------------------- */
+
+static void* run_dump(void *param)
+{
+  FlightRec *rec = (FlightRec*)param;
+  FrecFrame f;
+  FILE   *fr,*fi;
+  unsigned long long off=0;
+  char   buf[600];
+
+  sprintf(buf,"%s.raw",rec->path);
+  fr = fopen(buf,"w");
+  sprintf(buf,"%s.txt",rec->path);
+  fi = fopen(buf,"w");
+  if (fr && fi) {
+    fprintf(fi,"# %s\n",rec->why);
+    fprintf(fi,"# seq ts_ns x y w h bin bits exptime gain st cx cy flux"
+               " offset\n");
+    while (rec->dump_next < rec->dump_end) {
+      pthread_mutex_lock(&rec->lock);  /* protected from the copier */
+      f = rec->idx[rec->dump_next % FREC_NMAX];
+      pthread_mutex_unlock(&rec->lock);
+      if (fwrite(rec->base + f.pos % rec->cap,1,f.size,fr) != f.size) break;
+      fprintf(fi,"%u %llu %d %d %d %d %d %d %.6f %d %d %.2f %.2f %.0f %llu\n",
+              f.seq,f.ts,f.x,f.y,f.w,f.h,f.bin,f.bits,f.exptime,f.gain,
+              f.st,f.cx,f.cy,f.flux,off);
+      off += f.size;
+      pthread_mutex_lock(&rec->lock);
+      rec->dump_next++;
+      pthread_mutex_unlock(&rec->lock);
+    }
+  }
+  if (fr) fclose(fr);
+  if (fi) fclose(fi);
+#if (DEBUG > 0)
+  fprintf(stderr,"%s: %s %llu bytes\n",__func__,rec->path,off);
+#endif
+  pthread_mutex_lock(&rec->lock);
+  rec->dump_next = rec->dump_end;
+  rec->dumping = 0;
+  pthread_mutex_unlock(&rec->lock);
+
+  return NULL;
+}
+
+/* ---------------------------------------------------------------- */
+/* write the last 'seconds' to 'path'.raw/.txt on a new thread;      */
+/* returns the number of frames, -1 if busy or empty                 */
+
+int frec_dump(FlightRec *rec,const char *path,const char *why)
+{
+  u_int  i;
+  int    r;
+  pthread_t tid;
+  pthread_attr_t attr;
+  unsigned long long t0,dt;
+
+  pthread_mutex_lock(&rec->lock);
+  if (rec->dumping || (rec->first >= rec->n)) {
+    pthread_mutex_unlock(&rec->lock);
+    return -1;
+  }
+  t0 = rec->idx[(rec->n-1) % FREC_NMAX].ts;
+  dt = (unsigned long long)(rec->seconds*1.0e9);
+  t0 = (t0 > dt) ? t0-dt : 0;          /* less history: all of it */
+  for (i=rec->first; i<rec->n; i++) {
+    if (rec->idx[i % FREC_NMAX].ts >= t0) break;
+  }
+  rec->dump_next = i;
+  rec->dump_end = rec->n;
+  rec->dumping = 1;
+  rec->ndump++;
+  strncpy(rec->path,path,sizeof(rec->path)-1);
+  strncpy(rec->why,why,sizeof(rec->why)-1);
+  r = (int)(rec->dump_end-rec->dump_next);
+  pthread_mutex_unlock(&rec->lock);
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&tid,&attr,run_dump,rec)) {
+    pthread_attr_destroy(&attr);
+    rec->dumping = 0;
+    return -1;
+  }
+  pthread_attr_destroy(&attr);
+
+  return r;
+}
+
+/* ---------------------------------------------------------------- */
+/* history in the ring [s]                                           */
+
+double frec_span(FlightRec *rec)
+{
+  double span=0;
+
+  pthread_mutex_lock(&rec->lock);
+  if (rec->n > rec->first) {
+    span = (double)(rec->idx[(rec->n-1) % FREC_NMAX].ts -
+                    rec->idx[rec->first % FREC_NMAX].ts)/1.0e9;
+  }
+  pthread_mutex_unlock(&rec->lock);
+
+  return span;
+}
+
+/* ---------------------------------------------------------------- */
+
+void frec_free(FlightRec *rec)
+{
+  if (rec->base) free((void*)rec->base);
+  rec->base = NULL;
+  rec->cap = 0;
+}
+
+/* ---------------------------------------------------------------- */
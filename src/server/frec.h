@@ -0,0 +1,66 @@
+/* ----------------------------------------------------------------
+ *
+ * frec.h
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * flight recorder: the last seconds of video, dumped on demand
+ *
+ * ---------------------------------------------------------------- */
+
+#ifndef INCLUDE_FREC_H
+#define INCLUDE_FREC_H
+
+#include <sys/types.h>
+#include <pthread.h>
+
+/* DEFINEs -------------------------------------------------------- */
+
+#define FREC_NMAX       65536          /* max. frames in the recorder */
+#define FREC_ALIGN      64             /* cache line */
+
+/* TYPEDEFs ------------------------------------------------------- */
+
+typedef struct frec_frame_tag {        /* header of a recorded frame */
+  u_int    seq;
+  unsigned long long ts;               /* [ns] */
+  int      x,y,w,h,bin,bits;
+  double   exptime;
+  int      gain;
+  int      st;                         /* 'track': 1=star, 0, -1, 2=off */
+  double   cx,cy,flux;
+  unsigned long long pos;              /* in the ring [bytes] */
+  u_int    size;
+} FrecFrame;
+
+typedef struct flight_rec_tag {
+  pthread_mutex_t lock;                /* copier vs. dump thread */
+  u_char   *base;                      /* ring buffer */
+  size_t   cap;
+  double   seconds;                    /* history to dump */
+  FrecFrame *idx;                      /* FREC_NMAX headers, ring */
+  unsigned long long head;             /* next free position [bytes] */
+  u_int    first,n;                    /* frames [first,n) in the ring */
+  volatile int dumping;
+  u_int    dump_next,dump_end;         /* being written, protected */
+  u_int    ndrop,ndump;                /* not recorded, dumps */
+  char     path[512];                  /* of the last dump, w/o extension */
+  char     why[128];
+} FlightRec;
+
+/* function prototype(s) ------------------------------------------ */
+
+void    frec_init     (FlightRec*);
+int     frec_alloc    (FlightRec*,size_t,double);
+u_char* frec_reserve  (FlightRec*,const FrecFrame*,unsigned long long*);
+void    frec_commit   (FlightRec*,const FrecFrame*,unsigned long long);
+void    frec_lost     (FlightRec*,u_int);
+int     frec_dump     (FlightRec*,const char*,const char*);
+double  frec_span     (FlightRec*);
+void    frec_free     (FlightRec*);
+
+/* ---------------------------------------------------------------- */
+
+#endif /* INCLUDE_FREC_H */
+
+/* ---------------------------------------------------------------- */
@@ -0,0 +1,127 @@
+/* -----------------------------------------------------------------
+ *
+ * fstats.c
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * Statistics of a (calibrated) frame in one pass, in the capture
+ * thread, so clients get autoscale, background and saturation with
+ * the frame header instead of each scanning the pixels again. Every
+ * row is reduced (min/max/sum, vectorized at -O3, see makefile) and
+ * then binned into a fine histogram while it is still in the cache:
+ * 256 bins for 8-bit, 4096 for 16-bit frames (the 12 bits of the ADC,
+ * MSB aligned). Median, percentiles, the saturated count and the
+ * coarse histogram come from the fine one.
+ *
+ * ---------------------------------------------------------------- */
+
+/* DEFINEs -------------------------------------------------------- */
+
+#define FINE_BITS       12             /* 16-bit: v>>4 */
+
+/* INCLUDEs ------------------------------------------------------- */
+
+#include <string.h>                    /* memset() */
+
+#include "fstats.h"
+
+/* ---------------------------------------------------------------- */
+
+static inline void row16(const u_short *restrict d,int n,u_int *lo,
+                         u_int *hi,unsigned long long *sum)
+{
+  int    i;
+  u_int  a=*lo,b=*hi,s=0;              /* s < 2^32: n*65535 */
+
+  for (i=0; i<n; i++) {
+    u_int v = d[i];
+    a = (v < a) ? v : a;
+    b = (v > b) ? v : b;
+    s += v;
+  }
+  *lo = a; *hi = b; *sum += s;
+}
+
+static inline void row8(const u_char *restrict d,int n,u_int *lo,
+                        u_int *hi,unsigned long long *sum)
+{
+  int    i;
+  u_int  a=*lo,b=*hi,s=0;
+
+  for (i=0; i<n; i++) {
+    u_int v = d[i];
+    a = (v < a) ? v : a;
+    b = (v > b) ? v : b;
+    s += v;
+  }
+  *lo = a; *hi = b; *sum += s;
+}
+
+/* ---------------------------------------------------------------- */
+/* value at fraction 'p' of the fine histogram, interpolated in bin */
+/* (first non-empty bin: p=0 must not divide by an empty one)        */
+
+static double percentile(const u_int *fine,int nfine,int shift,u_int n,
+                         double p)
+{
+  int    b;
+  double cum=0,target=p*n;
+
+  for (b=0; b<nfine; b++) {
+    if (fine[b] && (cum+fine[b] >= target)) break;
+    cum += fine[b];
+  }
+  if (b == nfine) return (double)(nfine << shift);
+  if (shift == 0) return b;            /* 8-bit: exact */
+  return (b+(target-cum)/fine[b])*(1 << shift);
+}
+
+/* ---------------------------------------------------------------- */
+/* region (x,y,w,h) of a frame 'stride' pixels wide; 'nhist': 0 or a */
+/* power of 2 up to FSTATS_HMAX; 'pct': percentile for 'pval' [%]    */
+
+void fstats_region(const u_char *data,int stride,int x0,int y0,int w,int h,
+                   int bits,int nhist,double pct,FrameStats *st)
+{
+  int    x,y,b,shift=(bits == 8) ? 0 : 16-FINE_BITS;
+  int    nfine=(bits == 8) ? 256 : 1<<FINE_BITS;
+  u_int  fine[1<<FINE_BITS],lo=~0u,hi=0;
+  unsigned long long sum=0;
+
+  memset(fine,0,nfine*sizeof(u_int));
+  for (y=y0; y<y0+h; y++) {
+    if (bits == 8) {
+      const u_char *d = data+(size_t)y*stride+x0;
+      row8(d,w,&lo,&hi,&sum);
+      for (x=0; x<w; x++) fine[d[x]]++;
+    } else {
+      const u_short *d = (const u_short*)data+(size_t)y*stride+x0;
+      row16(d,w,&lo,&hi,&sum);
+      for (x=0; x<w; x++) fine[d[x] >> shift]++;
+    }
+  }
+  st->n     = (u_int)w*h;
+  st->min   = lo;
+  st->max   = hi;
+  st->mean  = (st->n) ? (double)sum/st->n : 0;
+  st->nsat  = fine[nfine-1];           /* 8-bit: 255, 16-bit: >=65520 */
+  st->bg    = percentile(fine,nfine,shift,st->n,0.5);
+  st->noise = st->bg-percentile(fine,nfine,shift,st->n,0.1587);
+  st->pval  = (pct >= 100) ? hi : percentile(fine,nfine,shift,st->n,pct/100);
+  st->nhist = 0;
+  if ((nhist > 0) && (nhist <= FSTATS_HMAX) && !(nhist & (nhist-1))) {
+    memset(st->hist,0,nhist*sizeof(u_int));
+    for (b=0; b<nfine; b++) st->hist[b/(nfine/nhist)] += fine[b];
+    st->nhist = nhist;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void fstats_frame(const u_char *data,int w,int h,int bits,int nhist,
+                  FrameStats *st)
+{
+  fstats_region(data,w,0,0,w,h,bits,nhist,50.0,st);
+}
+
+/* ---------------------------------------------------------------- */
@@ -0,0 +1,43 @@
+/* ----------------------------------------------------------------
+ *
+ * fstats.h
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * per-frame statistics, computed once on the server ('stats')
+ *
+ * ---------------------------------------------------------------- */
+
+#ifndef INCLUDE_FSTATS_H
+#define INCLUDE_FSTATS_H
+
+#include <sys/types.h>
+
+/* DEFINEs -------------------------------------------------------- */
+
+#define FSTATS_HMAX     64             /* coarse histogram bins */
+
+/* TYPEDEFs ------------------------------------------------------- */
+
+typedef struct frame_stats_tag {
+  u_int   n;                           /* pixels, 0: not computed */
+  u_int   min,max;
+  double  mean;
+  double  bg,noise;                    /* median, median-16th percentile */
+  u_int   nsat;                        /* saturated pixels */
+  double  pval;                        /* at percentile 'pct' */
+  int     nhist;                       /* 0: no histogram */
+  u_int   hist[FSTATS_HMAX];           /* full range in 'nhist' bins */
+} FrameStats;
+
+/* function prototype(s) ------------------------------------------ */
+
+void    fstats_frame  (const u_char*,int,int,int,int,FrameStats*);
+void    fstats_region (const u_char*,int,int,int,int,int,int,int,double,
+                       FrameStats*);
+
+/* ---------------------------------------------------------------- */
+
+#endif /* INCLUDE_FSTATS_H */
+
+/* ---------------------------------------------------------------- */
@@ -0,0 +1,103 @@
+/* -----------------------------------------------------------------
+ *
+ * thumb.c
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * Quick-look thumbnails, made by the capture thread at a few Hz so a
+ * monitor pulls kilobytes instead of full frames: the frame is
+ * reduced by an integer factor 'f' (f x f box average, or every f-th
+ * pixel) and scaled to 8 bits (16-bit: the high byte). The box sums
+ * of one output row are accumulated row by row (sequential reads,
+ * vectorized at -O3, see makefile); the average is one multiply per
+ * output pixel. Partial boxes at the right/bottom edge are dropped.
+ *
+ * ---------------------------------------------------------------- */
+
+/* INCLUDEs ------------------------------------------------------- */
+
+#include <string.h>                    /* memset() */
+
+#include "thumb.h"
+
+/* ---------------------------------------------------------------- */
+/* factor for a 'w'x'h' frame to fit 'width' (both axes); returns    */
+/* the factor and the thumbnail size 'tw'x'th'                       */
+
+int thumb_factor(int w,int h,int width,int* tw,int* th)
+{
+  int f,m = (w > h) ? w : h;
+
+  if (width < THUMB_WMIN) width = THUMB_WMIN;
+  if (width > THUMB_WMAX) width = THUMB_WMAX;
+  f = (m+width-1)/width;
+  if (f < 1) f = 1;
+  *tw = w/f; *th = h/f;
+
+  return f;
+}
+
+/* ---------------------------------------------------------------- */
+
+static inline void sum8(const u_char *restrict d,int f,int tw,
+                        u_int *restrict acc)
+{
+  int i,k;
+
+  for (i=0; i<tw; i++) {
+    u_int s=0;
+    for (k=0; k<f; k++) s += d[k];
+    acc[i] += s;
+    d += f;
+  }
+}
+
+static inline void sum16(const u_short *restrict d,int f,int tw,
+                         u_int *restrict acc)
+{
+  int i,k;
+
+  for (i=0; i<tw; i++) {
+    u_int s=0;
+    for (k=0; k<f; k++) s += d[k];
+    acc[i] += s;
+    d += f;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+/* 'data' 'w'x'h' 'bits' -> 'out' (w/f)x(h/f) 8-bit                  */
+
+void thumb_make(const u_char* data,int w,int h,int bits,int f,int mode,
+                u_char* out)
+{
+  int    i,j,r,tw=w/f,th=h/f;
+  u_int  acc[THUMB_WMAX];
+  float  scale = 1.0f/(float)(f*f)/((bits == 16) ? 256.0f : 1.0f);
+
+  if (tw > THUMB_WMAX) return;         /* cf. thumb_factor() */
+
+  for (j=0; j<th; j++) {
+    if (mode == THUMB_STRIDE) {        /* centre pixel of each box */
+      size_t row = (size_t)(j*f+f/2)*w+f/2;
+      if (bits == 16) {
+        const u_short *d = (const u_short*)data+row;
+        for (i=0; i<tw; i++) out[i] = (u_char)(d[(size_t)i*f] >> 8);
+      } else {
+        const u_char *d = data+row;
+        for (i=0; i<tw; i++) out[i] = d[(size_t)i*f];
+      }
+    } else {
+      memset(acc,0,tw*sizeof(u_int));
+      for (r=0; r<f; r++) {
+        size_t row = (size_t)(j*f+r)*w;
+        if (bits == 16) sum16((const u_short*)data+row,f,tw,acc);
+        else            sum8(data+row,f,tw,acc);
+      }
+      for (i=0; i<tw; i++) out[i] = (u_char)((float)acc[i]*scale);
+    }
+    out += tw;
+  }
+}
+
+/* ---------------------------------------------------------------- */
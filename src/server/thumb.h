@@ -0,0 +1,32 @@
+/* ----------------------------------------------------------------
+ *
+ * thumb.h
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * 8-bit thumbnails of video frames ('preview')
+ *
+ * ---------------------------------------------------------------- */
+
+#ifndef INCLUDE_THUMB_H
+#define INCLUDE_THUMB_H
+
+#include <sys/types.h>
+
+/* DEFINEs -------------------------------------------------------- */
+
+#define THUMB_WMIN      64             /* keeps box sums in 32 bits */
+#define THUMB_WMAX      1024           /* max. width and height */
+
+enum thumb_modes_enum { THUMB_AVG, THUMB_STRIDE };
+
+/* function prototype(s) ------------------------------------------ */
+
+int     thumb_factor  (int,int,int,int*,int*);
+void    thumb_make    (const u_char*,int,int,int,int,int,u_char*);
+
+/* ---------------------------------------------------------------- */
+
+#endif /* INCLUDE_THUMB_H */
+
+/* ---------------------------------------------------------------- */
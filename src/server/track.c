@@ -0,0 +1,222 @@
+/* -----------------------------------------------------------------
+ *
+ * track.c
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * Star acquisition and centroids for the server-side 'track' mode:
+ * 'track_find' picks the brightest unsaturated star of a (binned)
+ * acquisition frame, 'track_centroid' measures it in the small track
+ * window. Raw 8/16-bit frames as read from the SDK, no copies.
+ *
+ * ---------------------------------------------------------------- */
+
+/* DEFINEs -------------------------------------------------------- */
+
+#ifndef DEBUG
+#define DEBUG           1
+#endif
+
+#define FIND_BOX        7              /* refine centroid [+/- pixel] */
+#define FIND_NMIN       3              /* pixels >3 sigma in 3x3 */
+
+/* INCLUDEs ------------------------------------------------------- */
+
+#include <stdio.h>
+#include <math.h>                      /* fmax() */
+
+#include "track.h"
+
+/* ---------------------------------------------------------------- */
+
+static inline u_int pixel(const u_char *data,int bits,size_t i)
+{
+  return (bits == 8) ? data[i] : ((const u_short*)data)[i];
+}
+
+/* ---------------------------------------------------------------- */
+/* k-th smallest of s[0..n-1] (Hoare's select, reorders 's')        */
+
+static u_int select_uint(u_int *s,int n,int k)
+{
+  int   i,j,l=0,r=n-1;
+  u_int p,t;
+
+  while (l < r) {
+    p = s[(l+r)/2];
+    for (i=l,j=r; i<=j; ) {
+      while (s[i] < p) i++;
+      while (s[j] > p) j--;
+      if (i <= j) { t = s[i]; s[i] = s[j]; s[j] = t; i++; j--; }
+    }
+    if (k <= j) r = j; else
+    if (k >= i) l = i; else break;
+  }
+  return s[k];
+}
+
+/* ---------------------------------------------------------------- */
+/* median and sigma (from the median absolute deviation) of 's'      */
+
+static void sample_stats(u_int *s,int n,double *bg,double *noise)
+{
+  int  i;
+  u_int m;
+
+  m = select_uint(s,n,n/2);
+  for (i=0; i<n; i++) s[i] = (s[i] > m) ? s[i]-m : m-s[i];
+  *bg = m;
+  *noise = fmax(1.4826*select_uint(s,n,n/2),1.0);
+}
+
+/* ---------------------------------------------------------------- */
+/* uphill from (x,y) to a local maximum, 'm' pixels off the edges    */
+
+static u_int climb(const u_char *data,int w,int h,int bits,int m,
+                   int *x,int *y)
+{
+  int   dx,dy,bx,by;
+  u_int v=pixel(data,bits,(size_t)*y*w+*x),u;
+
+  for (;;) {                           /* v grows: terminates */
+    for (bx=*x,by=*y,dy=-1; dy<=1; dy++) {
+      if ((*y+dy < m) || (*y+dy >= h-m)) continue;
+      for (dx=-1; dx<=1; dx++) {
+        if ((*x+dx < m) || (*x+dx >= w-m)) continue;
+        u = pixel(data,bits,(size_t)(*y+dy)*w+*x+dx);
+        if (u > v) { v = u; bx = *x+dx; by = *y+dy; }
+      }
+    }
+    if ((bx == *x) && (by == *y)) return v;
+    *x = bx; *y = by;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+/* saturation level of 'bits' data from an 'adc'-bit sensor (16-bit  */
+/* data are MSB aligned by the SDK)                                  */
+
+u_int track_sat(int bits,int adc)
+{
+  u_int full;
+
+  if (bits == 8) {
+    full = 255;
+  } else {
+    if ((adc < 8) || (adc > 16)) adc = 16;
+    full = ((1u << adc)-1) << (16-adc);
+  }
+  return (u_int)(TRACK_SAT*full);
+}
+
+/* ---------------------------------------------------------------- */
+/* brightest unsaturated star ('peak' < 'sat') at least 'margin'     */
+/* pixels from the edges; single hot pixels are rejected by asking   */
+/* for FIND_NMIN pixels above 3 sigma in the 3x3 around the peak;    */
+/* large frames are scanned on a grid of <= TRACK_NSCAN pixels and   */
+/* climb to the peak from there; returns 0 if found                  */
+
+int track_find(const u_char *data,int w,int h,int bits,int margin,u_int sat,
+               TrackStar *star)
+{
+  int    i,n,x,y,px,py,dx,dy,bx=0,by=0,step,d;
+  u_int  s[TRACK_NSAMPLE];
+  double bg,noise,thr,thr3,best=-1;
+
+  if (margin < 2) margin = 2;
+  if ((w <= 2*margin) || (h <= 2*margin)) return -1;
+
+  step = (int)(((size_t)w*h)/TRACK_NSAMPLE) | 1; /* odd: no column beat */
+  for (i=n=0; (n < TRACK_NSAMPLE) && ((size_t)i < (size_t)w*h); i+=step) {
+    s[n++] = pixel(data,bits,(size_t)i);
+  }
+  sample_stats(s,n,&bg,&noise);
+  thr  = bg+TRACK_SNR*noise;
+  thr3 = bg+3.0*noise;
+
+  for (d=1; (size_t)(w/d)*(h/d) > TRACK_NSCAN; d++) ;
+  for (y=margin; y<h-margin; y+=d) {
+    size_t row=(size_t)y*w;
+    for (x=margin; x<w-margin; x+=d) {
+      if (pixel(data,bits,row+x) <= ((d > 1) ? thr3 : thr)) continue;
+      px = x; py = y;                  /* almost all pixels skip this */
+      u_int  v=climb(data,w,h,bits,margin,&px,&py);
+      int    k=0;
+      double sum=0;
+      if ((v <= thr) || (v >= sat)) continue;
+      for (dy=-1; dy<=1; dy++) {
+        for (dx=-1; dx<=1; dx++) {
+          u_int u=pixel(data,bits,(size_t)(py+dy)*w+px+dx);
+          if (u > thr3) k++;
+          sum += u-bg;
+        }
+      }
+      if (k < FIND_NMIN) continue;
+      if (sum > best) { best = sum; bx = px; by = py; }
+    }
+  }
+#if (DEBUG > 1)
+  fprintf(stderr,"%s: bg=%.1f noise=%.1f best=%.0f at %d,%d\n",__func__,
+          bg,noise,best,bx,by);
+#endif
+  if (best < 0) return -1;
+
+  return track_centroid(data,w,h,bits,bx-FIND_BOX,by-FIND_BOX,
+                        2*FIND_BOX+1,2*FIND_BOX+1,star);
+}
+
+/* ---------------------------------------------------------------- */
+/* centroid in the box (x0,y0,bw,bh) of a w*h frame: background from */
+/* the box border, pixels above max(3 sigma,10% of the peak) weigh   */
+/* in; returns -1 if there is no star (peak < TRACK_SNR sigma)       */
+
+int track_centroid(const u_char *data,int w,int h,int bits,
+                   int x0,int y0,int bw,int bh,TrackStar *star)
+{
+  int    n,x,y,x1,y1,step;
+  u_int  s[TRACK_NSAMPLE],peak=0;
+  double bg,noise,t,sw=0,sx=0,sy=0,flux=0;
+
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  x1 = (x0+bw < w) ? x0+bw : w;
+  y1 = (y0+bh < h) ? y0+bh : h;
+  if ((x1-x0 < 3) || (y1-y0 < 3)) return -1;
+
+  step = 1+(2*(x1-x0)+2*(y1-y0))/(TRACK_NSAMPLE/2);
+  for (n=0,x=x0; x<x1; x+=step) {      /* border */
+    s[n++] = pixel(data,bits,(size_t)y0*w+x);
+    s[n++] = pixel(data,bits,(size_t)(y1-1)*w+x);
+  }
+  for (y=y0+1; y<y1-1; y+=step) {
+    s[n++] = pixel(data,bits,(size_t)y*w+x0);
+    s[n++] = pixel(data,bits,(size_t)y*w+x1-1);
+  }
+  sample_stats(s,n,&bg,&noise);
+
+  for (y=y0; y<y1; y++) {
+    for (x=x0; x<x1; x++) { u_int v=pixel(data,bits,(size_t)y*w+x);
+      if (v > peak) peak = v;
+    }
+  }
+  if (peak-bg < TRACK_SNR*noise) return -1;
+
+  t = bg+fmax(3.0*noise,0.1*(peak-bg));
+  for (y=y0; y<y1; y++) {
+    for (x=x0; x<x1; x++) { double v=pixel(data,bits,(size_t)y*w+x);
+      if (v <= t) continue;
+      sw += v-t; sx += (v-t)*x; sy += (v-t)*y;
+      flux += v-bg;
+    }
+  }
+  star->x = sx/sw;
+  star->y = sy/sw;
+  star->peak = peak;
+  star->bg = bg;
+  star->noise = noise;
+  star->flux = flux;
+
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
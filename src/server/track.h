@@ -0,0 +1,42 @@
+/* ----------------------------------------------------------------
+ *
+ * track.h
+ *
+ * Project: ZWO Camera software (OCIW, Pasadena, CA)
+ *
+ * star acquisition and centroids on raw frames (server-side 'track')
+ *
+ * ---------------------------------------------------------------- */
+
+#ifndef INCLUDE_TRACK_H
+#define INCLUDE_TRACK_H
+
+#include <sys/types.h>
+
+/* DEFINEs -------------------------------------------------------- */
+
+#define TRACK_SNR       5.0            /* detection [sigma] */
+#define TRACK_NSAMPLE   4096           /* background sample */
+#define TRACK_NSCAN     (1<<18)        /* acquisition scan [pixel] */
+#define TRACK_SAT       0.98           /* saturated [full scale] */
+
+/* TYPEDEFs ------------------------------------------------------- */
+
+typedef struct track_star_tag {
+  double x,y;                          /* centroid [pixel], frame coords */
+  double peak;                         /* max. pixel value */
+  double bg,noise;                     /* background, sigma [ADU] */
+  double flux;                         /* above background [ADU] */
+} TrackStar;
+
+/* function prototype(s) ------------------------------------------ */
+
+u_int   track_sat     (int,int);
+int     track_find    (const u_char*,int,int,int,int,u_int,TrackStar*);
+int     track_centroid(const u_char*,int,int,int,int,int,int,int,TrackStar*);
+
+/* ---------------------------------------------------------------- */
+
+#endif /* INCLUDE_TRACK_H */
+
+/* ---------------------------------------------------------------- */
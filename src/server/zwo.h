@@ -5,7 +5,7 @@
  * ---------------------------------------------------------------- */
 
 #define PROJECT_ID      23
-#define P_VERSION       "1.0.6"       /* ASI SDK 1.41 */
+#define P_VERSION       "1.0.22"      /* ASI SDK 1.41, control connection */
 
 extern void message(const void*,const char*,int);
 
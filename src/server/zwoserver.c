@@ -16,6 +16,19 @@
  * v0.026  2021-03-23  append _temp,_heater values to video
  * v0.029  2021-10-20  support ASI294-MM
  * v0.031  2022-08-24  serial number
+ * v1.0.10 2026-10-19  SCHED_FIFO, CPU pinning, mlockall (-r,-c,-n,-l)
+ * v1.0.11 2026-10-19  frame pool (-m budget)
+ * v1.0.12 2026-10-19  'move', 'setup' while streaming
+ * v1.0.13 2026-10-19  'track' (acquire, then track in a small window)
+ * v1.0.14 2026-10-19  'box', 'cut' (sub-windows of one video frame)
+ * v1.0.15 2026-10-19  multi-camera: per-camera state, 'camera #|serial'
+ * v1.0.16 2026-10-19  'calib' (bias/dark/flat, bad pixels in run_video)
+ * v1.0.17 2026-10-19  'stats' (per-frame statistics with 'next')
+ * v1.0.18 2026-10-19  'auto' (exposure/gain control in run_video)
+ * v1.0.19 2026-10-19  'tune fps=N box=W' (readout model, window for a rate)
+ * v1.0.20 2026-10-19  'preview', 'thumb' (8-bit thumbnails at a few Hz)
+ * v1.0.21 2026-10-19  'record', 'dump' (flight recorder, 'track' triggers)
+ * v1.0.22 2026-10-19  'control' connections beside the data connection
  *
  * NOTE: systemctl stop firewalld
  *       systemctl disable firewalld
@@ -33,10 +46,12 @@
 /* ------------------------------------------------------- */
 
 #define _REENTRANT
+#define _GNU_SOURCE                    /* pthread_setaffinity_np() */
 
 #include <stdlib.h>                    /* atoi(),exit() */
 #include <stdio.h>                     /* sprintf() */
 #include <string.h>                    /* strcpy(),memset(),memcpy() */
+#include <math.h>                      /* fmin() */
 #include <assert.h>
 
 #include <sys/reboot.h>                /* requires server */
@@ -44,6 +59,13 @@
 #include <netinet/in.h>                /* IPPROTO_TCP */
 #include <netinet/tcp.h>               /* TCP_NODELAY */
 #include <time.h>                      /* clock_gettime() */
+#include <pthread.h>
+#include <sched.h>                     /* SCHED_FIFO,CPU_SET() */
+#include <errno.h>
+#include <sys/mman.h>                  /* mlockall() */
+#include <unistd.h>                    /* sysconf() */
+#include <ifaddrs.h>                   /* getifaddrs() */
+#include <net/if.h>                    /* IFF_LOOPBACK */
 
 #if (TIME_TEST > 0)
 #include <limits.h>
@@ -59,6 +81,12 @@
 #include "EFW_filter.h" 
 #include "ASICamera2.h"
 #include "fits.h"
+#include "fpool.h"                     /* frame buffer pool */
+#include "track.h"                     /* star acquisition, centroids */
+#include "calib.h"                     /* bias/dark/flat, bad pixels */
+#include "fstats.h"                    /* per-frame statistics */
+#include "thumb.h"                     /* preview thumbnails */
+#include "frec.h"                      /* flight recorder */
 
 /* DEFINEs -------------------------------------------------------- */
 
@@ -78,37 +106,122 @@
 
 static char       logfile[512],rcfile[512];
 static int        offtime=0;
-static int        tcpDebug=0;
 static u_int      cookie=0;
 static char       dataPath[512];
 static int        runNumber=0;
 
 static time_t     startup_time;
-static int        zwo_id=0; // todo used? -- fixed at '0' ?
-
-static const int asi_id=0;
-static ASI_EXPOSURE_STATUS asi_exp_status=0;
-static u_char *asi_data=NULL;
-static u_char *video_data1=NULL,*video_data2=NULL; // v0024
-static u_int video_seq=0,video_last=0;
-static volatile int video_running=0;   /* run_video thread alive */
-/* per-frame receive timestamp [ns], [0]=video_data1 [1]=video_data2.
+static int        zwo_id=0;            /* -i: port, log and rc file */
+
+/* per-frame receive timestamp [ns], same index as the pool slot.
  * CLOCK_REALTIME so two NTP/PTP-synced hosts can be cross-correlated
  * on absolute time; switch to CLOCK_TAI on PTP deployments to be
  * immune to leap-second steps. */
 #define TS_CLOCK CLOCK_REALTIME
-static unsigned long long video_ts[2];
+/* readout geometry, per pool slot: 'move' and 'setup' while streaming
+ * are applied by run_video between frames ('geo_next'); zwo_x.. follow
+ * only once the SDK took them */
+typedef struct {
+  int x,y,w,h,bin,bits,type;
+} Geometry;
+/* binary part of an answer ('data','next','cut','thumb'): one per
+ * connection, so two clients on a camera never share it */
+typedef struct {
+  u_char *data;
+  size_t size,cap;
+} TxBuf;
+/* 'track': run_video finds the brightest unsaturated star on a binned
+ * full frame, switches to a small window around it and re-centres the
+ * window ('move') as the star drifts; the centroid goes with 'next' */
+enum track_states_enum { TRK_OFF, TRK_ACQUIRE, TRK_TRACK };
+#define TRACK_BOX       64             /* default window [binned pixel] */
+#define TRACK_RECENTRE  8              /* move if off-centre by box/8 */
+#define TRACK_LOST      20             /* frames without star: re-acquire */
+typedef struct {
+  int    on,st;                        /* st: 1=star, 0=acquiring, -1=lost */
+  double x,y,dx,dy;                    /* star, offset from lock [bin px] */
+  double flux;                         /* [ADU] */
+} TrackTag;
+/* 'auto': run_video steers exposure (then gain, between the limits)
+ * so that the peak or a percentile of a region sits at 'target' of
+ * full scale; no step inside +/-AUTO_BAND (hysteresis), at most
+ * AUTO_STEP per step, AUTO_SETTLE frames between steps (in flight) */
+#define AUTO_BAND       0.2
+#define AUTO_STEP       4.0
+#define AUTO_SETTLE     3              /* [frames] */
+typedef struct {
+  int    on;
+  double target,pct;                   /* [full scale], [%] (100=peak) */
+  int    x,y,w,h;                      /* region [binned px], w=0: window */
+  double emin,emax;                    /* [s] */
+  int    gmin,gmax;                    /* -1: gain at 'auto on' */
+  int    settle,steps;
+  double level;                        /* last measured [full scale] */
+} AutoExp;
+/* 'box': sub-windows [binned sensor pixels] that 'cut' extracts from
+ * one video frame and sends together (multi-star guiding) */
+#define BOX_NMAX        16
+typedef struct {
+  int x,y,w,h;
+} Box;
+/* 'preview': run_video makes an 8-bit thumbnail (box average or
+ * stride) of at most 'width' pixels at <='rate' Hz, double-buffered
+ * (the other buffer is rewritten >=1/PREVIEW_RMAX later), for 'thumb' */
+#define PREVIEW_WIDTH   512
+#define PREVIEW_RATE    2.0            /* [Hz] */
+#define PREVIEW_RMAX    10.0
+typedef struct {
+  u_int    seq;                        /* video frame */
+  unsigned long long ts;
+  Geometry g;
+  int      f,tw,th;
+} Thumb;
+/* 'record': run_record copies every frame from its pool slot into the
+ * flight recorder, behind run_video (a full 1936x1216x16 frame costs
+ * ~0.65 ms at ~7 GB/s: too much for the capture thread); a frame whose
+ * slot is reused before it is copied is not recorded ('ndrop').
+ * 'dump' or a 'track' event (star lost, centroid jump, flux drop below
+ * a fraction of its running mean) writes the last seconds to disk */
+#define REC_SECONDS     10.0
+#define REC_BUDGET      256            /* [MB] */
+#define REC_FLUX_N      16             /* [frames] running mean */
+/* ASIGetVideoData call trace ('vtrace'): where does the frame period go? */
+typedef struct {
+  unsigned long long t_entry,t_return; /* [ns] TS_CLOCK */
+  unsigned long long t_start;          /* exposure start estimate [ns] */
+  int wait,ret;                        /* timeout [ms], ASI_ERROR_CODE */
+} VideoCall;
+#define VTRACE_N        4096
+/* long exposures: 'slice' re-issues ASIGetVideoData with a short wait
+ * (no 5ms loop sleep) so a lost SDK wakeup costs <=VIDEO_SLICE_MS
+ * instead of a whole 50+exptime timeout, i.e. a full frame period */
+/* 'adapt' (default) waits for the expected arrival of the next frame,
+ * from a running model of the frame period, plus a short margin: a
+ * lost wakeup (stall) then costs about one frame period; no frame for
+ * several periods re-arms the capture (stop/start) */
+enum video_modes_enum { VM_FREE, VM_SLICE, VM_ADAPT };
+#define VIDEO_SLICE_EXP 0.1            /* [s] slice above this exptime */
+#define VIDEO_SLICE_MS  100
+#define STALL_MARGIN    0.5            /* [periods] */
+#define STALL_MARGIN_MAX 0.1           /* [s] */
+#define STALL_REARM     4              /* [periods] + 0.2s no frame */
+#define DROP_POLL       0.25           /* [s] ASIGetDroppedFrames, stalled */
+/* real-time options: run_video at SCHED_FIFO 'rt_prio' (0=CFS) pinned
+ * to 'rt_cpu' (per camera, defaults -r/-c), the connection thread to
+ * 'net_cpu' (-1=any); 'rt_lock' mlockall()s (the frame pool is
+ * pre-faulted at 'setup' anyway) */
+static int  opt_prio=0,opt_cpu=-1,net_cpu=-1,rt_lock=0;
+/* 'burst': exposures queued on the server while the client downloads */
+#define BURST_NBUFS     4              /* max. queue depth */
 /* safety margin on buffers passed to the SDK: ASIGetVideoData was
  * observed to write past w*h*bytes at 16-bit large ROIs (ASI294MM Pro,
  * SDK 1.20.2) corrupting the heap -> SEGV in a later realloc */
 #define SDK_BUF_PAD (1L<<20)
-static size_t asi_size=0;
-static double asi_startTime,asi_expTime;
-static int   asi_gain=0,asi_offset=10;
-static int   asi_usb=40;               /* ASI_BANDWIDTHOVERLOAD, SDK default */
-static int   asi_highspeed=0;          /* ASI_HIGH_SPEED_MODE (10-bit ADC) */
-static int   asi_cooler;
-static float asi_temperature,asi_target,asi_cooler_power;
+/* all frame buffers, sized for the current ROI at 'setup' (-m MB) */
+#define FPOOL_BUDGET    288            /* [MB] 3 full frames (16 bit) */
+static size_t pool_budget=(size_t)FPOOL_BUDGET<<20; /* per camera */
+static __thread TxBuf *conn_tx=NULL;   /* run_connection's, else own */
+static __thread TxBuf  thread_tx;
 
 static const int efw_id=0;
 
@@ -122,26 +235,112 @@ enum server_errors_enum { E_first=19,
                           E_no_data,
 			  E_not_video,
                           E_unknown,   /* 25 */
+                          E_no_memory,
                           E_last };
 
 enum server_states_enum  { ZWO_CLOSED,
                            ZWO_IDLE,
                            ZWO_EXPOSING,
                            ZWO_VIDEO,
+                           ZWO_BURST,
                            ZWO_LAST };
 
-static int  zwo_state=ZWO_CLOSED;
-static int  zwo_x=0,zwo_y=0,zwo_w=0,zwo_h=0,zwo_bin=0,zwo_bits=0;
-static int  zwo_width=0,zwo_height=0;
-static int  zwo_cooler=0,zwo_color=0;
-static int  zwo_bitDepth=12;           /* v0022 */
-static char zwo_model[32]="ZWO";       /* v0021 */
-static char zwo_IDstr[16]="";          /* v0027 NEW v0031 */
+/* per-camera state: one process serves all cameras on the USB bus,
+ * each with its own capture thread and frame pool; a connection picks
+ * its camera with 'camera #|serial' (default 0) */
+#define CAM_NMAX        4
+
+typedef struct camera_tag {
+  int      index;                      /* ASIGetCameraProperty() index */
+  int      asi_id;                     /* ASI camera ID */
+  char     serial[20];                 /* ASIGetSerialNumber */
+  int      zwo_state;
+  int      zwo_x,zwo_y,zwo_w,zwo_h,zwo_bin,zwo_bits;
+  int      zwo_width,zwo_height;
+  int      zwo_cooler,zwo_color;
+  int      zwo_bitDepth;               /* v0022 */
+  char     zwo_model[32];              /* v0021 */
+  char     zwo_IDstr[16];              /* v0027 NEW v0031 */
+  ASI_EXPOSURE_STATUS asi_exp_status;
+  double   asi_startTime,asi_expTime;
+  int      asi_gain,asi_offset;
+  int      asi_usb;                    /* ASI_BANDWIDTHOVERLOAD */
+  int      asi_highspeed;              /* ASI_HIGH_SPEED_MODE (10-bit ADC) */
+  int      asi_cooler;
+  float    asi_temperature,asi_target,asi_cooler_power;
+  FramePool fpool;                     /* all frame buffers */
+  int      nconn;                      /* data connections on it */
+  pthread_mutex_t conn_lock;           /* held by the data connection */
+  u_int    video_seq,video_last;       /* frame 'seq' is in slot seq%n */
+  volatile int video_running;          /* run_video thread alive */
+  volatile int rec_running;            /* run_record thread alive */
+  unsigned long long video_ts[FPOOL_NMAX];
+  Geometry video_geom[FPOOL_NMAX],geo_next;
+  volatile int geo_pending;
+  pthread_mutex_t geo_lock;
+  volatile int track_state;
+  int      track_box,track_lost;
+  Geometry track_acq;                  /* acquisition window */
+  double   track_x0,track_y0;          /* star position at lock */
+  TrackTag video_track[FPOOL_NMAX],track_now;
+  Box      box[BOX_NMAX];
+  int      box_n;
+  VideoCall vtrace[VTRACE_N];
+  u_int    vtrace_n;
+  int      video_dropped;              /* ASIGetDroppedFrames */
+  int      video_mode;
+  int      video_stalls,video_rearms,video_rfails;
+  int      rt_prio,rt_cpu;
+  char     rt_status[32];              /* achieved by run_video */
+  unsigned long long burst_ts[FPOOL_NMAX],burst_t0[FPOOL_NMAX];
+  u_int    burst_n,burst_seq,burst_last,burst_depth;
+  volatile int burst_running;          /* run_burst thread alive */
+  Calib    calib;                      /* applied before 'next'/'data' */
+  int      stats_on,stats_nhist;       /* 'stats': appended to 'next' */
+  FrameStats video_stats[FPOOL_NMAX],burst_stats[FPOOL_NMAX];
+  AutoExp  aexp;                       /* 'auto' exposure/gain */
+  int      pv_on,pv_width,pv_mode;     /* 'preview' */
+  double   pv_rate;
+  u_char   *pv_buf;                    /* 2 thumbnails */
+  Thumb    pv_tag[2];
+  u_int    pv_seq,pv_last;             /* thumbnail 'seq' in buffer seq&1 */
+  unsigned long long pv_t;             /* last thumbnail [ns] */
+  FlightRec rec;                       /* 'record', 'dump' */
+  int      rec_on;
+  double   rec_jump,rec_drop;          /* triggers [bin px], [mean flux] */
+  double   rec_flux;                   /* running mean */
+  TrackTag rec_prev;                   /* of the previous frame */
+} Camera;
+
+static Camera cams[CAM_NMAX];
 
 /* function prototype(s) ------------------------------------------ */
 
+static void    rt_thread         (int,int,char*);
+static void    cam_init          (Camera*,int);
+static int     select_camera     (Camera**,const char*,char*);
+static int     tune_camera       (Camera*,const char*,char*,double);
+static double  link_rate         (int);
+static const char* cam_key       (const Camera*,const char*,char*);
+static int     img_type          (Camera*,int);
+static int     geo_check         (Camera*,int,int,int,int,int,int,
+                                   Geometry*);
+static int     geo_request       (Camera*,int,int,int,int,int,int);
+static void    track_frame       (Camera*,const u_char*,const Geometry*);
+static void    auto_frame        (Camera*,const u_char*,const Geometry*);
+static void    preview_frame     (Camera*,const u_char*,const Geometry*,
+                                  unsigned long long);
+static void    record_frame      (Camera*,u_int);
+static int     record_dump       (Camera*,const char*);
+static int     video_wait        (Camera*,double);
+static int     pool_setup        (Camera*,int);
+static int     calib_setup       (Camera*,int);
+static void    stats_answer      (const Camera*,const FrameStats*,char*);
+static u_char* frame_tx          (TxBuf*,size_t);
 static void*   run_tcpip         (void*);
 static void*   run_video         (void*);
+static void*   run_record        (void*);
+static void*   run_burst         (void*);
 
 /* --- M A I N ---------------------------------------------------- */
 
@@ -163,10 +362,24 @@ int main(int argc,char **argv)
 
   { extern char *optarg;               /* parse command line */  
     extern int opterr,optopt; opterr=0;
-    while ((i=getopt(argc,argv,"di:kw:")) != EOF) {
+    while ((i=getopt(argc,argv,"c:di:klm:n:r:w:")) != EOF) {
       switch (i) {
-      case 'd':                        /* debug: allow mult. connections */
-        tcpDebug = 1;
+      case 'c':                        /* CPU for run_video (+camera#) */
+        opt_cpu = atoi(optarg);
+        break;
+      case 'd':                        /* obsolete: every connection */
+        break;                         /* has its own thread anyway */
+      case 'l':                        /* lock memory */
+        rt_lock = 1;
+        break;
+      case 'm':                        /* frame pool budget [MB] */
+        pool_budget = (size_t)atol(optarg)<<20;
+        break;
+      case 'n':                        /* CPU for the network thread */
+        net_cpu = atoi(optarg);
+        break;
+      case 'r':                        /* SCHED_FIFO priority of run_video */
+        opt_prio = atoi(optarg);
         break;
       case 'i':                        /* driver 'ID' {0,1,2} */
         zwo_id = atoi(optarg);
@@ -206,6 +419,14 @@ int main(int argc,char **argv)
 
   runNumber = get_long(rcfile,KEY_RUN,1);
   strcpy(dataPath,getenv("HOME"));
+  for (i=0; i<CAM_NMAX; i++) cam_init(&cams[i],i);
+
+  if (rt_lock) {                       /* no page faults while streaming */
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+      sprintf(buffer,"mlockall() failed: %s",strerror(errno));
+      message(NULL,buffer,MSS_FLUSH);
+    }
+  }
 
   /* -------------------------------------------------------------- */
 
@@ -316,9 +537,10 @@ static int handle_efw(const char* command,char* answer,int buflen)
 
 /* ---------------------------------------------------------------- */
 
-static int handle_asi(const char* command,char* answer,int buflen)
+static int handle_asi(Camera* cam,const char* command,char* answer,int buflen)
 {
   int  err=0;
+  TxBuf *tx=(conn_tx) ? conn_tx : &thread_tx;
   char cmd[128]="",par1[128]="",par2[128]="",par3[128]="",par4[128]="";
  
   assert(strlen(command) < sizeof(cmd));
@@ -330,37 +552,41 @@ static int handle_asi(const char* command,char* answer,int buflen)
     int ret = ASIGetNumOfConnectedCameras();
     sprintf(answer,"%d",ret);
   } else 
-  if (!strcmp(cmd,"ASIOpenCamera")) {
-    err = ASIOpenCamera(asi_id);
+  if (!strcmp(cmd,"ASIOpenCamera")) { ASI_CAMERA_INFO info;
+    if (ASIGetCameraProperty(&info,cam->index) == ASI_SUCCESS) {
+      cam->asi_id = info.CameraID;     /* index -> ID */
+    }
+    err = ASIOpenCamera(cam->asi_id);
     sprintf(answer,"%d",err);
   } else
   if (!strcmp(cmd,"ASIInitCamera")) {
-    err = ASIInitCamera(asi_id);
+    err = ASIInitCamera(cam->asi_id);
     sprintf(answer,"%d",err);
   } else
   if (!strcmp(cmd,"ASIGetCameraProperty")) { ASI_CAMERA_INFO info;
-    ASIGetCameraProperty(&info,asi_id);
+    ASIGetCameraProperty(&info,cam->index);
     sprintf(answer,"%ld %ld %d %d %d %s",info.MaxWidth,info.MaxHeight,
       info.IsCoolerCam,info.IsColorCam,info.BitDepth,info.Name);  /* v0022 */
-    zwo_width = info.MaxWidth;
-    zwo_height = info.MaxHeight;
-    zwo_cooler = info.IsCoolerCam;
-    zwo_color = info.IsColorCam;
-    zwo_bitDepth = info.BitDepth;      /* v0022 */
-    strcpy(zwo_model,info.Name);       /* v0017 */
-    char *p = strchr(zwo_model,'(');   /* cut at '(' v0027 */
+    cam->zwo_width = info.MaxWidth;
+    cam->zwo_height = info.MaxHeight;
+    cam->zwo_cooler = info.IsCoolerCam;
+    cam->zwo_color = info.IsColorCam;
+    cam->zwo_bitDepth = info.BitDepth;      /* v0022 */
+    strcpy(cam->zwo_model,info.Name);       /* v0017 */
+    char *p = strchr(cam->zwo_model,'(');   /* cut at '(' v0027 */
     if (p) {
-      *p = '\0'; strcpy(zwo_IDstr,p+1); 
-      p = strchr(zwo_IDstr,')'); if (p) *p = '\0'; /* remove ')' */
+      *p = '\0'; strcpy(cam->zwo_IDstr,p+1); 
+      p = strchr(cam->zwo_IDstr,')'); if (p) *p = '\0'; /* remove ')' */
     }
-    do { p=strchr(zwo_model,' '); if (p) *p='_'; } while (p); /* v0021 */
-    sprintf(answer,"%d %d %d %d %d %s",zwo_width,zwo_height,  /* v0022 */
-      zwo_cooler,zwo_color,zwo_bitDepth,zwo_model);           /* v0027 */
+    do { p=strchr(cam->zwo_model,' '); if (p) *p='_'; } while (p); /* v0021 */
+    sprintf(answer,"%d %d %d %d %d %s",cam->zwo_width,cam->zwo_height,
+      cam->zwo_cooler,cam->zwo_color,cam->zwo_bitDepth,  /* v0022 */
+      cam->zwo_model);                                   /* v0027 */
 #if 1 /* NEW v0033 */
     { ASI_CONTROL_CAPS caps; int num=0,i;
-      ASIGetNumOfControls(asi_id,&num);
+      ASIGetNumOfControls(cam->asi_id,&num);
       for (i=0; i<num; i++) {
-        ASIGetControlCaps(asi_id,i,&caps);
+        ASIGetControlCaps(cam->asi_id,i,&caps);
         printf("%24s %5ld %11ld %6ld %d %d %s\n",caps.Name,
           caps.MinValue,caps.MaxValue,caps.DefaultValue,
           caps.IsAutoSupported,caps.IsWritable,caps.Description);
@@ -369,116 +595,120 @@ static int handle_asi(const char* command,char* answer,int buflen)
 #endif
   } else
   if (!strcmp(cmd,"ASIGetSerialNumber")) { ASI_SN sn; int i;
-    ASIGetSerialNumber(asi_id,&sn);    /* v0030 */
+    ASIGetSerialNumber(cam->asi_id,&sn);    /* v0030 */
     *answer = '\0';
     for (i=0; i<8; i++) { 
       sprintf(par4,"%02x",sn.id[i]); strcat(answer,par4);
     }
+    strcpy(cam->serial,answer);
   } else 
   if (!strcmp(cmd,"ASICloseCamera")) {
-    err = ASICloseCamera(asi_id);
+    err = ASICloseCamera(cam->asi_id);
     sprintf(answer,"%d",err);
   } else
   if (!strcmp(cmd,"ASISetControlValue")) {
     int control = atoi(par1);
     int value = atoi(par2);
-    err = ASISetControlValue(asi_id,control,value,ASI_FALSE);
+    err = ASISetControlValue(cam->asi_id,control,value,ASI_FALSE);
     sprintf(answer,"%d",err);
     if (!err) { 
       switch (control) { 
-        case ASI_EXPOSURE: asi_expTime = (double)value/1.0e6; break;
-        case ASI_COOLER_ON: asi_cooler = value; break;
-        case ASI_TARGET_TEMP: asi_target = (float)value; break;
+        case ASI_EXPOSURE: cam->asi_expTime = (double)value/1.0e6; break;
+        case ASI_COOLER_ON: cam->asi_cooler = value; break;
+        case ASI_TARGET_TEMP: cam->asi_target = (float)value; break;
       }
     }
   } else
   if (!strcmp(cmd,"ASIGetControlValue")) { long v; ASI_BOOL b;
     int control = atoi(par1);
-    err = ASIGetControlValue(asi_id,control,&v,&b);
+    err = ASIGetControlValue(cam->asi_id,control,&v,&b);
     sprintf(answer,"%d %ld",err,v);
     if (!err) { 
       switch (control) { 
-        case ASI_EXPOSURE: asi_expTime = (double)v/1.0e6; break;
-        case ASI_TEMPERATURE: asi_temperature = (float)v/10.0f; break;
-        case ASI_COOLER_POWER_PERC: asi_cooler_power = (float)v; break;
+        case ASI_EXPOSURE: cam->asi_expTime = (double)v/1.0e6; break;
+        case ASI_TEMPERATURE: cam->asi_temperature = (float)v/10.0f; break;
+        case ASI_COOLER_POWER_PERC: cam->asi_cooler_power = (float)v; break;
       }
     }
   } else 
   if (!strcmp(cmd,"ASISetROIFormat")) {
-    err = ASISetROIFormat(asi_id,atoi(par1),atoi(par2),atoi(par3),atoi(par4));
+    err = ASISetROIFormat(cam->asi_id,atoi(par1),atoi(par2),atoi(par3),
+                          atoi(par4));
     sprintf(answer,"%d",err);
     if (!err) {
-      if (zwo_bitDepth == 16) {        /* v0023 */
-        (void)ASIStartExposure(asi_id,ASI_FALSE);
-        (void)ASIStopExposure(asi_id);
+      if (cam->zwo_bitDepth == 16) {        /* v0023 */
+        (void)ASIStartExposure(cam->asi_id,ASI_FALSE);
+        (void)ASIStopExposure(cam->asi_id);
       }
     }
   } else 
   if (!strcmp(cmd,"ASIGetROIFormat")) { int w,h,b,t;
-    err = ASIGetROIFormat(asi_id,&w,&h,&b,&t);
+    err = ASIGetROIFormat(cam->asi_id,&w,&h,&b,&t);
     sprintf(answer,"%d %d %d %d %d",err,w,h,b,t);
     if (!err) {
-      zwo_w = w; zwo_h = h; zwo_bin = b; zwo_bits = (t==0) ? 8 : 16;
+      cam->zwo_w = w; cam->zwo_h = h; cam->zwo_bin = b;
+      cam->zwo_bits = (t==0) ? 8 : 16;
     }
   } else 
   if (!strcmp(cmd,"ASISetStartPos")) {
-    err = ASISetStartPos(asi_id,atoi(par1),atoi(par2));
+    err = ASISetStartPos(cam->asi_id,atoi(par1),atoi(par2));
     sprintf(answer,"%d",err);
   } else 
   if (!strcmp(cmd,"ASIGetStartPos")) { int x,y;
-    err = ASIGetStartPos(asi_id,&x,&y);
+    err = ASIGetStartPos(cam->asi_id,&x,&y);
     sprintf(answer,"%d %d %d",err,x,y);
     if (!err) { 
-      zwo_x = x; zwo_y = y;
+      cam->zwo_x = x; cam->zwo_y = y;
     }
   } else
   if (!strcmp(cmd,"ASIStartExposure")) {
-    err = ASIStartExposure(asi_id,ASI_FALSE);
-    asi_startTime = walltime(0);
+    err = ASIStartExposure(cam->asi_id,ASI_FALSE);
+    cam->asi_startTime = walltime(0);
     sprintf(answer,"%d",err);
-    if (!err) zwo_state = ZWO_EXPOSING;
+    if (!err) cam->zwo_state = ZWO_EXPOSING;
   } else
   if (!strcmp(cmd,"ASIStopExposure")) {
-    err = ASIStopExposure(asi_id);
+    err = ASIStopExposure(cam->asi_id);
     sprintf(answer,"%d",err);
-    if (!err) zwo_state = ZWO_IDLE;
+    if (!err) cam->zwo_state = ZWO_IDLE;
   } else
   if (!strcmp(cmd,"ASIGetExpStatus")) {
-    err = ASIGetExpStatus(asi_id,&asi_exp_status);
-    sprintf(answer,"%d %d",err,asi_exp_status);
+    err = ASIGetExpStatus(cam->asi_id,&cam->asi_exp_status);
+    sprintf(answer,"%d %d",err,cam->asi_exp_status);
   } else
   if (!strcmp(cmd,"ASIGetDataAfterExp")) {
-    asi_size = atoi(par1);
-    asi_data = (u_char*)realloc(asi_data,asi_size+SDK_BUF_PAD);
-    int ret = ASIGetDataAfterExp(asi_id,asi_data,asi_size);
+    tx->size = atoi(par1);
+    tx->data = frame_tx(tx,tx->size);
+    int ret = ASIGetDataAfterExp(cam->asi_id,tx->data,tx->size);
     // double t2 = walltime(0);
     // double dt = t2 - asi_startTime - asi_expTime;
     // printf("%.1f MB/s %.3f\n",((float)asi_size/1.0e6)/dt,dt);
-    if (ret != ASI_SUCCESS) { asi_size = 0; err = -1; } // todo
+    if (ret != ASI_SUCCESS) { tx->size = 0; err = -1; } // todo
     sprintf(answer,"%d",ret);
   } else 
   if (!strcmp(cmd,"ASIStartVideoCapture")) { // IDEA video thread
-    err = ASIStartVideoCapture(asi_id);      // requires Mutex
+    err = ASIStartVideoCapture(cam->asi_id);      // requires Mutex
     if (!err) msleep(350);
     sprintf(answer,"%d",err);
   } else
   if (!strcmp(cmd,"ASIGetVideoData")) {
-    asi_size = atoi(par1);
-    asi_data = (u_char*)realloc(asi_data,asi_size+SDK_BUF_PAD);
+    tx->size = atoi(par1);
+    tx->data = frame_tx(tx,tx->size);
     int wait_ms = atoi(par2);
     double t1 = walltime(0);
-    int ret = ASIGetVideoData(asi_id,asi_data,asi_size,wait_ms);
+    int ret = ASIGetVideoData(cam->asi_id,tx->data,tx->size,wait_ms);
     double t2 = walltime(0);
-    printf("%.1f MB/s (%.3f)\n",((float)asi_size/1.0e6)/(t2-t1),t2-t1); //xxx
-    if (ret != ASI_SUCCESS) { asi_size = 0; err = -1; } // todo
+    printf("%.1f MB/s (%.3f)\n",
+           ((float)tx->size/1.0e6)/(t2-t1),t2-t1); //xxx
+    if (ret != ASI_SUCCESS) { tx->size = 0; err = -1; } // todo
     sprintf(answer,"%d",ret);
   } else
   if (!strcmp(cmd,"ASIGetDroppedFrames")) { int dropped;
-    err = ASIGetDroppedFrames(asi_id,&dropped);
+    err = ASIGetDroppedFrames(cam->asi_id,&dropped);
     sprintf(answer,"%d %d",err,dropped);  
   } else 
   if (!strcmp(cmd,"ASIStopVideoCapture")) {
-    err = ASIStopVideoCapture(asi_id);
+    err = ASIStopVideoCapture(cam->asi_id);
     sprintf(answer,"%d",err);
   } else {
     err = E_unknown;
@@ -488,12 +718,14 @@ static int handle_asi(const char* command,char* answer,int buflen)
 
 /* ---------------------------------------------------------------- */
 
-static int handle_command(const char* command,char* answer,size_t buflen)
+static int handle_command(Camera* cam,const char* command,char* answer,
+                          size_t buflen)
 {
   int  r=0,n=0;
   long err=0;
   char cmd[512]="",par1[128]="",par2[128]="",par3[128]="",par4[128]="";
   char buf[128]="",par5[128]="",par6[128]="";
+  TxBuf *tx=(conn_tx) ? conn_tx : &thread_tx;
 #if (DEBUG > 1)
   sprintf(cmd,"%s: %s",PREFUN,command);
   fprintf(stderr,"%s\n",cmd);
@@ -507,7 +739,7 @@ static int handle_command(const char* command,char* answer,size_t buflen)
 
   strcpy(answer,"OK");                 /* default response */
   if (!strncmp(cmd,"ASI",3)) {         /* ASI commands */
-    err = handle_asi(command,answer,buflen);
+    err = handle_asi(cam,command,answer,buflen);
   } else
   if (!strncmp(cmd,"EFW",3)) {         /* EFW commands */
     err = handle_efw(command,answer,buflen);
@@ -522,248 +754,710 @@ static int handle_command(const char* command,char* answer,size_t buflen)
     sprintf(answer,"%d",offtime);
   } else
   if (!strcasecmp(cmd,"open")) { // ASI_SN sn; ASI_ID id;
-    if (zwo_state == ZWO_CLOSED) {
-      err = handle_asi("ASIGetNum",answer,buflen);
-      if (!err && (atoi(answer) == 0)) err = E_no_camera;
-      if (!err) err = handle_asi("ASIOpenCamera",answer,buflen);
-      if (!err) err = handle_asi("ASIInitCamera",answer,buflen);
-      if (!err) err = handle_asi("ASIGetCameraProperty",answer,buflen);
-      if (!err) err = handle_asi("ASIGetROIFormat",answer,buflen);
-      if (!err) err = handle_asi("ASIGetStartPos",answer,buflen);
-      if (!err) zwo_state = ZWO_IDLE;
-      if (!err) handle_command("exptime 0.02",answer,buflen);
-    }
-    if (!err) sprintf(answer,"%d %d %d %d %d %s",zwo_width,zwo_height,
-          zwo_cooler,zwo_color,zwo_bitDepth,zwo_model); /* v0027 */
+    if (cam->zwo_state == ZWO_CLOSED) {
+      err = handle_asi(cam,"ASIGetNum",answer,buflen);
+      if (!err && (atoi(answer) <= cam->index)) err = E_no_camera;
+      if (!err) err = handle_asi(cam,"ASIOpenCamera",answer,buflen);
+      if (!err) err = handle_asi(cam,"ASIInitCamera",answer,buflen);
+      if (!err) err = handle_asi(cam,"ASIGetCameraProperty",answer,buflen);
+      if (!err) handle_asi(cam,"ASIGetSerialNumber",buf,sizeof(buf));
+      if (!err) err = handle_asi(cam,"ASIGetROIFormat",answer,buflen);
+      if (!err) err = handle_asi(cam,"ASIGetStartPos",answer,buflen);
+      if (!err) cam->zwo_state = ZWO_IDLE;
+      if (!err) handle_command(cam,"exptime 0.02",answer,buflen);
+      if (!err) err = pool_setup(cam,0);
+    }
+    if (!err) sprintf(answer,"%d %d %d %d %d %s",cam->zwo_width,
+          cam->zwo_height,cam->zwo_cooler,cam->zwo_color,cam->zwo_bitDepth,
+          cam->zwo_model); /* v0027 */
+  } else
+  if (!strcasecmp(cmd,"setup") && (cam->zwo_state == ZWO_VIDEO) && (n > 6)) {
+    err = geo_request(cam,atoi(par1),atoi(par2),atoi(par3),atoi(par4),
+                      atoi(par5),atoi(par6));
+    if (err < 0) { strcpy(answer,"-Einvalid geometry\n"); return 0; }
+    if (!err && cam->calib.on && (cam->calib.bin != atoi(par5))) {
+      (void)calib_setup(cam,atoi(par5));  /* frames skip it until then */
+    }
+    if (!err) sprintf(answer,"%d %d %d %d %d %d\n", /* not stored */
+                      cam->geo_next.x,cam->geo_next.y,cam->geo_next.w,
+                      cam->geo_next.h,cam->geo_next.bin,cam->geo_next.bits);
   } else
   if (!strcasecmp(cmd,"setup")) { 
-    if (zwo_state != ZWO_IDLE) {
+    if (cam->zwo_state != ZWO_IDLE) {
       err = E_not_idle;
     } else {
       if (!strncasecmp(par1,"defaults",3)) { 
-        zwo_x =    (int)get_long(rcfile,KEY_WIN_X,0); 
-        zwo_y =    (int)get_long(rcfile,KEY_WIN_Y,0);
-        zwo_w =    (int)get_long(rcfile,KEY_WIN_W,4656);
-        zwo_h =    (int)get_long(rcfile,KEY_WIN_H,3520);
-        zwo_bin =  (int)get_long(rcfile,KEY_BINNING,1);
-        zwo_bits = (int)get_long(rcfile,KEY_BITS,16);
+        cam->zwo_x =    (int)get_long(rcfile,cam_key(cam,KEY_WIN_X,buf),0); 
+        cam->zwo_y =    (int)get_long(rcfile,cam_key(cam,KEY_WIN_Y,buf),0);
+        cam->zwo_w =    (int)get_long(rcfile,cam_key(cam,KEY_WIN_W,buf),4656);
+        cam->zwo_h =    (int)get_long(rcfile,cam_key(cam,KEY_WIN_H,buf),3520);
+        cam->zwo_bin =  (int)get_long(rcfile,cam_key(cam,KEY_BINNING,buf),1);
+        cam->zwo_bits = (int)get_long(rcfile,cam_key(cam,KEY_BITS,buf),16);
       } else
       if (!strncasecmp(par1,"image",3)) { 
-        zwo_x = 0; zwo_y = 0; 
-        zwo_bin = (n>2) ? atoi(par2) : 1;
-        zwo_w = zwo_width/zwo_bin; zwo_h = zwo_height/zwo_bin;
-        zwo_bits = 16;
+        cam->zwo_x = 0; cam->zwo_y = 0; 
+        cam->zwo_bin = (n>2) ? atoi(par2) : 1;
+        cam->zwo_w = cam->zwo_width/cam->zwo_bin;
+        cam->zwo_h = cam->zwo_height/cam->zwo_bin;
+        cam->zwo_bits = 16;
       } else
       if (!strncasecmp(par1,"video",3)) { 
-        zwo_x = 0; zwo_y = 0; 
-        zwo_bin = (n>2) ? atoi(par2) : 1;
-        zwo_w = zwo_width/zwo_bin; zwo_h = zwo_height/zwo_bin;
-        zwo_bits = 8;
+        cam->zwo_x = 0; cam->zwo_y = 0; 
+        cam->zwo_bin = (n>2) ? atoi(par2) : 1;
+        cam->zwo_w = cam->zwo_width/cam->zwo_bin;
+        cam->zwo_h = cam->zwo_height/cam->zwo_bin;
+        cam->zwo_bits = 8;
       } else
       if (n > 6) {
-        zwo_x = atoi(par1);    put_long(rcfile,KEY_WIN_X,zwo_x);
-        zwo_y = atoi(par2);    put_long(rcfile,KEY_WIN_Y,zwo_y);
-        zwo_w = atoi(par3);    put_long(rcfile,KEY_WIN_W,zwo_w);
-        zwo_h = atoi(par4);    put_long(rcfile,KEY_WIN_H,zwo_h);
-        zwo_bin = atoi(par5);  put_long(rcfile,KEY_BINNING,zwo_bin);
-        zwo_bits = atoi(par6); put_long(rcfile,KEY_BITS,zwo_bits);
+        cam->zwo_x = atoi(par1);
+        put_long(rcfile,cam_key(cam,KEY_WIN_X,buf),cam->zwo_x);
+        cam->zwo_y = atoi(par2);
+        put_long(rcfile,cam_key(cam,KEY_WIN_Y,buf),cam->zwo_y);
+        cam->zwo_w = atoi(par3);
+        put_long(rcfile,cam_key(cam,KEY_WIN_W,buf),cam->zwo_w);
+        cam->zwo_h = atoi(par4);
+        put_long(rcfile,cam_key(cam,KEY_WIN_H,buf),cam->zwo_h);
+        cam->zwo_bin = atoi(par5);
+        put_long(rcfile,cam_key(cam,KEY_BINNING,buf),cam->zwo_bin);
+        cam->zwo_bits = atoi(par6);
+        put_long(rcfile,cam_key(cam,KEY_BITS,buf),cam->zwo_bits);
       } 
     }
     if (n > 1) { int t;                /* 't' v0017 */
-      while (zwo_w % 8) { zwo_w -= 1; }
-      while (zwo_h % 2) { zwo_h -= 1; }
-      if (zwo_color) { int bits=zwo_bits;
-        t = (bits==8) ? ASI_IMG_Y8 : (bits==16) ? ASI_IMG_RAW16 : ASI_IMG_RGB24;
-      } else {
-        t = (zwo_bits==8) ? ASI_IMG_RAW8 : ASI_IMG_RAW16;
+      while (cam->zwo_w % 8) { cam->zwo_w -= 1; }
+      while (cam->zwo_h % 2) { cam->zwo_h -= 1; }
+      t = img_type(cam,cam->zwo_bits);
+      sprintf(buf,"ASISetROIFormat %d %d %d %d",cam->zwo_w,cam->zwo_h,
+              cam->zwo_bin,t);
+      if (!err) err = handle_asi(cam,buf,answer,buflen);
+      sprintf(buf,"ASISetStartPos %d %d",cam->zwo_x,cam->zwo_y);
+      if (!err) err = handle_asi(cam,buf,answer,buflen);
+      if (!err) err = pool_setup(cam,0);   /* pre-fault for this ROI */
+      if (!err && cam->calib.on && (cam->calib.bin != cam->zwo_bin)) {
+        (void)calib_setup(cam,cam->zwo_bin);
       }
-      sprintf(buf,"ASISetROIFormat %d %d %d %d",zwo_w,zwo_h,zwo_bin,t);
-      if (!err) err = handle_asi(buf,answer,buflen);
-      sprintf(buf,"ASISetStartPos %d %d",zwo_x,zwo_y);
-      if (!err) err = handle_asi(buf,answer,buflen);
     }
     if (!err) sprintf(answer,"%d %d %d %d %d %d\n",
-                      zwo_x,zwo_y,zwo_w,zwo_h,zwo_bin,zwo_bits);
+                      cam->zwo_x,cam->zwo_y,cam->zwo_w,cam->zwo_h,
+                      cam->zwo_bin,cam->zwo_bits);
   } else
   if (!strcasecmp(cmd,"exptime")) {
-    if (zwo_state == ZWO_CLOSED) err = E_not_open;
+    if (cam->zwo_state == ZWO_CLOSED) err = E_not_open;
     if (!err && (n > 1)) {
       int et = (int)floor(1.0e6*atof(par1)+0.5);
       sprintf(buf,"ASISetControlValue %d %d",ASI_EXPOSURE,et);
-      err = handle_asi(buf,answer,buflen);
+      err = handle_asi(cam,buf,answer,buflen);
     }
-    if (!err) sprintf(answer,"%.6f",asi_expTime);
+    if (!err) sprintf(answer,"%.6f",cam->asi_expTime);
   } else 
   if (!strcasecmp(cmd,"gain")) {
-    if (zwo_state == ZWO_CLOSED) err = E_not_open;
+    if (cam->zwo_state == ZWO_CLOSED) err = E_not_open;
     if (!err && (n > 1)) {
-      asi_gain = atoi(par1);
-      sprintf(buf,"ASISetControlValue %d %d",ASI_GAIN,asi_gain);
-      err = handle_asi(buf,answer,buflen);
+      cam->asi_gain = atoi(par1);
+      sprintf(buf,"ASISetControlValue %d %d",ASI_GAIN,cam->asi_gain);
+      err = handle_asi(cam,buf,answer,buflen);
     }
-    if (!err) sprintf(answer,"%d",asi_gain);
+    if (!err) sprintf(answer,"%d",cam->asi_gain);
   } else 
   if (!strcasecmp(cmd,"offset")) {
-    if (zwo_state == ZWO_CLOSED) err = E_not_open;
+    if (cam->zwo_state == ZWO_CLOSED) err = E_not_open;
     if (!err && (n > 1)) {
-      asi_offset = atoi(par1);
-      sprintf(buf,"ASISetControlValue %d %d",ASI_OFFSET,asi_offset);
-      err = handle_asi(buf,answer,buflen);
+      cam->asi_offset = atoi(par1);
+      sprintf(buf,"ASISetControlValue %d %d",ASI_OFFSET,cam->asi_offset);
+      err = handle_asi(cam,buf,answer,buflen);
     }
-    if (!err) sprintf(answer,"%d",asi_offset);
+    if (!err) sprintf(answer,"%d",cam->asi_offset);
   } else
   if (!strcasecmp(cmd,"usb")) {        /* ASI_BANDWIDTHOVERLOAD 40..100 */
-    if (zwo_state == ZWO_CLOSED) err = E_not_open;
+    if (cam->zwo_state == ZWO_CLOSED) err = E_not_open;
     if (!err && (n > 1)) {
-      asi_usb = atoi(par1);
-      sprintf(buf,"ASISetControlValue %d %d",ASI_BANDWIDTHOVERLOAD,asi_usb);
-      err = handle_asi(buf,answer,buflen);
+      cam->asi_usb = atoi(par1);
+      sprintf(buf,"ASISetControlValue %d %d",ASI_BANDWIDTHOVERLOAD,
+              cam->asi_usb);
+      err = handle_asi(cam,buf,answer,buflen);
     }
-    if (!err) sprintf(answer,"%d",asi_usb);
+    if (!err) sprintf(answer,"%d",cam->asi_usb);
   } else
   if (!strcasecmp(cmd,"highspeed")) {  /* ASI_HIGH_SPEED_MODE 0/1 */
-    if (zwo_state == ZWO_CLOSED) err = E_not_open;
+    if (cam->zwo_state == ZWO_CLOSED) err = E_not_open;
     if (!err && (n > 1)) {
-      asi_highspeed = atoi(par1);
-      sprintf(buf,"ASISetControlValue %d %d",ASI_HIGH_SPEED_MODE,asi_highspeed);
-      err = handle_asi(buf,answer,buflen);
+      cam->asi_highspeed = atoi(par1);
+      sprintf(buf,"ASISetControlValue %d %d",ASI_HIGH_SPEED_MODE,
+              cam->asi_highspeed);
+      err = handle_asi(cam,buf,answer,buflen);
     }
-    if (!err) sprintf(answer,"%d",asi_highspeed);
+    if (!err) sprintf(answer,"%d",cam->asi_highspeed);
   } else
   if (!strcasecmp(cmd,"status")) {
-    if (zwo_state == ZWO_EXPOSING) { int a,b;
-      handle_asi("ASIGetExpStatus",answer,buflen);
+    if (cam->zwo_state == ZWO_EXPOSING) { int a,b;
+      handle_asi(cam,"ASIGetExpStatus",answer,buflen);
       sscanf(answer,"%d %d",&a,&b);
-      if (b != ASI_EXP_WORKING) zwo_state = ZWO_IDLE;
+      if (b != ASI_EXP_WORKING) cam->zwo_state = ZWO_IDLE;
     }
-    switch (zwo_state) { 
+    switch (cam->zwo_state) { 
       case ZWO_CLOSED:   sprintf(answer,"closed"); break;
       case ZWO_IDLE:     sprintf(answer,"idle"); break;
       case ZWO_EXPOSING: 
-        sprintf(answer,"exposing %.1f",walltime(0)-asi_startTime); 
+        sprintf(answer,"exposing %.1f",walltime(0)-cam->asi_startTime); 
+        break;
+      case ZWO_VIDEO:    
+        sprintf(answer,"streaming");
+        break;
+      case ZWO_BURST:
+        sprintf(answer,"burst %u %u",cam->burst_seq,cam->burst_n);
         break;
-      case ZWO_VIDEO:    sprintf(answer,"streaming"); break;
       default:           sprintf(answer,"unknown"); break;
     }
   } else
   if (!strcasecmp(cmd,"expose")) {
-    if (zwo_state != ZWO_IDLE) {
-      handle_command("status",answer,buflen); 
-      if (zwo_state != ZWO_IDLE) err = E_not_idle;
+    if (cam->zwo_state != ZWO_IDLE) {
+      handle_command(cam,"status",answer,buflen); 
+      if (cam->zwo_state != ZWO_IDLE) err = E_not_idle;
     }
     if (!err) {
-      err = handle_asi("ASIStartExposure",answer,buflen);
+      err = handle_asi(cam,"ASIStartExposure",answer,buflen);
     }
   } else
   if (!strcasecmp(cmd,"data")) {
-    if (zwo_state != ZWO_VIDEO) { 
-      if (zwo_state != ZWO_IDLE) {
-        handle_command("status",answer,buflen); 
-        if (zwo_state != ZWO_IDLE) err = E_not_idle;
+    if (cam->zwo_state != ZWO_VIDEO) { 
+      if (cam->zwo_state != ZWO_IDLE) {
+        handle_command(cam,"status",answer,buflen); 
+        if (cam->zwo_state != ZWO_IDLE) err = E_not_idle;
       }
     }
-    if (!err) { int size = zwo_w * zwo_h * zwo_bits/8;
+    if (!err) { int size = cam->zwo_w * cam->zwo_h * cam->zwo_bits/8;
       // printf("w=%d, h=%d, bits=%d\n",zwo_w,zwo_h,zwo_bits);
-      if (zwo_state == ZWO_VIDEO) { 
-        int wait = 350+(int)(1000.0*asi_expTime); 
+      if (cam->zwo_state == ZWO_VIDEO) { 
+        int wait = 350+(int)(1000.0*cam->asi_expTime); 
         printf("wait=%d, size=%u\n",wait,size); //xxx
         sprintf(buf,"ASIGetVideoData %d %d",size,wait);
       } else {
         sprintf(buf,"ASIGetDataAfterExp %d",size);
       }
-      err = handle_asi(buf,answer,buflen);
+      err = handle_asi(cam,buf,answer,buflen);
     }
     if (!err) {
-      sprintf(answer,"%u\n",(u_int)asi_size);
-      if (n > 1) asi_size = imin(asi_size,atoi(par1));
+      (void)calib_apply(&cam->calib,tx->data,cam->zwo_x,cam->zwo_y,
+                        cam->zwo_w,cam->zwo_h,cam->zwo_bin,cam->zwo_bits,
+                        cam->asi_expTime);
+      sprintf(answer,"%u\n",(u_int)tx->size);
+      if (n > 1) tx->size = imin(tx->size,atoi(par1));
     }
   } else
   if (!strcasecmp(cmd,"next")) {       /* v0024 */
-    if (zwo_state != ZWO_VIDEO) { 
+    if (cam->zwo_state == ZWO_BURST) {      /* oldest queued exposure */
+      double timeout = (n > 1) ? atof(par1) : 0;
+      double t1 = walltime(0);
+      while ((cam->burst_seq <= cam->burst_last) && cam->burst_running) {
+        if (walltime(0)-t1 >= timeout) break;
+        msleep(1);
+      }
+      if (cam->burst_seq > cam->burst_last) {
+        int k = cam->burst_last % cam->burst_depth;
+        __sync_synchronize(); /* frame data written before seq (arm64) */
+        tx->size = cam->zwo_w * cam->zwo_h * cam->zwo_bits/8;
+        tx->data = frame_tx(tx,tx->size);
+        memcpy(tx->data,fpool_slot(&cam->fpool,k),tx->size);
+        sprintf(answer,"%u %.1f %.0f %llu %llu",cam->burst_last+1,
+                cam->asi_temperature,cam->asi_cooler_power,cam->burst_ts[k],
+                cam->burst_t0[k]);
+        if (cam->stats_on) stats_answer(cam,&cam->burst_stats[k],answer);
+        __sync_synchronize(); /* copied before the slot is handed back */
+        cam->burst_last++;
+        if (cam->burst_last >= cam->burst_n) cam->zwo_state = ZWO_IDLE;
+      } else {
+        if (!cam->burst_running) cam->zwo_state = ZWO_IDLE;  /* aborted */
+        strcpy(answer,"-Enodata");
+      }
+    } else
+    if (cam->zwo_state != ZWO_VIDEO) { 
       err = E_not_video;
     } else {  
+      if (video_wait(cam,(n > 1) ? atof(par1) : 0)) {
+        __sync_synchronize(); /* frame data written before seq (arm64) */
+        cam->video_last = cam->video_seq;
+        Geometry *g = &cam->video_geom[cam->video_last % cam->fpool.n];
+        tx->size = g->w * g->h * g->bits/8;
+        tx->data = frame_tx(tx,tx->size);
+        memcpy(tx->data,fpool_slot(&cam->fpool,cam->video_last),
+               tx->size); // v0028
+        sprintf(answer,"%u %.1f %.0f %llu %d %d %d %d %d %d",cam->video_last,
+                cam->asi_temperature,cam->asi_cooler_power,
+                cam->video_ts[cam->video_last % cam->fpool.n],
+                g->x,g->y,g->w,g->h,g->bin,g->bits);
+        TrackTag *t = &cam->video_track[cam->video_last % cam->fpool.n];
+        if (t->on) sprintf(answer+strlen(answer)," %d %.2f %.2f %.2f %.2f",
+                           t->st,t->x,t->y,t->dx,t->dy);
+        if (cam->stats_on) {
+          stats_answer(cam,&cam->video_stats[cam->video_last % cam->fpool.n],
+                       answer);
+        }
+      } else {
+        strcpy(answer,"-Enodata");
+      }
+    }
+  } else
+  if (!strcasecmp(cmd,"cut")) {        /* boxes of the next frame */
+    if (cam->zwo_state != ZWO_VIDEO) {
+      err = E_not_video;
+    } else
+    if (cam->box_n == 0) {
+      strcpy(answer,"-Eno boxes\n"); return 0;
+    } else
+    if (video_wait(cam,(n > 1) ? atof(par1) : 0)) { int i,j,x,y,b;
+      __sync_synchronize(); /* frame data written before seq (arm64) */
+      cam->video_last = cam->video_seq;
+      Geometry *g = &cam->video_geom[cam->video_last % cam->fpool.n];
+      const u_char *src = fpool_slot(&cam->fpool,cam->video_last);
+      size_t total=0;
+      b = g->bits/8;
+      for (i=0; i<cam->box_n; i++) {
+        if ((cam->box[i].w > g->w) || (cam->box[i].h > g->h)) err = E_no_data;
+        total += (size_t)cam->box[i].w*cam->box[i].h*b;
+      }
+      if (!err) {
+        u_char *dst = frame_tx(tx,total);
+        sprintf(answer,"%u %.1f %.0f %llu %d",cam->video_last,
+                cam->asi_temperature,cam->asi_cooler_power,
+                cam->video_ts[cam->video_last % cam->fpool.n],cam->box_n);
+        for (i=0; i<cam->box_n; i++) {      /* shifted into the window */
+          x = imax(0,imin(cam->box[i].x-g->x,g->w-cam->box[i].w));
+          y = imax(0,imin(cam->box[i].y-g->y,g->h-cam->box[i].h));
+          for (j=0; j<cam->box[i].h; j++) {
+            memcpy(dst,src+((size_t)(y+j)*g->w+x)*b,(size_t)cam->box[i].w*b);
+            dst += (size_t)cam->box[i].w*b;
+          }
+          sprintf(answer+strlen(answer)," %d %d",g->x+x,g->y+y);
+        }
+        tx->size = total;
+      }
+    } else {
+      strcpy(answer,"-Enodata");
+    }
+  } else
+  if (!strcasecmp(cmd,"calib")) {      /* bias/dark/flat, bad pixels */
+    Calib *cal = &cam->calib;
+    if (n > 1) {
+      if (!strcasecmp(par1,"off")) {
+        cal->on = 0;
+      } else
+      if (!strcasecmp(par1,"on") || !strcasecmp(par1,"load")) {
+        if ((cal->bin != cam->zwo_bin) || !cal->have ||
+            !strcasecmp(par1,"load")) {
+          if (calib_setup(cam,cam->zwo_bin) == 0) {
+            cal->on = 0;
+            strcpy(answer,"-Eno masters\n"); return 0;
+          }
+        }
+        cal->on = 1;
+      } else {
+        strcpy(answer,"-Einvalid command\n"); return 0;
+      }
+    }
+    sprintf(answer,"%s %d %d %d %d %d %d %u %u",(cal->on) ? "on" : "off",
+            cal->bin,cal->have & 1,(cal->have>>1) & 1,(cal->have>>2) & 1,
+            cal->nbad,cal->pedestal,cal->nframes,cal->nskip);
+  } else
+  if (!strcasecmp(cmd,"auto")) {       /* exposure/gain control */
+    AutoExp *a = &cam->aexp;
+    if (n > 1) {
+      if (!strcasecmp(par1,"off")) {
+        a->on = 0;
+      } else
+      if (!strcasecmp(par1,"on")) {
+        double t=(n > 2) ? atof(par2) : a->target;
+        double p=(n > 3) ? atof(par3) : a->pct;
+        if ((t <= 0) || (t >= 1) || (p < 50) || (p > 100)) {
+          strcpy(answer,"-Einvalid auto\n"); return 0;
+        }
+        a->target = t; a->pct = p;
+        if (a->gmax < 0) a->gmin = a->gmax = cam->asi_gain;
+        a->settle = a->steps = 0;
+        a->on = 1;
+      } else
+      if (!strcasecmp(par1,"region") && (n > 5)) {
+        a->x = atoi(par2); a->y = atoi(par3);
+        a->w = atoi(par4); a->h = atoi(par5);
+      } else
+      if (!strcasecmp(par1,"limits") && (n > 3)) {
+        double e1=atof(par2),e2=atof(par3);
+        int    g1=(n > 5) ? atoi(par4) : -1,g2=(n > 5) ? atoi(par5) : -1;
+        if ((e1 <= 0) || (e2 < e1) || (g2 < g1)) {
+          strcpy(answer,"-Einvalid auto\n"); return 0;
+        }
+        a->emin = e1; a->emax = e2; a->gmin = g1; a->gmax = g2;
+        if (a->on && (g2 < 0)) a->gmin = a->gmax = cam->asi_gain;
+      } else {
+        strcpy(answer,"-Einvalid command\n"); return 0;
+      }
+    }
+    sprintf(answer,"%s %.2f %.1f %.6f %d %.3f %d",(a->on) ? "on" : "off",
+            a->target,a->pct,cam->asi_expTime,cam->asi_gain,a->level,a->steps);
+  } else
+  if (!strcasecmp(cmd,"preview")) {    /* thumbnails for 'thumb' */
+    if ((n > 1) && !strcasecmp(par1,"off")) {
+      cam->pv_on = 0;
+    } else
+    if ((n > 1) && !strcasecmp(par1,"on")) {
+      int    w=(n > 2) ? atoi(par2) : cam->pv_width,m=cam->pv_mode;
+      double r=(n > 3) ? atof(par3) : cam->pv_rate;
+      if (n > 4) m = (!strcasecmp(par4,"avg"))    ? THUMB_AVG :
+                     (!strcasecmp(par4,"stride")) ? THUMB_STRIDE : -1;
+      if ((w < THUMB_WMIN) || (w > THUMB_WMAX) || (r <= 0) ||
+          (r > PREVIEW_RMAX) || (m < 0)) {
+        strcpy(answer,"-Einvalid preview\n"); return 0;
+      }
+      if (!cam->pv_buf) {
+        cam->pv_buf = (u_char*)malloc(2*THUMB_WMAX*THUMB_WMAX);
+        if (!cam->pv_buf) err = E_no_memory;
+      }
+      cam->pv_width = w; cam->pv_rate = r; cam->pv_mode = m;
+      __sync_synchronize();            /* before run_video sees 'on' */
+      if (!err) cam->pv_on = 1;
+    } else
+    if (n > 1) {
+      strcpy(answer,"-Einvalid command\n"); return 0;
+    }
+    if (!err) sprintf(answer,"%s %d %.1f %s %u",(cam->pv_on) ? "on" : "off",
+                      cam->pv_width,cam->pv_rate,
+                      (cam->pv_mode == THUMB_STRIDE) ? "stride" : "avg",
+                      cam->pv_seq);
+  } else
+  if (!strcasecmp(cmd,"thumb")) {      /* newest preview thumbnail */
+    if (cam->zwo_state != ZWO_VIDEO) {
+      err = E_not_video;
+    } else
+    if (!cam->pv_on) {
+      strcpy(answer,"-Eno preview\n"); return 0;
+    } else {
       double timeout = (n > 1) ? atof(par1) : 0;
       double t1 = walltime(0);
-      while (video_seq <= video_last) {     /* b0025 */
-	if (walltime(0)-t1 >= timeout) break;
-        msleep(1);   /* 5ms quantum capped video at ~194 fps */
+      while (cam->pv_seq <= cam->pv_last) {
+        if (walltime(0)-t1 >= timeout) break;
+        msleep(1);
       }
-      if (video_seq > video_last) {
-        __sync_synchronize(); /* frame data written before seq (arm64) */
-        video_last = video_seq;
-        u_char *data = (video_last % 2) ? video_data2 : video_data1;
-        asi_size = zwo_w * zwo_h * zwo_bits/8;
-        asi_data = (u_char*)realloc(asi_data,asi_size);
-        memcpy(asi_data,data,asi_size); // don't shift here v0028 
-        sprintf(answer,"%u %.1f %.0f %llu",video_last,
-                asi_temperature,asi_cooler_power,
-                video_ts[(video_last % 2) ? 1 : 0]);
+      if (cam->pv_seq > cam->pv_last) {
+        __sync_synchronize(); /* thumbnail written before seq (arm64) */
+        cam->pv_last = cam->pv_seq;
+        Thumb *t = &cam->pv_tag[cam->pv_last & 1];
+        tx->size = t->tw*t->th;
+        tx->data = frame_tx(tx,tx->size);
+        memcpy(tx->data,cam->pv_buf+(cam->pv_last & 1)*THUMB_WMAX*
+               THUMB_WMAX,tx->size);
+        sprintf(answer,"%u %llu %d %d %d %d %d %d %d %d",t->seq,t->ts,
+                t->g.x,t->g.y,t->g.w,t->g.h,t->g.bin,t->tw,t->th,t->f);
       } else {
         strcpy(answer,"-Enodata");
       }
     }
   } else
+  if (!strcasecmp(cmd,"record")) {     /* flight recorder */
+    FlightRec *rec = &cam->rec;
+    if ((n > 1) && !strcasecmp(par1,"off")) {
+      cam->rec_on = 0;
+    } else
+    if ((n > 1) && !strcasecmp(par1,"on")) {
+      double t=(n > 2) ? atof(par2) : (rec->base) ? rec->seconds : REC_SECONDS;
+      long   mb=(n > 3) ? atol(par3) : (rec->base) ? (long)(rec->cap>>20) :
+                                                    REC_BUDGET;
+      if ((t <= 0) || (mb < 1)) {
+        strcpy(answer,"-Einvalid record\n"); return 0;
+      }
+      if (rec->base && ((size_t)mb<<20 != rec->cap) &&
+          (cam->zwo_state == ZWO_VIDEO)) {     /* run_record writes to it */
+        err = E_not_idle;
+      } else
+      if (frec_alloc(rec,(size_t)mb<<20,t)) {
+        err = (rec->dumping) ? E_not_idle : E_no_memory;
+      }
+      __sync_synchronize();            /* before run_record sees 'on' */
+      if (!err) cam->rec_on = 1;
+    } else
+    if ((n > 2) && !strcasecmp(par1,"trigger")) {
+      if (!strcasecmp(par2,"off")) {
+        cam->rec_jump = cam->rec_drop = 0;
+      } else
+      if ((n > 3) && (atof(par2) >= 0) && (atof(par3) >= 0) &&
+          (atof(par3) < 1)) {
+        cam->rec_jump = atof(par2); cam->rec_drop = atof(par3);
+      } else {
+        strcpy(answer,"-Einvalid record\n"); return 0;
+      }
+    } else
+    if (n > 1) {
+      strcpy(answer,"-Einvalid command\n"); return 0;
+    }
+    if (!err) sprintf(answer,"%s %.1f %.0f %u %.2f %u %u %d %.2f %.2f",
+                      (cam->rec_on) ? "on" : "off",rec->seconds,
+                      rec->cap/1048576.0,rec->n-rec->first,frec_span(rec),
+                      rec->ndrop,rec->ndump,rec->dumping,
+                      cam->rec_jump,cam->rec_drop);
+  } else
+  if (!strcasecmp(cmd,"dump")) {       /* flight recorder to disk */
+    if (cam->rec.dumping) {
+      err = E_not_idle;
+    } else {
+      int k = record_dump(cam,"dump");
+      if (k < 0) { strcpy(answer,"-Eno frames\n"); return 0; }
+      sprintf(answer,"%s %d",cam->rec.path,k);
+    }
+  } else
+  if (!strcasecmp(cmd,"stats")) {      /* per-frame statistics */
+    if ((n > 1) && !strcasecmp(par1,"off")) {
+      cam->stats_on = 0;
+    } else
+    if ((n > 1) && !strcasecmp(par1,"on")) { int nh=(n > 2) ? atoi(par2) : 0;
+      if ((nh < 0) || (nh > FSTATS_HMAX) || (nh & (nh-1))) {
+        strcpy(answer,"-Einvalid histogram\n"); return 0;
+      }
+      cam->stats_nhist = nh;
+      cam->stats_on = 1;
+    } else
+    if (n > 1) {
+      strcpy(answer,"-Einvalid command\n"); return 0;
+    }
+    sprintf(answer,"%s %d",(cam->stats_on) ? "on" : "off",cam->stats_nhist);
+  } else
+  if (!strcasecmp(cmd,"box")) {        /* sub-windows for 'cut' */
+    if ((n > 1) && !strcasecmp(par1,"clear")) {
+      cam->box_n = 0;
+    } else
+    if (n > 1) { int x=atoi(par1),y=atoi(par2),w=atoi(par3),h=atoi(par4);
+      if ((n < 5) || (cam->box_n >= BOX_NMAX) || (w < 1) || (h < 1) ||
+          (x < 0) || (y < 0) || (w > cam->zwo_w) || (h > cam->zwo_h) ||
+          ((x+w)*cam->zwo_bin > cam->zwo_width) ||
+          ((y+h)*cam->zwo_bin > cam->zwo_height)) {
+        strcpy(answer,"-Einvalid box\n"); return 0;
+      }
+      cam->box[cam->box_n].x = x; cam->box[cam->box_n].y = y;
+      cam->box[cam->box_n].w = w; cam->box[cam->box_n].h = h;
+      cam->box_n++;
+    }
+    sprintf(answer,"%d",cam->box_n);
+  } else
+  if (!strcasecmp(cmd,"move")) {       /* window start position */
+    if (n < 3) {
+      strcpy(answer,"-Einvalid geometry\n"); return 0;
+    } else
+    if (cam->zwo_state == ZWO_VIDEO) {      /* between frames */
+      Geometry g = {cam->zwo_x,cam->zwo_y,cam->zwo_w,cam->zwo_h,
+                    cam->zwo_bin,cam->zwo_bits,0};
+      pthread_mutex_lock(&cam->geo_lock);   /* after a 'setup' in flight */
+      if (cam->geo_pending) g = cam->geo_next;
+      pthread_mutex_unlock(&cam->geo_lock);
+      err = geo_request(cam,atoi(par1),atoi(par2),g.w,g.h,g.bin,g.bits);
+      if (err < 0) { strcpy(answer,"-Einvalid geometry\n"); return 0; }
+      if (!err) sprintf(answer,"%d %d",atoi(par1),atoi(par2));
+    } else
+    if (cam->zwo_state != ZWO_IDLE) {
+      err = E_not_idle;
+    } else { Geometry g;
+      err = geo_check(cam,atoi(par1),atoi(par2),cam->zwo_w,cam->zwo_h,
+                      cam->zwo_bin,cam->zwo_bits,&g);
+      if (err < 0) { strcpy(answer,"-Einvalid geometry\n"); return 0; }
+      if (!err) {
+        sprintf(buf,"ASISetStartPos %d %d",g.x,g.y);
+        err = handle_asi(cam,buf,answer,buflen);
+      }
+      if (!err) { cam->zwo_x = g.x; cam->zwo_y = g.y; }
+      if (!err) sprintf(answer,"%d %d",cam->zwo_x,cam->zwo_y);
+    }
+  } else
   if (!strcasecmp(cmd,"start")) {
-    if (zwo_state != ZWO_IDLE) err = E_not_idle;
-    if (!err) { int i;   /* previous thread must be gone before its */
-                         /* buffers are realloc'ed for the new one  */
-      for (i=0; video_running && (i<300); i++) msleep(10);
-      err = handle_asi("ASIStartVideoCapture",answer,buflen);
-      if (!err) { size_t vsize = (size_t)zwo_w*zwo_h*zwo_bits/8;
-        /* buffers are (re)allocated HERE, on the thread that also   */
-        /* serves 'next': aarch64 reorders cross-thread stores, so a */
-        /* consumer must never read pointers written by run_video    */
-        video_data1 = (u_char*)realloc(video_data1,vsize+SDK_BUF_PAD);
-        video_data2 = (u_char*)realloc(video_data2,vsize+SDK_BUF_PAD);
-        zwo_state = ZWO_VIDEO;
-        video_running = 1;
+    if (cam->zwo_state != ZWO_IDLE) err = E_not_idle;
+    if (!err) cam->track_state = TRK_OFF;   /* 'track' sets it after 'start' */
+    /* the pool is (re)allocated HERE (no-op if 'setup' did it), on */
+    /* the thread that also serves 'next': aarch64 reorders cross-  */
+    /* thread stores, so a consumer must never read pointers written */
+    /* by run_video                                                  */
+    if (!err) err = pool_setup(cam,1);
+    if (!err) {
+      err = handle_asi(cam,"ASIStartVideoCapture",answer,buflen);
+      if (!err) {
+        cam->vtrace_n = 0; cam->video_dropped = 0;
+        cam->video_stalls = cam->video_rearms = cam->video_rfails = 0;
+        strcpy(cam->rt_status,"-");         /* set by run_video */
+        cam->zwo_state = ZWO_VIDEO;
+        cam->video_running = cam->rec_running = 1;
         __sync_synchronize();
-        thread_detach(run_video,NULL);  /* v0024 */
+        thread_detach(run_video,cam);  /* v0024 */
+        thread_detach(run_record,cam); /* idle unless 'record on' */
       }
     }
   } else
+  if (!strcasecmp(cmd,"track")) {      /* acquire, then track */
+    if ((cam->zwo_state == ZWO_VIDEO) && cam->track_state) {
+      if ((n > 1) && !strcasecmp(par1,"off")) cam->track_state = TRK_OFF;
+      sprintf(answer,"%d %.2f %.2f %.2f %.2f",cam->track_now.st,
+              cam->track_now.x,cam->track_now.y,
+              cam->track_now.dx,cam->track_now.dy);
+    } else
+    if (cam->zwo_state != ZWO_IDLE) {
+      err = E_not_idle;
+    } else {
+      int bin = (n > 2) ? imax(1,imin(4,atoi(par2))) : 2;
+      cam->track_box = (n > 1) ? imax(16,imin(512,atoi(par1))) & ~7 : TRACK_BOX;
+      sprintf(buf,"setup image %d",bin); /* 16 bit, not stored */
+      handle_command(cam,buf,answer,buflen);
+      if (answer[0] == '-') sscanf(answer,"-Eerr=%ld",&err);
+      if (!err) {
+        cam->track_acq.x = cam->zwo_x; cam->track_acq.y = cam->zwo_y;
+        cam->track_acq.w = cam->zwo_w; cam->track_acq.h = cam->zwo_h;
+        cam->track_acq.bin = cam->zwo_bin; cam->track_acq.bits = cam->zwo_bits;
+        cam->track_acq.type = img_type(cam,cam->zwo_bits);
+        memset(&cam->track_now,0,sizeof(cam->track_now));
+        memset(cam->video_track,0,sizeof(cam->video_track));
+        cam->track_lost = 0;
+        handle_command(cam,"start",answer,buflen);
+        if (answer[0] == '-') sscanf(answer,"-Eerr=%ld",&err);
+      }
+      if (!err) {
+        cam->track_state = TRK_ACQUIRE;
+        sprintf(answer,"%d %d",cam->track_box,bin);
+      }
+    }
+  } else
+  if (!strcasecmp(cmd,"vmode")) {      /* video acquisition strategy */
+    if (n > 1) {
+      if      (!strcasecmp(par1,"free"))  cam->video_mode = VM_FREE;
+      else if (!strcasecmp(par1,"slice")) cam->video_mode = VM_SLICE;
+      else if (!strcasecmp(par1,"adapt")) cam->video_mode = VM_ADAPT;
+      else { strcpy(answer,"-Einvalid video mode\n"); return 0; }
+    }
+    sprintf(answer,"%s",(cam->video_mode == VM_SLICE) ? "slice" : 
+                        (cam->video_mode == VM_ADAPT) ? "adapt" : "free");
+  } else
+  if (!strcasecmp(cmd,"pool")) {       /* frame pool */
+    if (n > 1) {
+      if (cam->zwo_state != ZWO_IDLE) {  /* slots are in use */
+        err = E_not_idle;
+      } else {
+        cam->fpool.budget = (size_t)atol(par1)<<20;
+        err = pool_setup(cam,0);
+      }
+    }
+    sprintf(answer,"%d %.1f %.1f %.0f %d",cam->fpool.n,
+            cam->fpool.slot/1048576.0,
+            cam->fpool.n*cam->fpool.slot/1048576.0,
+            cam->fpool.budget/1048576.0,
+            cam->fpool.huge);
+  } else
+  if (!strcasecmp(cmd,"rt")) {         /* real-time options */
+    if (n > 1) cam->rt_prio = imax(0,imin(99,atoi(par1)));
+    if (n > 2) cam->rt_cpu  = atoi(par2);   /* both apply at next 'start' */
+    if (n > 3) {                       /* this connection, now */
+      net_cpu = atoi(par3);
+      rt_thread(0,net_cpu,NULL);
+    }
+    sprintf(answer,"%d %d %d %d %s",cam->rt_prio,cam->rt_cpu,net_cpu,rt_lock,
+            cam->rt_status);
+  } else
+  if (!strcasecmp(cmd,"stalls")) {     /* run_video watchdog counters */
+    sprintf(answer,"%d %d %d",cam->video_stalls,cam->video_rearms,
+            cam->video_rfails);
+  } else
+  if (!strcasecmp(cmd,"vtrace")) {     /* ASIGetVideoData statistics */
+    u_int i,i0 = (cam->vtrace_n > VTRACE_N) ? cam->vtrace_n-VTRACE_N : 0;
+    u_int calls=cam->vtrace_n-i0,tout=0,nok=0;
+    double blk=0,bmax=0,gap=0,period=0;
+    unsigned long long first=0,last=0,prev=0;
+    if (n > 1) {                       /* 'vtrace dump' */
+      sprintf(answer,"%s/%s.txt",dataPath,cam_key(cam,"vtrace",buf));
+      FILE *fp = fopen(answer,"w");
+      if (!fp) { err = E_no_data; } else {
+        fprintf(fp,"# entry_ns return_ns wait_ms ret start_ns\n");
+        for (i=i0; i<cam->vtrace_n; i++) {
+          VideoCall *vc = &cam->vtrace[i % VTRACE_N];
+          fprintf(fp,"%llu %llu %d %d %llu\n",vc->t_entry,vc->t_return,
+                  vc->wait,vc->ret,vc->t_start);
+        }
+        fclose(fp);
+      }
+    } else {
+      for (i=i0; i<cam->vtrace_n; i++) {
+        VideoCall *vc = &cam->vtrace[i % VTRACE_N];
+        double dt = (double)(vc->t_return-vc->t_entry)/1.0e6;
+        if (prev) gap += (double)(vc->t_entry-prev)/1.0e6;
+        prev = vc->t_return;
+        if (vc->ret != ASI_SUCCESS) { tout++; continue; }
+        blk += dt; if (dt > bmax) bmax = dt;
+        if (!first) first = vc->t_return;
+        last = vc->t_return; nok++;
+      }
+      if (nok > 1) period = (double)(last-first)/1.0e6/(double)(nok-1);
+      sprintf(answer,"%u %u %d %.2f %.2f %.3f %.3f",calls,tout,
+              cam->video_dropped,
+              (nok) ? blk/nok : 0.0,bmax,(calls > 1) ? gap/(calls-1) : 0.0,
+              period);
+    }
+  } else
+  if (!strcasecmp(cmd,"burst")) {      /* N back-to-back exposures */
+    if (cam->zwo_state != ZWO_IDLE) err = E_not_idle;
+    if (!err && ((n < 2) || (atoi(par1) < 1))) {
+      strcpy(answer,"-Einvalid burst length\n");
+      return 0;
+    }
+    if (!err) err = pool_setup(cam,1);     /* cf. 'start' */
+    if (!err) {
+      cam->burst_depth = imin(cam->fpool.n,BURST_NBUFS);
+      cam->burst_n = atoi(par1);
+      cam->burst_seq = cam->burst_last = 0;
+      cam->zwo_state = ZWO_BURST;
+      cam->burst_running = 1;
+      __sync_synchronize();
+      thread_detach(run_burst,cam);
+      sprintf(answer,"%u",cam->burst_n);
+    }
+  } else
   if (!strcasecmp(cmd,"stop")) {
-    if (zwo_state == ZWO_VIDEO) { int i;
-      zwo_state = ZWO_IDLE;
+    if (cam->zwo_state == ZWO_BURST) { int i;
+      cam->zwo_state = ZWO_IDLE;            /* run_burst aborts the exposure */
+      for (i=0; cam->burst_running && (i<3000); i++) msleep(10);
+    } else
+    if (cam->zwo_state == ZWO_VIDEO) { int i;
+      cam->zwo_state = ZWO_IDLE;
+      cam->track_state = TRK_OFF;
       /* wait for run_video to leave ASIGetVideoData() first: the SDK */
       /* is not thread-safe and StopVideoCapture during GetVideoData  */
       /* corrupts the heap (SEGV in a later realloc)                  */
-      for (i=0; video_running && (i<3000); i++) msleep(10);
-      err = handle_asi("ASIStopVideoCapture",answer,buflen);
+      for (i=0; cam->video_running && (i<3000); i++) msleep(10);
+      err = handle_asi(cam,"ASIStopVideoCapture",answer,buflen);
+      for (i=0; cam->rec_running && (i<300); i++) msleep(10);
       msleep(350);   /* let SDK worker threads settle, cf. 'start' */
     }
   } else
   if (!strcasecmp(cmd,"write")) { 
-    handle_command("data 0",answer,buflen);
-    assert(asi_size == 0);
+    handle_command(cam,"data 0",answer,buflen);
+    assert(tx->size == 0);
     int size = atoi(answer);
-    if (size != zwo_w*zwo_h*zwo_bits/8) {
+    if (size != cam->zwo_w*cam->zwo_h*cam->zwo_bits/8) {
       err = E_no_data;
     } else {
-      handle_command("tempcon",buf,sizeof(buf));
-      FITS *f = fits_create(zwo_w,zwo_h,zwo_bits);
-      f->bitpix = zwo_bits;
-      if (zwo_bits == 8) f->bzero = 0;
+      handle_command(cam,"tempcon",buf,sizeof(buf));
+      FITS *f = fits_create(cam->zwo_w,cam->zwo_h,cam->zwo_bits);
+      f->bitpix = cam->zwo_bits;
+      if (cam->zwo_bits == 8) f->bzero = 0;
       if (n > 1) runNumber = atoi(par1);
       sprintf(answer,"%s/zwo%04d.fits",dataPath,runNumber);
       if (fits_open(f,answer) == 0) { struct tm res;
-        time_t ut = (int)asi_startTime - offtime;
+        time_t ut = (int)cam->asi_startTime - offtime;
         gmtime_r(&ut,&res);
         strftime(buf,32,"%FT%H:%M:%S",&res);
-        fits_char (f,"INSTRUME",zwo_model,NULL);
+        fits_char (f,"INSTRUME",cam->zwo_model,NULL);
         fits_char (f,"DATE-OBS",buf,NULL);
         fits_float(f,"EPOCH",get_epoch(ut),5,"epoch (start)");
-        fits_float(f,"EXPTIME",asi_expTime,3,"exposure time");
-        fits_int  (f,"BINNING",zwo_bin,"binning");
-        sprintf(buf,"[%d:%d,%d:%d]",1+zwo_x,zwo_x+zwo_w,1+zwo_y,zwo_y+zwo_h);
+        fits_float(f,"EXPTIME",cam->asi_expTime,3,"exposure time");
+        fits_int  (f,"BINNING",cam->zwo_bin,"binning");
+        sprintf(buf,"[%d:%d,%d:%d]",1+cam->zwo_x,cam->zwo_x+cam->zwo_w,
+                1+cam->zwo_y,cam->zwo_y+cam->zwo_h);
         fits_char (f,"WINDOW",buf,"window"); 
         fits_char (f,"COMMENT","","no comment");
-        fits_float(f,"TEMPCCD",asi_temperature,2,"CCD temperature [C]");
-        fits_float(f,"COOLCCD",asi_cooler_power,0,"CCD cooler [%]");
+        fits_float(f,"TEMPCCD",cam->asi_temperature,2,"CCD temperature [C]");
+        fits_float(f,"COOLCCD",cam->asi_cooler_power,0,"CCD cooler [%]");
         fits_char (f,"SOFTWARE",P_VERSION,NULL);
         fits_char (f,"FITSVERS","0.019",NULL);
         fits_endHeader(f);
-        fits_writeData(f,asi_data);
+        fits_writeData(f,tx->data);
         fits_close(f);
         fits_free(f);
         runNumber = (1+runNumber) % 10000;
@@ -772,32 +1466,32 @@ static int handle_command(const char* command,char* answer,size_t buflen)
     }
   } else
   if (!strcasecmp(cmd,"close")) {
-    if (zwo_state != ZWO_CLOSED) {
-      err = handle_asi("ASICloseCamera",answer,buflen);
-      zwo_state = ZWO_CLOSED;
+    if (cam->zwo_state != ZWO_CLOSED) {
+      err = handle_asi(cam,"ASICloseCamera",answer,buflen);
+      cam->zwo_state = ZWO_CLOSED;
     }
   } else
   if (!strcasecmp(cmd,"tempcon")) {
     if (n > 1) { int v=1;
       if (!strcmp(par1,"off")) v = 0;
       sprintf(buf,"ASISetControlValue %d %d",ASI_COOLER_ON,v);
-      err = handle_asi(buf,answer,buflen);
+      err = handle_asi(cam,buf,answer,buflen);
       if (!err) {
         if (v) { 
           int t = (int)floor(0.5+atof(par1));
           sprintf(buf,"ASISetControlValue %d %d",ASI_TARGET_TEMP,t);
-          handle_asi(buf,answer,buflen); // bug-fix v0026
+          handle_asi(cam,buf,answer,buflen); // bug-fix v0026
         } else {
-          asi_cooler_power = 0;          /* NEW v0032 */
+          cam->asi_cooler_power = 0;          /* NEW v0032 */
         }
       }
     } else { int v; float t,p;
       sprintf(buf,"ASIGetControlValue %d",ASI_TEMPERATURE);
-      if (!err) err = handle_asi(buf,answer,buflen);
+      if (!err) err = handle_asi(cam,buf,answer,buflen);
       if (!err) sscanf(answer,"%ld %d",&err,&v);
       if (!err) t = (float)v/10.0f;
       sprintf(buf,"ASIGetControlValue %d",ASI_COOLER_POWER_PERC);
-      if (!err) err = handle_asi(buf,answer,buflen);
+      if (!err) err = handle_asi(cam,buf,answer,buflen);
       if (!err) sscanf(answer,"%ld %d",&err,&v);
       if (!err) p = (float)v;
       if (!err) sprintf(answer,"%.1f %.0f",t,p);
@@ -812,14 +1506,14 @@ static int handle_command(const char* command,char* answer,size_t buflen)
       if (!strcmp(par1,"on")) {
         v = 1;
       } else {
-        strcpy(answer,"-Einvalid fan state");
+        strcpy(answer,"-Einvalid fan state\n");
         return 0;
       }
       sprintf(buf,"ASISetControlValue %d %d",ASI_FAN_ON,v);
-      err = handle_asi(buf,answer,buflen);
+      err = handle_asi(cam,buf,answer,buflen);
     }
     sprintf(buf,"ASIGetControlValue %d",ASI_FAN_ON);
-    err = handle_asi(buf,answer,buflen);
+    err = handle_asi(cam,buf,answer,buflen);
     if (!err) sscanf(answer,"%d",&err,&v);
     if (!err) sprintf(answer,"%d",v);
   } else
@@ -907,19 +1601,53 @@ static int receive_string(int sock,char* string,size_t buflen)
 
 /* --- */
 
+/* a client may open a 'control' connection beside its data connection:
+ * housekeeping there never waits behind a frame transfer; it sends no
+ * binary data and does not count in 'nconn': the camera is closed when
+ * its last data connection hangs up. Anything but housekeeping runs on
+ * the one data connection that holds the camera's 'conn_lock'; another
+ * one waits for it (as connections did when served one at a time) */
 typedef struct {
-  char host[128];
-  int  port,msgsock;
+  char  host[128];
+  int   port,msgsock;
+  int   control;
+  Camera *owner;                       /* its 'conn_lock' is held */
+  TxBuf tx;                            /* binary answers */
 } Connection;
+
+static int housekeeping(const char* cmd)   /* also on 'control' */
+{
+  static const char *list[]={"version","status","exptime","gain","offset",
+                             "tempcon","fancon","stalls","vtrace","rt",NULL};
+  int  i;
+  char c[16]="";
+
+  sscanf(cmd,"%15s",c);
+  for (i=0; list[i]; i++) if (!strcasecmp(c,list[i])) return 1;
+  return 0;
+}
   
 /* --- */
 
+static void conn_release(Connection* c)
+{
+  if (c->owner) pthread_mutex_unlock(&c->owner->conn_lock);
+  c->owner = NULL;
+}
+
+/* --- */
+
 static void* run_connection(void* param)
 {
   Connection *c = (Connection*)param;
+  Camera *cam = &cams[0];              /* until 'camera' */
   int  rval,r;
   long done=0;
-  char cmd[128],buf[256];
+  char cmd[128],buf[1024];             /* 'next' with 'stats' histogram */
+
+  if (net_cpu >= 0) rt_thread(0,net_cpu,NULL);
+  conn_tx = &c->tx;
+  __sync_fetch_and_add(&cam->nconn,1);
 
   do {
     rval = receive_string(c->msgsock,cmd,sizeof(cmd));
@@ -928,12 +1656,40 @@ static void* run_connection(void* param)
       sprintf(buf,"%s(): received '%s'",PREFUN,cmd);
       message(NULL,buf,MSS_FILE);
 #endif
-      r =  handle_command(cmd,buf,sizeof(buf));
+      if (!strncasecmp(cmd,"camera",6) && (!cmd[6] || (cmd[6] == ' '))) {
+        Camera *prev = cam;
+        r = select_camera(&cam,cmd,buf);
+        if (!c->control && (cam != prev)) {
+          __sync_fetch_and_add(&cam->nconn,1);
+          __sync_fetch_and_sub(&prev->nconn,1);
+          conn_release(c);
+        }
+      } else
+      if (!strcasecmp(cmd,"control")) {
+        if (!c->control) __sync_fetch_and_sub(&cam->nconn,1);
+        c->control = 1; r = 0;
+        conn_release(c);
+        strcpy(buf,"OK\n");
+      } else
+      if (c->control && !housekeeping(cmd)) {
+        r = 0;
+        strcpy(buf,"-Edata connection only\n");
+      } else {
+        if (!c->control && !c->owner && !housekeeping(cmd)) {
+          pthread_mutex_lock(&cam->conn_lock);  /* one data connection */
+          c->owner = cam;
+        }
+        if (!strncasecmp(cmd,"tune",4) && (!cmd[4] || (cmd[4] == ' '))) {
+          r = tune_camera(cam,cmd,buf,link_rate(c->msgsock));
+        } else {
+          r = handle_command(cam,cmd,buf,sizeof(buf));
+        }
+      }
       send(c->msgsock,buf,strlen(buf),MSG_NOSIGNAL);
       if (r == 0) {
-        if (asi_size) {
-          send(c->msgsock,asi_data,asi_size,MSG_NOSIGNAL);
-          asi_size = 0;
+        if (c->tx.size && !c->control) {
+          send(c->msgsock,c->tx.data,c->tx.size,MSG_NOSIGNAL);
+          c->tx.size = 0;
         }
       } else
       if (r == 2) {                    /* reboot MinnowBoard */
@@ -956,13 +1712,20 @@ static void* run_connection(void* param)
         exit(0);
       }
     } else {
-      sprintf(buf,"%s(%s): hangup",PREFUN,c->host);
+      int left = (c->control) ? -1 : __sync_sub_and_fetch(&cam->nconn,1);
+      sprintf(buf,"%s(%s): hangup%s",PREFUN,c->host,
+              (c->control) ? " (control)" : (left > 0) ? ", camera in use" : "");
       message(NULL,buf,MSS_FLUSH);
-      if (zwo_state != ZWO_CLOSED) ASICloseCamera(asi_id);
-      zwo_state = ZWO_CLOSED;
+      if (left == 0) {                 /* last data connection */
+        if (!c->owner) { pthread_mutex_lock(&cam->conn_lock); c->owner = cam; }
+        if (cam->zwo_state != ZWO_CLOSED) ASICloseCamera(cam->asi_id);
+        cam->zwo_state = ZWO_CLOSED;
+      }
+      conn_release(c);
     }
   } while (rval > 0);                  /* while there's something */
   (void)close(c->msgsock);
+  free((void*)c->tx.data);
   free((void*)c);
 
   return (void*)done;
@@ -1012,11 +1775,10 @@ static void* run_tcpip(void* param)
     strcpy(c->host,host);
     c->port = port;
     c->msgsock = msgsock;
-    if (tcpDebug) {                    /* allow mult. connections */
-      thread_detach(run_connection,(void*)c);
-    } else {                           /* single connection */
-      run_connection((void*)c);
-    }
+    c->control = 0;
+    c->owner = NULL;
+    c->tx.data = NULL; c->tx.size = c->tx.cap = 0;
+    thread_detach(run_connection,(void*)c); /* one per camera, + control */
   } /* while(!done) */
 
   (void)close(sock);
@@ -1027,6 +1789,240 @@ static void* run_tcpip(void* param)
   return (void*)0;
 }
 
+/* ---------------------------------------------------------------- */
+/* defaults of camera #'index' (its ASI ID is known at 'open')       */
+
+static void cam_init(Camera* cam,int index)
+{
+  memset(cam,0,sizeof(Camera));
+  cam->index = cam->asi_id = index;
+  cam->zwo_state = ZWO_CLOSED;
+  cam->zwo_bitDepth = 12;
+  strcpy(cam->zwo_model,"ZWO");
+  cam->asi_offset = 10;
+  cam->asi_usb = 40;                   /* SDK default */
+  cam->fpool.budget = pool_budget;
+  pthread_mutex_init(&cam->geo_lock,NULL);
+  pthread_mutex_init(&cam->conn_lock,NULL);
+  calib_init(&cam->calib);
+  frec_init(&cam->rec);
+  cam->aexp.target = 0.5;
+  cam->aexp.pct = 100;
+  cam->aexp.emin = 0.0001;
+  cam->aexp.emax = 1.0;
+  cam->aexp.gmin = cam->aexp.gmax = -1;
+  cam->pv_width = PREVIEW_WIDTH;
+  cam->pv_rate = PREVIEW_RATE;
+  cam->track_box = TRACK_BOX;
+  cam->video_mode = VM_ADAPT;
+  cam->rt_prio = opt_prio;
+  cam->rt_cpu = (opt_cpu < 0) ? -1 : opt_cpu+index; /* one CPU each */
+  strcpy(cam->rt_status,"other:0:-1");
+  cam->burst_depth = 2;
+}
+
+/* ---------------------------------------------------------------- */
+/* rc-file key: camera #0 as before, "key_#" for the others          */
+
+static const char* cam_key(const Camera* cam,const char* key,char* buf)
+{
+  if (cam->index == 0) return key;
+  sprintf(buf,"%s_%d",key,cam->index);
+  return buf;
+}
+
+/* ---------------------------------------------------------------- */
+/* 'camera [#|serial]': selects the camera of this connection by     */
+/* index or serial number; returns "index ncameras serial"           */
+
+static int select_camera(Camera** pcam,const char* command,char* answer)
+{
+  int  i,n;
+  char buf[128],par1[128]="",*end;
+
+  n = imin(ASIGetNumOfConnectedCameras(),CAM_NMAX);
+  if (sscanf(command,"%*s %127s",par1) == 1) {
+    i = (int)strtol(par1,&end,10);
+    if (*end || (strlen(par1) > 2)) {  /* serial number */
+      for (i=0; i<n; i++) { Camera *c=&cams[i];
+        if (!c->serial[0] && (c->zwo_state == ZWO_CLOSED) &&
+            !handle_asi(c,"ASIOpenCamera",buf,sizeof(buf))) {
+          handle_asi(c,"ASIGetSerialNumber",buf,sizeof(buf));
+          (void)ASICloseCamera(c->asi_id);
+        }
+        if (!strcasecmp(c->serial,par1)) break;
+      }
+    }
+    if ((i < 0) || (i >= n)) {
+      sprintf(answer,"-Eerr=%d\n",E_no_camera);
+      return 0;
+    }
+    *pcam = &cams[i];
+  }
+  sprintf(answer,"%d %d %s\n",(*pcam)->index,n,
+          ((*pcam)->serial[0]) ? (*pcam)->serial : "-");
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+/* speed [MB/s] of the network interface that carries 'sock', from  */
+/* /sys/class/net; 0 if unknown or loopback (no limit)               */
+
+static double link_rate(int sock)
+{
+  struct sockaddr_in sa;
+  struct ifaddrs *ifa,*p;
+  socklen_t len=sizeof(sa);
+  double   mbps=0;
+  char     buf[128];
+
+  if (getsockname(sock,(struct sockaddr*)&sa,&len) ||
+      (sa.sin_family != AF_INET)) return 0;
+  if (getifaddrs(&ifa)) return 0;
+  for (p=ifa; p; p=p->ifa_next) {
+    if (!p->ifa_addr || (p->ifa_addr->sa_family != AF_INET)) continue;
+    if (((struct sockaddr_in*)p->ifa_addr)->sin_addr.s_addr !=
+        sa.sin_addr.s_addr) continue;
+    if (!(p->ifa_flags & IFF_LOOPBACK)) {
+      sprintf(buf,"/sys/class/net/%.64s/speed",p->ifa_name);
+      FILE *fp = fopen(buf,"r");
+      if (fp) {
+        if (fscanf(fp,"%lf",&mbps) != 1) mbps = 0;
+        fclose(fp);
+      }
+    }
+    break;
+  }
+  freeifaddrs(ifa);
+
+  return (mbps > 0) ? mbps/8 : 0;
+}
+
+/* ---------------------------------------------------------------- */
+/* frame period [s] of a 'w'x'h' window centred on 'cx','cy' [sensor */
+/* px]; streams for 't' seconds, leaves the window set up (idle)     */
+
+static double tune_period(Camera* cam,int cx,int cy,int w,int h,int bin,
+                          int bits,double t)
+{
+  u_int  s0,s1,s2;
+  unsigned long long t1,t2;
+  double t0;
+  char   buf[128];
+
+  cam->zwo_w = w; cam->zwo_h = h; cam->zwo_bin = bin; cam->zwo_bits = bits;
+  cam->zwo_x = imax(0,imin(cx/bin-w/2,cam->zwo_width/bin-w)) & ~1;
+  cam->zwo_y = imax(0,imin(cy/bin-h/2,cam->zwo_height/bin-h)) & ~1;
+  handle_command(cam,"setup -",buf,sizeof(buf));   /* not stored */
+  if (buf[0] == '-') return -1;
+  handle_command(cam,"start",buf,sizeof(buf));
+  if (buf[0] == '-') return -1;
+
+  s0 = cam->video_seq; t0 = walltime(0);  /* skip the first frames */
+  while ((cam->video_seq < s0+2) && (walltime(0)-t0 < 2+2*cam->asi_expTime)) {
+    msleep(1);
+  }
+  s1 = cam->video_seq;
+  __sync_synchronize();
+  t1 = cam->video_ts[s1 % cam->fpool.n];
+  msleep((int)(1000*t));
+  s2 = cam->video_seq;
+  __sync_synchronize();
+  t2 = cam->video_ts[s2 % cam->fpool.n];
+  handle_command(cam,"stop",buf,sizeof(buf));
+
+  return (s2 > s1) ? (double)(t2-t1)/1.0e9/(s2-s1) : -1;
+}
+
+/* ---------------------------------------------------------------- */
+/* 'tune fps=N [box=W]': readout model per binning from a short      */
+/* sweep, period = max(floor,a+b*rows); then the lowest binning      */
+/* whose largest square window at 'fps' is >= 'box' [sensor px] and  */
+/* fits the link 'link' [MB/s] (0: no limit), at 16 bits if that     */
+/* fits, else 8; centred on the current window and set up (not       */
+/* stored); returns "x y w h bin bits predicted measured" [fps]      */
+
+#define TUNE_TIME       0.3            /* [s] per sweep point */
+#define TUNE_LINK       0.9            /* usable part of the link */
+#define TUNE_EXPTIME    0.0001         /* [s] during the sweep */
+
+static int tune_camera(Camera* cam,const char* command,char* answer,
+                       double link)
+{
+  static const int rows[3]={32,256,1024};
+  Geometry g0;
+  int    box=0,bin,bits=16,i,k,r[3],s=0,cx,cy,aon,fail=0;
+  double fps=0,p[3],a=0,b=0,e0=cam->asi_expTime,pred,meas;
+  char   buf[128],par[128];
+  const char *c=command;
+
+  while (sscanf(c,"%127s%n",par,&k) == 1) {
+    c += k;
+    if (!strncasecmp(par,"fps=",4)) fps = atof(par+4);
+    if (!strncasecmp(par,"box=",4)) box = atoi(par+4);
+  }
+  if ((fps <= 0) || (box < 0)) {
+    strcpy(answer,"-Einvalid tune\n"); return 0;
+  }
+  if (cam->zwo_state != ZWO_IDLE) {
+    sprintf(answer,"-Eerr=%d\n",
+            (cam->zwo_state == ZWO_CLOSED) ? E_not_open : E_not_idle);
+    return 0;
+  }
+  g0.x = cam->zwo_x; g0.y = cam->zwo_y; g0.w = cam->zwo_w; g0.h = cam->zwo_h;
+  g0.bin = cam->zwo_bin; g0.bits = cam->zwo_bits;
+  cx = (g0.x+g0.w/2)*g0.bin; cy = (g0.y+g0.h/2)*g0.bin;
+  aon = cam->aexp.on; cam->aexp.on = 0;     /* keep the exposure */
+  sprintf(buf,"exptime %.6f",TUNE_EXPTIME);
+  handle_command(cam,buf,answer,128);
+
+  for (bin=1; bin<=4; bin*=2) {
+    for (i=0; i<3; i++) {
+      r[i] = imin(rows[i],cam->zwo_height/bin) & ~1;
+      p[i] = tune_period(cam,cx,cy,imin(256,cam->zwo_width/bin) & ~7,r[i],
+                         bin,16,TUNE_TIME);
+      if (p[i] <= 0) break;
+    }
+    if (i < 3) { fail = 1; break; }    /* camera error */
+    b = (r[2] > r[1]) ? fmax(0,(p[2]-p[1])/(r[2]-r[1])) : 0;
+    a = p[2]-b*r[2];
+    sprintf(buf,"tune(%d): bin %d: floor %.2f ms, %.2f ms + %.2f us/row",
+            cam->index,bin,1000*p[0],1000*a,1.0e6*b);
+    message(NULL,buf,MSS_FLUSH);
+    if (p[0] > 1/fps) continue;        /* not even a small window */
+    s = (b > 0) ? (int)fmin((1/fps-a)/b,1.0e5) : cam->zwo_height/bin;
+    s = imin(s,imin(cam->zwo_width,cam->zwo_height)/bin);
+    bits = 16;
+    if (link > 0) { double lim=TUNE_LINK*link*1.0e6/fps;   /* bytes/frame */
+      if ((double)s*s > lim) s = (int)sqrt(lim);
+      if ((double)s*s*2 > lim) bits = 8;
+    }
+    s &= ~7;
+    if ((s >= 8) && (s*bin >= box)) break;
+  }
+
+  sprintf(buf,"exptime %.6f",e0);
+  handle_command(cam,buf,answer,128);
+  cam->aexp.on = aon;
+  if (fail || (bin > 4)) {             /* back to the old window */
+    cam->zwo_x = g0.x; cam->zwo_y = g0.y; cam->zwo_w = g0.w; cam->zwo_h = g0.h;
+    cam->zwo_bin = g0.bin; cam->zwo_bits = g0.bits;
+    handle_command(cam,"setup -",buf,sizeof(buf));
+    strcpy(answer,(fail) ? "-Etune failed\n" : "-Efps not reachable\n");
+    return 0;
+  }
+  pred = 1/fmax(e0,fmax(p[0],a+b*s));
+  meas = tune_period(cam,cx,cy,s,s,bin,bits,3*TUNE_TIME+3*e0);
+  meas = (meas > 0) ? 1/meas : 0;
+  sprintf(answer,"%d %d %d %d %d %d %.1f %.1f",cam->zwo_x,cam->zwo_y,
+          cam->zwo_w,cam->zwo_h,cam->zwo_bin,cam->zwo_bits,pred,meas);
+  sprintf(buf,"tune(%d): %.100s",cam->index,answer);
+  message(NULL,buf,MSS_FLUSH);
+  strcat(answer,"\n");
+
+  return 0;
+}
+
 /* ---------------------------------------------------------------- */
 
 static unsigned long long time_ns(void) /* TS_CLOCK in nanoseconds */
@@ -1039,40 +2035,682 @@ static unsigned long long time_ns(void) /* TS_CLOCK in nanoseconds */
 
 /* ---------------------------------------------------------------- */
 
+/* ASI_IMG_TYPE for 'bits' */
+
+static int img_type(Camera* cam,int bits)
+{
+  if (cam->zwo_color) {
+    return (bits==8) ? ASI_IMG_Y8 : (bits==16) ? ASI_IMG_RAW16 : ASI_IMG_RGB24;
+  }
+  return (bits==8) ? ASI_IMG_RAW8 : ASI_IMG_RAW16;
+}
+
+/* ---------------------------------------------------------------- */
+/* window 'g' must fit the sensor (-1 if not) and the frame pool      */
+
+static int geo_check(Camera* cam,int x,int y,int w,int h,int bin,int bits,
+                     Geometry* g)
+{
+  w -= w % 8; h -= h % 2;
+  if ((bin < 1) || (bin > 4) || ((bits != 8) && (bits != 16)) ||
+      (w < 8) || (h < 2) || (x < 0) || (y < 0) ||
+      ((x+w)*bin > cam->zwo_width) || ((y+h)*bin > cam->zwo_height)) return -1;
+  if ((size_t)w*h*bits/8+SDK_BUF_PAD > cam->fpool.slot) return E_no_memory;
+
+  g->x = x; g->y = y; g->w = w; g->h = h; g->bin = bin; g->bits = bits;
+  g->type = img_type(cam,bits);
+
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+/* new window while streaming, applied by run_video before the next */
+/* frame; returns -1 or E_no_memory if it does not fit (geo_check)   */
+
+static int geo_request(Camera* cam,int x,int y,int w,int h,int bin,int bits)
+{
+  Geometry g;
+  int      err;
+
+  if ((err = geo_check(cam,x,y,w,h,bin,bits,&g)) != 0) return err;
+
+  pthread_mutex_lock(&cam->geo_lock);
+  cam->geo_next = g;
+  cam->geo_pending = 1;
+  pthread_mutex_unlock(&cam->geo_lock);
+
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+/* wait up to 'timeout' [s] for a frame newer than 'video_last'      */
+
+static int video_wait(Camera* cam,double timeout)
+{
+  double t1 = walltime(0);
+
+  while (cam->video_seq <= cam->video_last) {    /* b0025 */
+    if (walltime(0)-t1 >= timeout) break;
+    msleep(1);   /* 5ms quantum capped video at ~194 fps */
+  }
+  return (cam->video_seq > cam->video_last);
+}
+
+/* ---------------------------------------------------------------- */
+/* 'track' step on a frame of window 'g' (run_video): acquire, then  */
+/* keep the star centred; positions in binned sensor pixels          */
+
+static void track_frame(Camera* cam,const u_char* data,const Geometry* g)
+{
+  int    x,y;
+  char   buf[128];
+  u_int  sat=track_sat(g->bits,cam->zwo_bitDepth);
+  double c=(cam->track_box-1)/2.0;          /* window centre */
+  TrackStar s;
+
+  cam->track_now.on = 1;
+  if (cam->track_state == TRK_ACQUIRE) {
+    cam->track_now.st = 0;
+    if ((g->w != cam->track_acq.w) || (g->h != cam->track_acq.h)) {
+      return;                          /* old window in flight */
+    }
+    if (track_find(data,g->w,g->h,g->bits,cam->track_box/2,sat,&s)) return;
+    cam->track_x0 = cam->track_now.x = g->x+s.x;
+    cam->track_y0 = cam->track_now.y = g->y+s.y;
+    cam->track_now.dx = cam->track_now.dy = 0;
+    cam->track_now.flux = s.flux;
+    x = imax(0,imin((int)floor(cam->track_now.x-c+0.5),
+                    cam->zwo_width/g->bin-cam->track_box)) & ~1;
+    y = imax(0,imin((int)floor(cam->track_now.y-c+0.5),
+                    cam->zwo_height/g->bin-cam->track_box)) & ~1;
+    if (geo_request(cam,x,y,cam->track_box,cam->track_box,g->bin,g->bits)) {
+      return;
+    }
+    sprintf(buf,"%s(%d): star at %.1f %.1f (peak=%.0f, bg=%.0f), window %d %d",
+            PREFUN,cam->index,cam->track_now.x,cam->track_now.y,
+            s.peak,s.bg,x,y);
+    message(NULL,buf,MSS_FLUSH);
+    cam->track_lost = 0;
+    cam->track_state = TRK_TRACK;
+  } else {
+    if ((g->w != cam->track_box) || (g->h != cam->track_box)) {
+      return;                          /* acquisition frame in flight */
+    }
+    if (track_centroid(data,g->w,g->h,g->bits,0,0,g->w,g->h,&s)) {
+      cam->track_now.st = -1;
+      if (++cam->track_lost >= TRACK_LOST) {
+        sprintf(buf,"%s(%d): star lost, re-acquire",PREFUN,cam->index);
+        message(NULL,buf,MSS_FLUSH);
+        (void)geo_request(cam,cam->track_acq.x,cam->track_acq.y,
+                          cam->track_acq.w,cam->track_acq.h,
+                          cam->track_acq.bin,cam->track_acq.bits);
+        cam->track_state = TRK_ACQUIRE;
+      }
+      return;
+    }
+    cam->track_lost = 0;
+    cam->track_now.st = 1;
+    cam->track_now.x  = g->x+s.x;
+    cam->track_now.y  = g->y+s.y;
+    cam->track_now.flux = s.flux;
+    cam->track_now.dx = cam->track_now.x-cam->track_x0;
+    cam->track_now.dy = cam->track_now.y-cam->track_y0;
+    /* re-centre once the last move took effect */
+    if (!cam->geo_pending && (g->x == cam->zwo_x) && (g->y == cam->zwo_y) &&
+        ((fabs(s.x-c) > cam->track_box/TRACK_RECENTRE) ||
+         (fabs(s.y-c) > cam->track_box/TRACK_RECENTRE))) {
+      x = imax(0,imin((int)floor(cam->track_now.x-c+0.5),
+                      cam->zwo_width/g->bin-cam->track_box)) & ~1;
+      y = imax(0,imin((int)floor(cam->track_now.y-c+0.5),
+                      cam->zwo_height/g->bin-cam->track_box)) & ~1;
+      if ((x != g->x) || (y != g->y)) {
+        (void)geo_request(cam,x,y,g->w,g->h,g->bin,g->bits);
+      }
+    }
+  }
+}
+
+/* ---------------------------------------------------------------- */
+/* 'auto' step on a frame of window 'g' (run_video): the brightness  */
+/* exptime*gain (gain in 0.1 dB) goes to the limits in that order    */
+
+static void auto_frame(Camera* cam,const u_char* data,const Geometry* g)
+{
+  int    x,y,w,h,gain;
+  char   buf[128],ans[128];
+  double r,e,b,full=(g->bits == 8) ? 255 : 65535;
+  u_int  sat=(g->bits == 8) ? 255 : 65520;
+  AutoExp *a=&cam->aexp;
+  FrameStats fs;
+
+  if (a->settle > 0) { a->settle--; return; }
+  x = imax(0,a->x-g->x); w = imin(g->w,a->x-g->x+a->w)-x;
+  y = imax(0,a->y-g->y); h = imin(g->h,a->y-g->y+a->h)-y;
+  if ((a->w <= 0) || (w <= 0) || (h <= 0)) {   /* whole window */
+    x = y = 0; w = g->w; h = g->h;
+  }
+  fstats_region(data,g->w,x,y,w,h,g->bits,0,a->pct,&fs);
+  a->level = fs.pval/full;
+
+  if (fs.pval >= sat) {                /* saturated: level unknown */
+    r = 1/AUTO_STEP;
+  } else
+  if (fs.pval-fs.bg <= fmax(3*fs.noise,1)) { /* starved */
+    r = AUTO_STEP;
+  } else {
+    r = (a->target*full-fs.bg)/(fs.pval-fs.bg);
+    if (fabs(r-1) <= AUTO_BAND) return;
+  }
+  r = fmax(1/AUTO_STEP,fmin(AUTO_STEP,r));
+
+  b = cam->asi_expTime*pow(10,cam->asi_gain/200.0)*r;
+  gain = a->gmin;                      /* exposure first: S/N per frame */
+  if (b > a->emax*pow(10,gain/200.0)) {
+    gain = imax(a->gmin,imin(a->gmax,(int)ceil(200*log10(b/a->emax))));
+  }
+  e = fmax(a->emin,fmin(a->emax,b/pow(10,gain/200.0)));
+  if ((fabs(e-cam->asi_expTime) < 1.0e-6) && (gain == cam->asi_gain)) {
+    return;                            /* at a limit */
+  }
+  sprintf(buf,"exptime %.6f",e);       /* no stop/start */
+  handle_command(cam,buf,ans,sizeof(ans));
+  if (gain != cam->asi_gain) {
+    sprintf(buf,"gain %d",gain);
+    handle_command(cam,buf,ans,sizeof(ans));
+  }
+  a->settle = AUTO_SETTLE;
+  a->steps++;
+#if (DEBUG > 1)
+  fprintf(stderr,"%s(%d): level=%.3f r=%.2f -> %.6f s, gain %d\n",PREFUN,
+          cam->index,a->level,r,e,gain);
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+/* 'preview' thumbnail of the frame 'data' just published (run_video) */
+
+static void preview_frame(Camera* cam,const u_char* data,const Geometry* g,
+                          unsigned long long ts)
+{
+  int   k = (cam->pv_seq+1) & 1;
+  Thumb *t = &cam->pv_tag[k];
+
+  t->f = thumb_factor(g->w,g->h,cam->pv_width,&t->tw,&t->th);
+  thumb_make(data,g->w,g->h,g->bits,t->f,cam->pv_mode,
+             cam->pv_buf+k*THUMB_WMAX*THUMB_WMAX);
+  t->seq = cam->video_seq;
+  t->ts = ts;
+  t->g = *g;
+  __sync_synchronize();  /* thumbnail visible before seq (arm64) */
+  cam->pv_seq++;
+  cam->pv_t = ts;
+}
+
+/* ---------------------------------------------------------------- */
+/* published frame 'seq' from its pool slot into the flight recorder */
+/* (run_record), then the 'track' triggers: star lost, centroid jump, */
+/* flux drop                                                          */
+
+static void record_frame(Camera* cam,u_int seq)
+{
+  FrecFrame f;
+  TrackTag tt=cam->video_track[seq % cam->fpool.n],*t=&tt,*p=&cam->rec_prev;
+  Geometry g=cam->video_geom[seq % cam->fpool.n];
+  unsigned long long pos;
+  u_char   *dst;
+  char     why[128]="";
+  double   d;
+
+  f.seq = seq; f.ts = cam->video_ts[seq % cam->fpool.n];
+  f.x = g.x; f.y = g.y; f.w = g.w; f.h = g.h;
+  f.bin = g.bin; f.bits = g.bits;
+  f.exptime = cam->asi_expTime; f.gain = cam->asi_gain;
+  f.st = (t->on) ? t->st : 2;
+  f.cx = t->x; f.cy = t->y; f.flux = t->flux;
+  if ((dst = frec_reserve(&cam->rec,&f,&pos)) != NULL) {
+    memcpy(dst,fpool_slot(&cam->fpool,seq),(size_t)g.w*g.h*g.bits/8);
+    __sync_synchronize();  /* copied before reading seq (arm64) */
+    if (cam->video_seq-seq < (u_int)cam->fpool.n-1) {
+      frec_commit(&cam->rec,&f,pos);
+    } else {                           /* run_video reused the slot */
+      frec_lost(&cam->rec,1);
+    }
+  }
+
+  if (t->on && ((cam->rec_jump > 0) || (cam->rec_drop > 0))) {
+    if ((p->st == 1) && (t->st == -1)) {
+      strcpy(why,"star lost");
+    } else
+    if ((p->st == 1) && (t->st == 1)) {
+      d = hypot(t->x-p->x,t->y-p->y);
+      if ((cam->rec_jump > 0) && (d > cam->rec_jump)) {
+        sprintf(why,"jump %.2f px",d);
+      } else
+      if ((cam->rec_drop > 0) && (t->flux < cam->rec_drop*cam->rec_flux)) {
+        sprintf(why,"flux %.0f < %.2f*%.0f",t->flux,cam->rec_drop,
+                cam->rec_flux);
+      }
+    }
+    if (why[0] && !cam->rec.dumping) (void)record_dump(cam,why);
+  }
+  if (t->on && (t->st == 1)) {
+    cam->rec_flux = (cam->rec_flux > 0) ?
+                    cam->rec_flux+(t->flux-cam->rec_flux)/REC_FLUX_N : t->flux;
+  }
+  *p = *t;
+}
+
+/* ---------------------------------------------------------------- */
+/* dump the flight recorder to $HOME/rec[_#]_<UT>.raw/.txt; returns  */
+/* the number of frames, -1 if busy or empty                         */
+
+static int record_dump(Camera* cam,const char* why)
+{
+  int    k;
+  char   buf[128],path[512],ut[32];
+  struct tm res;
+  time_t now=time(NULL);
+
+  gmtime_r(&now,&res);
+  strftime(ut,sizeof(ut),"%Y%m%dT%H%M%S",&res);
+  sprintf(path,"%.400s/%.16s_%s",dataPath,cam_key(cam,"rec",buf),ut);
+  k = frec_dump(&cam->rec,path,why);
+  if (k >= 0) {
+    sprintf(buf,"%s(%d): %d frames (%.40s)",PREFUN,cam->index,k,why);
+    message(NULL,buf,MSS_FLUSH);
+  }
+  return k;
+}
+
+/* ---------------------------------------------------------------- */
+/* (re)size the frame pool for the current ROI, pre-faulted; a no-op */
+/* if the geometry did not change, or ('fit') if the ROI fits: keeps */
+/* a large pool so 'setup' while streaming can go back to a large ROI */
+
+static int pool_setup(Camera* cam,int fit)
+{
+  int    i,n;
+  char   buf[128];
+  size_t size=(size_t)cam->zwo_w*cam->zwo_h*cam->zwo_bits/8;
+
+  for (i=0; (cam->video_running || cam->rec_running ||
+             cam->burst_running) && (i<300); i++) {
+    msleep(10);
+  }
+  if (cam->video_running || cam->rec_running || cam->burst_running) {
+    return E_not_idle;
+  }
+  if (size == 0) return 0;
+  if (fit && cam->fpool.base && (size+SDK_BUF_PAD <= cam->fpool.slot)) return 0;
+
+  size_t slot=cam->fpool.slot;
+  n = fpool_setup(&cam->fpool,size,SDK_BUF_PAD,1);
+  if (n == 0) {
+    sprintf(buf,"%s(%d): %zu bytes failed",PREFUN,cam->index,size);
+    message(NULL,buf,MSS_FLUSH);
+    return E_no_memory;
+  }
+  if (cam->fpool.slot != slot) {
+    sprintf(buf,"%s(%d): %d x %.1f MB (budget %.0f MB)%s",PREFUN,
+            cam->index,n,
+            cam->fpool.slot/1048576.0,cam->fpool.budget/1048576.0,
+            (cam->fpool.huge) ? ", hugepages" : "");
+    message(NULL,buf,MSS_FLUSH);
+  }
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+/* (re)load the calibration masters of binning 'bin' from dataPath:  */
+/* zwo<serial>_<bin>_{bias,dark,flat}.fits and zwo<serial>_<bin>.bad */
+
+static int calib_setup(Camera* cam,int bin)
+{
+  int  nm;
+  char path[600],msg[256],buf[1024];
+
+  if (cam->serial[0]) sprintf(path,"%s/zwo%s_%d",dataPath,cam->serial,bin);
+  else                sprintf(path,"%s/zwo%d_%d",dataPath,cam->index,bin);
+  nm = calib_load(&cam->calib,path,bin,msg);
+  sprintf(buf,"%s(%d): %s: %s",PREFUN,cam->index,path,msg);
+  message(NULL,buf,MSS_FLUSH);
+  return nm;
+}
+
+/* ---------------------------------------------------------------- */
+/* 'stats' fields of 'next': " min max mean bg noise nsat [hist..]"; */
+/* always the same count, zeros if the frame had none (just 'on')    */
+
+static void stats_answer(const Camera* cam,const FrameStats* fs,char* answer)
+{
+  int  i;
+  char *p=answer+strlen(answer);
+
+  if (fs->n) p += sprintf(p," %u %u %.1f %.1f %.1f %u",fs->min,fs->max,
+                          fs->mean,fs->bg,fs->noise,fs->nsat);
+  else       p += sprintf(p," 0 0 0.0 0.0 0.0 0");
+  for (i=0; i<cam->stats_nhist; i++) {
+    p += sprintf(p," %u",(fs->n && (fs->nhist == cam->stats_nhist)) ?
+                 fs->hist[i] : 0);
+  }
+}
+
+/* ---------------------------------------------------------------- */
+/* buffer for 'data'/'next' of this connection, grows to 'size'; new */
+/* pages are touched here, not during the send                       */
+
+static u_char* frame_tx(TxBuf* tx,size_t size)
+{
+  size_t i,page=(size_t)sysconf(_SC_PAGESIZE);
+
+  if (size+SDK_BUF_PAD > tx->cap) {
+    tx->data = (u_char*)realloc(tx->data,size+SDK_BUF_PAD);
+    for (i=tx->cap; i<size+SDK_BUF_PAD; i+=page) tx->data[i] = 0;
+    tx->cap  = size+SDK_BUF_PAD;
+  }
+  return tx->data;
+}
+
+/* ---------------------------------------------------------------- */
+
+/* set the calling thread's policy and CPU affinity (cpu<0: any CPU, */
+/* threads inherit both from their creator); report in 'status'      */
+
+static void rt_thread(int prio,int cpu,char* status)
+{
+  int    e,i,policy;
+  char   buf[128];
+  cpu_set_t set;
+  struct sched_param sp;
+
+  sp.sched_priority = prio;
+  e = pthread_setschedparam(pthread_self(),(prio > 0) ? SCHED_FIFO : SCHED_OTHER,
+                            &sp);
+  if (e) {                             /* needs CAP_SYS_NICE or root */
+    sprintf(buf,"%s: SCHED_FIFO %d failed: %s",PREFUN,prio,strerror(e));
+    message(NULL,buf,MSS_FLUSH);
+  }
+  CPU_ZERO(&set);
+  if (cpu >= 0) CPU_SET(cpu,&set);
+  else for (i=0; i<sysconf(_SC_NPROCESSORS_ONLN); i++) CPU_SET(i,&set);
+  e = pthread_setaffinity_np(pthread_self(),sizeof(set),&set);
+  if (e) {
+    sprintf(buf,"%s: CPU %d failed: %s",PREFUN,cpu,strerror(e));
+    message(NULL,buf,MSS_FLUSH);
+    cpu = -1;
+  }
+  if (status) {
+    (void)pthread_getschedparam(pthread_self(),&policy,&sp);
+    sprintf(status,"%s:%d:%d",(policy == SCHED_FIFO) ? "fifo" : "other",
+            sp.sched_priority,cpu);
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
 static void* run_video(void* param)
 {
-  int    wait,ret,size=zwo_w*zwo_h*zwo_bits/8;
+  Camera *cam=(Camera*)param;
+  int    wait,ret,slice,adapt,overdue=0,restart=0;
+  int    size=cam->zwo_w*cam->zwo_h*cam->zwo_bits/8;
   time_t next=0;
   u_char *data;
   char   buf[128];
-
-  /* video_data1/2 are allocated by 'start' before this thread spawns */
-
-  while (zwo_state == ZWO_VIDEO) {
+  double period=0,pexp=cam->asi_expTime,late=0;
+  unsigned long long t_last=0;         /* last frame [ns] */
+  unsigned long long t_drop=0;         /* last ASIGetDroppedFrames [ns] */
+  Geometry geo={cam->zwo_x,cam->zwo_y,cam->zwo_w,cam->zwo_h,cam->zwo_bin,
+                cam->zwo_bits,img_type(cam,cam->zwo_bits)};
+
+  /* the frame pool is set up by 'start' before this thread spawns */
+
+  rt_thread(cam->rt_prio,cam->rt_cpu,cam->rt_status);
+
+  while (cam->zwo_state == ZWO_VIDEO) {
+    if (cam->geo_pending) {                 /* 'move'/'setup' between frames */
+      pthread_mutex_lock(&cam->geo_lock);
+      Geometry gn = cam->geo_next;
+      cam->geo_pending = 0;
+      pthread_mutex_unlock(&cam->geo_lock);
+      if ((gn.w != geo.w) || (gn.h != geo.h) || (gn.bin != geo.bin) ||
+          (gn.type != geo.type)) {     /* format: restart the capture */
+        (void)ASIStopVideoCapture(cam->asi_id);
+        ret = ASISetROIFormat(cam->asi_id,gn.w,gn.h,gn.bin,gn.type);
+        if (ret == ASI_SUCCESS) ret = ASISetStartPos(cam->asi_id,gn.x,gn.y);
+        if (ret != ASI_SUCCESS) {      /* back to the running window */
+          (void)ASISetROIFormat(cam->asi_id,geo.w,geo.h,geo.bin,geo.type);
+          (void)ASISetStartPos(cam->asi_id,geo.x,geo.y);
+        }
+        restart = 1;
+        t_last = 0; period = 0;        /* new frame period */
+      } else {                         /* SDK moves while capturing */
+        ret = ASISetStartPos(cam->asi_id,gn.x,gn.y);
+      }
+      if (ret == ASI_SUCCESS) {
+        geo = gn;
+        size = geo.w*geo.h*geo.bits/8;
+        cam->zwo_x = geo.x; cam->zwo_y = geo.y; cam->zwo_w = geo.w;
+        cam->zwo_h = geo.h; cam->zwo_bin = geo.bin; cam->zwo_bits = geo.bits;
+      } else {
+        sprintf(buf,"%s(%d): geometry %d %d %d %d %d failed, ret=%d",
+                PREFUN,cam->index,gn.x,gn.y,gn.w,gn.h,gn.bin,ret);
+        message(NULL,buf,MSS_FLUSH);
+      }
+    }
+    if (restart) {                     /* after a format change */
+      ret = ASIStartVideoCapture(cam->asi_id);
+      if (ret == ASI_SUCCESS) {
+        restart = 0;
+        msleep(350);                   /* SDK worker threads, cf. 'start' */
+      } else {
+        sprintf(buf,"%s(%d): restart failed, ret=%d",PREFUN,cam->index,ret);
+        message(NULL,buf,MSS_FLUSH);
+        msleep(100);
+        continue;                      /* again, unless stopped */
+      }
+    }
+    slice = (cam->video_mode == VM_SLICE) &&
+            (cam->asi_expTime > VIDEO_SLICE_EXP);
+    if (cam->asi_expTime != pexp) { period = 0; pexp = cam->asi_expTime; }
+    adapt = (cam->video_mode == VM_ADAPT) && (period > 0) && t_last;
     if (cor_time(0) < next) {   // v0026
-      msleep(5);
+      if (!slice && !adapt) msleep(5);
     } else {                    // update temp/cooler
-      handle_command("tempcon",buf,sizeof(buf));
+      handle_command(cam,"tempcon",buf,sizeof(buf));
+      (void)ASIGetDroppedFrames(cam->asi_id,&cam->video_dropped);
       next = cor_time(0)+30; // TODO every 30 seconds
     }
     /* keep the GetVideoData timeout short: the SDK's CirBuf::ReadBuff
      * occasionally misses a wakeup and sleeps the FULL timeout even
      * though the frame is ready (366ms stalls with the old 350ms
      * floor; stall length tracks this value) */
-    wait = 50+(int)(1000.0*asi_expTime);
+    wait = (slice) ? VIDEO_SLICE_MS : 50+(int)(1000.0*cam->asi_expTime);
+    if (adapt) {                       /* expected arrival + margin */
+      late = (double)(long long)(time_ns()-t_last)/1.0e9;
+      double margin = fmin(STALL_MARGIN*period,STALL_MARGIN_MAX);
+      wait = imin(wait,imax(2,2+(int)(1000.0*(period-late+margin))));
+    }
     // printf("wait=%d, size=%u, seq=%u\n",wait,size,video_seq);
-    data = (video_seq % 2) ? video_data1 : video_data2;
-    // printf("writing to buffer %d\n",(data==video_data1) ? 1 : 2);
-    ret = ASIGetVideoData(asi_id,data,size,wait);
+    data = fpool_slot(&cam->fpool,cam->video_seq+1); /* 'next' reads seq%n */
+    VideoCall *vc = &cam->vtrace[cam->vtrace_n % VTRACE_N];
+    vc->wait = wait;
+    vc->t_entry = time_ns();
+    ret = ASIGetVideoData(cam->asi_id,data,size,wait);
+    vc->t_return = time_ns();
+    vc->ret = ret;
+    /* readout+USB transfer are not known: start is an upper bound */
+    vc->t_start = vc->t_return-(unsigned long long)(1.0e9*cam->asi_expTime);
+    cam->vtrace_n++;
     if (ret == ASI_SUCCESS) {
-      video_ts[(video_seq % 2) ? 0 : 1] = time_ns(); /* slot of 'data' */
+      (void)calib_apply(&cam->calib,data,geo.x,geo.y,geo.w,geo.h,geo.bin,
+                        geo.bits,cam->asi_expTime);
+      FrameStats *fs = &cam->video_stats[(cam->video_seq+1) % cam->fpool.n];
+      if (cam->stats_on) fstats_frame(data,geo.w,geo.h,geo.bits,
+                                      cam->stats_nhist,fs);
+      else               fs->n = 0;
+      if (cam->aexp.on) auto_frame(cam,data,&geo);
+      /* slot of 'data' */
+      cam->video_ts[(cam->video_seq+1) % cam->fpool.n] = vc->t_return;
+      cam->video_geom[(cam->video_seq+1) % cam->fpool.n] = geo;
+      if (cam->track_state) track_frame(cam,data,&geo);
+      else             cam->track_now.on = 0;
+      cam->video_track[(cam->video_seq+1) % cam->fpool.n] = cam->track_now;
       __sync_synchronize();  /* frame data+ts visible before seq (arm64) */
-      video_seq++;
+      cam->video_seq++;
+      if (t_last) {                    /* EMA, a stall moves it <=1/8 */
+        double dt = (double)(vc->t_return-t_last)/1.0e9;
+        period = (period > 0) ? period+(fmin(dt,2*period)-period)/8 : dt;
+      }
+      t_last = vc->t_return;
+      overdue = 0;
+      if (cam->pv_on && (vc->t_return-cam->pv_t >=     /* after 'next' */
+                         (unsigned long long)(1.0e9/cam->pv_rate))) {
+        preview_frame(cam,data,&geo,vc->t_return);
+      }
+    } else {
+      if (vc->t_return-t_drop >= (unsigned long long)(1.0e9*DROP_POLL)) {
+        (void)ASIGetDroppedFrames(cam->asi_id,&cam->video_dropped);
+        t_drop = vc->t_return;         /* USB control transfer: rare */
+      }
+      if (adapt) {
+        if (!overdue++) cam->video_stalls++; /* count once per late frame */
+        late = (double)(long long)(time_ns()-t_last)/1.0e9;
+        if ((late > STALL_REARM*period+0.2) && (cam->zwo_state == ZWO_VIDEO)) {
+          sprintf(buf,"%s(%d): no frame for %.3fs (period=%.4fs), re-arm",
+                  PREFUN,cam->index,late,period);
+          message(NULL,buf,MSS_FLUSH);
+          int r1 = ASIStopVideoCapture(cam->asi_id);
+          msleep(50);
+          int r2 = (cam->zwo_state == ZWO_VIDEO) ?
+                   ASIStartVideoCapture(cam->asi_id) : ASI_SUCCESS;
+          cam->video_rearms++;
+          if ((r1 != ASI_SUCCESS) || (r2 != ASI_SUCCESS)) {
+            cam->video_rfails++;
+            sprintf(buf,"%s(%d): re-arm failed, stop=%d start=%d",
+                    PREFUN,cam->index,r1,r2);
+            message(NULL,buf,MSS_FLUSH);
+          }
+          t_last = time_ns(); overdue = 0; /* watchdog: retry if no frame */
+        }
+      }
     }
   }
   printf("%s done\n",PREFUN); //xxx
   __sync_synchronize();
-  video_running = 0;
+  cam->video_running = 0;
+
+  return (void*)0;
+}
+
+/* ---------------------------------------------------------------- */
+/* flight recorder copier: follows run_video through the pool slots, */
+/* so the capture thread never waits for the copy; falls back to the */
+/* newest frame if run_video is about to reuse the next slot         */
+
+static void* run_record(void* param)
+{
+  Camera *cam=(Camera*)param;
+  u_int  seq,last=cam->video_seq;      /* last frame looked at */
+
+  while (cam->zwo_state == ZWO_VIDEO) {
+    seq = cam->video_seq;
+    if (!cam->rec_on) {                /* start with the next frame */
+      last = seq;
+      msleep(10);
+      continue;
+    }
+    if (seq == last) { msleep(1); continue; }
+    if (seq-last >= (u_int)cam->fpool.n) {  /* fell behind */
+      frec_lost(&cam->rec,seq-last-1);
+      last = seq-1;
+    }
+    __sync_synchronize();  /* frame data+ts written before seq (arm64) */
+    record_frame(cam,++last);
+  }
+  __sync_synchronize();
+  cam->rec_running = 0;
+
+  return (void*)0;
+}
+
+/* ---------------------------------------------------------------- */
+
+static void* run_burst(void* param)
+{
+  Camera *cam=(Camera*)param;
+  int    ret,size=cam->zwo_w*cam->zwo_h*cam->zwo_bits/8;
+  time_t next=0;
+  char   buf[128];
+  ASI_EXPOSURE_STATUS status;
+
+  /* the frame pool is set up by 'burst' before this thread spawns.  */
+  /* The next exposure starts as soon as the previous frame is off    */
+  /* the camera, so readout+network of frame N overlap exposure N+1;  */
+  /* only a full queue (client not fetching) holds the camera.        */
+
+  while ((cam->zwo_state == ZWO_BURST) && (cam->burst_seq < cam->burst_n)) {
+    if (cam->burst_seq-cam->burst_last >= cam->burst_depth) {
+      msleep(1); continue;             /* queue full */
+    }
+    if (cor_time(0) >= next) {         /* update temp/cooler */
+      handle_command(cam,"tempcon",buf,sizeof(buf));
+      next = cor_time(0)+30;
+    }
+    int k = cam->burst_seq % cam->burst_depth;
+    ret = ASIStartExposure(cam->asi_id,ASI_FALSE);
+    cam->burst_t0[k] = time_ns();
+    if (ret != ASI_SUCCESS) {
+      sprintf(buf,"%s(%d): ASIStartExposure ret=%d",PREFUN,cam->index,ret);
+      message(NULL,buf,MSS_FLUSH);
+      break;
+    }
+    double tend = walltime(0)+cam->asi_expTime;
+    status = ASI_EXP_WORKING;
+    while (cam->zwo_state == ZWO_BURST) {
+      double dt = tend-walltime(0);    /* sleep through the exposure, */
+      if (dt > 0.005) {                /* then poll the readout (1ms) */
+        msleep(imin(100,(int)(1000.0*dt)-2));
+        continue;
+      }
+      ASIGetExpStatus(cam->asi_id,&status);
+      if (status != ASI_EXP_WORKING) break;
+      msleep(1);
+    }
+    if (status == ASI_EXP_WORKING) {   /* 'stop' or hangup */
+      (void)ASIStopExposure(cam->asi_id);
+      break;
+    }
+    if (status == ASI_EXP_SUCCESS) {
+      ret = ASIGetDataAfterExp(cam->asi_id,fpool_slot(&cam->fpool,k),size);
+      if (ret == ASI_SUCCESS) {
+        (void)calib_apply(&cam->calib,fpool_slot(&cam->fpool,k),cam->zwo_x,
+                          cam->zwo_y,cam->zwo_w,cam->zwo_h,cam->zwo_bin,
+                          cam->zwo_bits,cam->asi_expTime);
+        if (cam->stats_on) {
+          fstats_frame(fpool_slot(&cam->fpool,k),cam->zwo_w,cam->zwo_h,
+                       cam->zwo_bits,cam->stats_nhist,&cam->burst_stats[k]);
+        } else {
+          cam->burst_stats[k].n = 0;
+        }
+      }
+    } else {
+      ret = ASI_ERROR_GENERAL_ERROR;
+    }
+    if (ret != ASI_SUCCESS) {
+      sprintf(buf,"%s(%d): frame %u failed, status=%d ret=%d",PREFUN,cam->index,
+              cam->burst_seq+1,status,ret);
+      message(NULL,buf,MSS_FLUSH);
+      break;
+    }
+    cam->burst_ts[k] = time_ns();
+    __sync_synchronize();  /* frame data+ts visible before seq (arm64) */
+    cam->burst_seq++;
+  }
+  sprintf(buf,"%s(%d): done (%u/%u)",PREFUN,cam->index,cam->burst_seq,
+          cam->burst_n);
+  message(NULL,buf,MSS_FILE);
+  __sync_synchronize();
+  cam->burst_running = 0;
 
   return (void*)0;
 }